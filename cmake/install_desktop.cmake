@@ -28,6 +28,17 @@ if(BUILD_WHISPERCPP)
     strip_all("${external_lib_dir}/libwhisper-fallback.so")
     install(FILES "${external_lib_dir}/libwhisper-openblas.so" DESTINATION ${lib_install_dir})
     install(FILES "${external_lib_dir}/libwhisper-fallback.so" DESTINATION ${lib_install_dir})
+    if(BUILD_WHISPERCPP_CPU_VARIANTS)
+        if(arch_x8664)
+            set(whispercpp_cpu_variants avx512 avx sse4)
+        elseif(arch_arm64)
+            set(whispercpp_cpu_variants armv82)
+        endif()
+        foreach(variant ${whispercpp_cpu_variants})
+            strip_all("${external_lib_dir}/libwhisper-openblas-${variant}.so")
+            install(FILES "${external_lib_dir}/libwhisper-openblas-${variant}.so" DESTINATION ${lib_install_dir})
+        endforeach()
+    endif()
     if(arch_x8664)
         if(BUILD_WHISPERCPP_CLBLAST)
             strip_all("${external_lib_dir}/libclblast.so.1.6.1")
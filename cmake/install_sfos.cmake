@@ -14,6 +14,9 @@ install(FILES "${PROJECT_BINARY_DIR}/dbus_app.service" DESTINATION share/dbus-1/
 if(BUILD_WHISPERCPP)
     install(FILES "${external_lib_dir}/libwhisper-openblas.so" DESTINATION ${lib_install_dir})
     install(FILES "${external_lib_dir}/libwhisper-fallback.so" DESTINATION DESTINATION ${lib_install_dir})
+    if(BUILD_WHISPERCPP_CPU_VARIANTS AND arch_arm64)
+        install(FILES "${external_lib_dir}/libwhisper-openblas-armv82.so" DESTINATION ${lib_install_dir})
+    endif()
 endif()
 
 if(DOWNLOAD_LIBSTT)
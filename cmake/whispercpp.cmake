@@ -205,3 +205,50 @@ if(BUILD_OPENBLAS)
 endif()
 
 list(APPEND deps whispercppopenblas whispercppfallback)
+
+# additional cpu builds, the best one supported by cpu is selected in runtime
+function(add_whispercpp_cpu_variant variant_name variant_flags)
+    set(flags "${whispercpp_flags} ${variant_flags}")
+
+    ExternalProject_Add(whispercpp${variant_name}
+        SOURCE_DIR ${external_dir}/whispercpp${variant_name}
+        BINARY_DIR ${PROJECT_BINARY_DIR}/external/whispercpp${variant_name}
+        INSTALL_DIR ${PROJECT_BINARY_DIR}/external
+        URL "${whispercpp_source_url}"
+        URL_HASH SHA256=${whispercpp_checksum}
+        PATCH_COMMAND patch --batch --unified -p1 --directory=<SOURCE_DIR>
+                    -i ${patches_dir}/whispercpp.patch ||
+                        echo "patch cmd failed, likely already patched"
+        CMAKE_ARGS -DCMAKE_BUILD_TYPE=Release
+            -DCMAKE_INSTALL_PREFIX=<INSTALL_DIR>
+            -DCMAKE_INSTALL_LIBDIR=lib
+            -DBLAS_LIB_PATH=${blas_lib_path}
+            -DBLAS_INC_DIR=${blas_include_dir}
+            -DCMAKE_POSITION_INDEPENDENT_CODE=ON -DBUILD_SHARED_LIBS=ON
+            -DWHISPER_BUILD_TESTS=OFF -DWHISPER_BUILD_EXAMPLES=OFF
+            -DWHISPER_OPENBLAS=ON
+            ${ARGN}
+            -DCMAKE_C_FLAGS=${flags} -DCMAKE_CXX_FLAGS=${flags}
+            -DCMAKE_INSTALL_RPATH=${rpath_install_dir}
+            -DWHISPER_TARGET_NAME=whisper-openblas-${variant_name}
+        BUILD_ALWAYS False
+    )
+
+    if(BUILD_OPENBLAS)
+        ExternalProject_Add_StepDependencies(whispercpp${variant_name} configure openblas)
+    endif()
+
+    set(deps ${deps} whispercpp${variant_name} PARENT_SCOPE)
+endfunction()
+
+if(BUILD_WHISPERCPP_CPU_VARIANTS)
+    if(arch_x8664)
+        add_whispercpp_cpu_variant(avx512 "" -DWHISPER_NO_AVX512=OFF)
+        add_whispercpp_cpu_variant(avx ""
+            -DWHISPER_NO_AVX2=ON -DWHISPER_NO_FMA=ON -DWHISPER_NO_F16C=ON)
+        add_whispercpp_cpu_variant(sse4 "-msse4.1 -mssse3"
+            -DWHISPER_NO_AVX=ON -DWHISPER_NO_AVX2=ON -DWHISPER_NO_FMA=ON -DWHISPER_NO_F16C=ON)
+    elseif(arch_arm64)
+        add_whispercpp_cpu_variant(armv82 "-march=armv8.2-a+dotprod+fp16")
+    endif()
+endif()
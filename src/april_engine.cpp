@@ -19,6 +19,7 @@
 #include <chrono>
 
 #include "logger.hpp"
+#include "metrics.hpp"
 #include "text_tools.hpp"
 
 using namespace std::chrono_literals;
@@ -107,21 +108,21 @@ stt_engine::samples_process_result_t april_engine::process_buff() {
 
     if (sof) {
         m_speech_buf.clear();
-        m_start_time.reset();
+        reset_sentence_timer();
         m_vad.reset();
         if (m_session) aas_flush(m_session);
         m_result.clear();
         m_result_prev_segment.clear();
         reset_segment_counters();
         m_segments.clear();
+        m_partial_scheduler.reset();
     }
 
     m_denoiser.process(m_in_buf.buf.data(), m_in_buf.size);
 
-    const auto& vad_buf =
-        m_vad.remove_silence(m_in_buf.buf.data(), m_in_buf.size);
+    const auto& vad_spans = m_vad.process(m_in_buf.buf.data(), m_in_buf.size);
 
-    bool vad_status = !vad_buf.empty();
+    bool vad_status = !vad_spans.empty();
 
     if (vad_status) {
         LOGD("vad: speech detected");
@@ -131,12 +132,15 @@ stt_engine::samples_process_result_t april_engine::process_buff() {
             set_speech_detection_status(
                 speech_detection_status_t::speech_detected);
 
-        if (m_config.text_format == text_format_t::raw)
-            m_speech_buf.insert(m_speech_buf.end(), vad_buf.cbegin(),
-                                vad_buf.cend());
-        else
+        if (m_config.text_format == text_format_t::raw) {
+            for (const auto& span : vad_spans)
+                m_speech_buf.insert(m_speech_buf.end(),
+                                    m_vad.samples() + span.start,
+                                    m_vad.samples() + span.end);
+        } else {
             m_speech_buf.insert(m_speech_buf.end(), m_in_buf.buf.cbegin(),
                                 m_in_buf.buf.cbegin() + m_in_buf.size);
+        }
 
         restart_sentence_timer();
     } else {
@@ -181,12 +185,17 @@ stt_engine::samples_process_result_t april_engine::process_buff() {
         m_segment_time_offset += m_segment_time_discarded_before;
         m_segment_time_discarded_before = 0;
 
-        decode_speech(m_speech_buf, final_decode);
+        {
+            metrics::scoped_timer timer{
+                metrics::stage_t::decode,
+                metrics::samples_to_ms(m_speech_buf.size(), m_sample_rate)};
+            decode_speech(m_speech_buf, final_decode);
+        }
 
         m_segment_time_offset += m_segment_time_discarded_after;
         m_segment_time_discarded_after = 0;
 
-        if (m_config.speech_started) set_state(state_t::idle);
+        if (speech_status()) set_state(state_t::idle);
 
         m_speech_buf.clear();
 
@@ -304,13 +313,22 @@ void april_engine::decode_speech(april_buf_t& buf, bool eof) {
         m_result_size_consumed = 0;
         m_segments.clear();
     } else {
+        // audio is decoded by april while feeding, only building of partial
+        // text with punctuation is done on a cadence
+        if (!eof && !partial_due(buf.size())) {
+            LOGD("partial result not needed yet");
+            return;
+        }
+
+        auto partial_start = std::chrono::steady_clock::now();
+
         auto result = m_result_prev_segment + m_result;
 
         ltrim(result);
         rtrim(result);
 
         if (m_punctuator) {
-            result = m_punctuator->process(result);
+            result = restore_punctuation(result, eof);
         } else {
             text_tools::restore_caps(result);
         }
@@ -319,6 +337,9 @@ void april_engine::decode_speech(april_buf_t& buf, bool eof) {
             set_intermediate_text(result);
         }
 
-        if (eof) m_result_prev_segment.clear();
+        if (eof)
+            m_result_prev_segment.clear();
+        else
+            partial_decoded(partial_start);
     }
 }
@@ -21,6 +21,29 @@ extern "C" {
                                    va_list vl) {
     if (level > av_log_get_level()) return;
 
+    auto type = [=] {
+        switch (level) {
+            case AV_LOG_QUIET:
+                return Logger::LogType::Quiet;
+            case AV_LOG_DEBUG:
+            case AV_LOG_VERBOSE:
+                return Logger::LogType::Debug;
+            case AV_LOG_TRACE:
+                return Logger::LogType::Trace;
+            case AV_LOG_INFO:
+                return Logger::LogType::Info;
+            case AV_LOG_WARNING:
+                return Logger::LogType::Warning;
+            case AV_LOG_ERROR:
+            case AV_LOG_FATAL:
+            case AV_LOG_PANIC:
+                return Logger::LogType::Error;
+        }
+        return Logger::LogType::Debug;
+    }();
+
+    if (!Logger::match(type)) return;
+
     const auto tag = [=]() {
         std::ostringstream os;
         os << "av::";
@@ -38,27 +61,7 @@ extern "C" {
         return os.str();
     }();
 
-    Logger::Message msg{[=] {
-                            switch (level) {
-                                case AV_LOG_QUIET:
-                                    return Logger::LogType::Quiet;
-                                case AV_LOG_DEBUG:
-                                case AV_LOG_VERBOSE:
-                                    return Logger::LogType::Debug;
-                                case AV_LOG_TRACE:
-                                    return Logger::LogType::Trace;
-                                case AV_LOG_INFO:
-                                    return Logger::LogType::Info;
-                                case AV_LOG_WARNING:
-                                    return Logger::LogType::Warning;
-                                case AV_LOG_ERROR:
-                                case AV_LOG_FATAL:
-                                case AV_LOG_PANIC:
-                                    return Logger::LogType::Error;
-                            }
-                            return Logger::LogType::Debug;
-                        }(),
-                        "", tag.c_str(), 0};
+    Logger::Message msg{type, "", tag.c_str(), 0};
 
     char buf[1024];
     vsnprintf(buf, 1024, fmt, vl);
@@ -0,0 +1,376 @@
+/* Copyright (C) 2024 Michal Kosciesza <michal@mkiol.net>
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+#include "batch_runner.h"
+
+#include <fmt/format.h>
+
+#include <QDebug>
+#include <QFile>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QStringList>
+#include <QTimer>
+#include <cstdio>
+#include <utility>
+
+#include "settings.h"
+#include "speech_service.h"
+
+batch_runner::batch_runner(QString jobs_file, QObject *parent)
+    : QObject{parent}, m_jobs_file{std::move(jobs_file)} {}
+
+std::optional<batch_runner::job_t> batch_runner::parse_job(
+    const QByteArray &line) {
+    QJsonParseError error;
+    auto doc = QJsonDocument::fromJson(line, &error);
+    if (error.error != QJsonParseError::NoError || !doc.isObject()) {
+        qWarning() << "invalid job json:" << error.errorString();
+        return std::nullopt;
+    }
+
+    auto obj = doc.object();
+
+    job_t job;
+
+    if (obj.contains(QStringLiteral("stt"))) {
+        job.type = job_type_t::stt;
+        job.input = obj.value(QStringLiteral("stt")).toString();
+    } else if (obj.contains(QStringLiteral("tts"))) {
+        job.type = job_type_t::tts;
+        job.input = obj.value(QStringLiteral("tts")).toString();
+    } else if (obj.contains(QStringLiteral("mnt"))) {
+        job.type = job_type_t::mnt;
+        job.input = obj.value(QStringLiteral("mnt")).toString();
+    } else {
+        qWarning() << "job type is missing";
+        return std::nullopt;
+    }
+
+    if (job.input.isEmpty()) {
+        qWarning() << "job input is empty";
+        return std::nullopt;
+    }
+
+    job.lang = obj.value(QStringLiteral("lang")).toString();
+    job.out_lang = obj.value(QStringLiteral("out_lang")).toString();
+    job.out_file = obj.value(QStringLiteral("out")).toString();
+    job.options = obj.value(QStringLiteral("options")).toObject().toVariantMap();
+
+    if (job.type == job_type_t::mnt && job.out_lang.isEmpty()) {
+        qWarning() << "out lang is missing in translation job";
+        return std::nullopt;
+    }
+
+    return job;
+}
+
+bool batch_runner::load_jobs() {
+    QFile file{m_jobs_file};
+
+    if (!(m_jobs_file == QStringLiteral("-")
+              ? file.open(stdin, QIODevice::ReadOnly)
+              : file.open(QIODevice::ReadOnly))) {
+        fmt::print(stderr, "Cannot open jobs file: {}\n",
+                   m_jobs_file.toStdString());
+        return false;
+    }
+
+    for (int n = 1; !file.atEnd(); ++n) {
+        auto line = file.readLine().trimmed();
+
+        // empty lines and comments are skipped
+        if (line.isEmpty() || line.startsWith('#')) continue;
+
+        auto job = parse_job(line);
+        if (!job) {
+            fmt::print(stderr, "Invalid job in line {}.\n", n);
+            return false;
+        }
+
+        m_jobs.push_back(std::move(*job));
+    }
+
+    qDebug() << "batch jobs:" << m_jobs.size();
+
+    return true;
+}
+
+void batch_runner::start() {
+    if (!load_jobs()) {
+        finish(exit_invalid_input);
+        return;
+    }
+
+    auto *service = speech_service::instance();
+
+    // service finishes task asynchronously, next job is started when it
+    // becomes ready again
+    connect(service, &speech_service::state_changed, this,
+            &batch_runner::run_next_job, Qt::QueuedConnection);
+    connect(service, &speech_service::current_task_changed, this,
+            &batch_runner::run_next_job, Qt::QueuedConnection);
+    connect(service, &speech_service::stt_text_decoded, this,
+            [this](const QString &text, [[maybe_unused]] const QString &lang,
+                   int task) {
+                if (!m_job_running || m_many_files || task != m_task) return;
+
+                auto new_text = text.trimmed();
+                if (new_text.isEmpty()) return;
+
+                if (!m_text.isEmpty()) {
+                    // subtitles are separated by empty line
+                    bool subrip =
+                        m_jobs.at(m_next_job)
+                            .options.value(QStringLiteral("text_format"))
+                            .toInt() ==
+                        static_cast<int>(
+                            settings::text_format_t::TextFormatSubRip);
+                    m_text.append(subrip ? QStringLiteral("\n\n")
+                                         : QStringLiteral(" "));
+                }
+
+                m_text.append(new_text);
+            });
+    connect(service, &speech_service::stt_transcribe_files_file_finished, this,
+            [this](int task, const QString &file, const QString &out_file,
+                   bool ok) {
+                if (m_job_running && task == m_task)
+                    handle_file_finished(file, out_file, ok);
+            });
+    connect(service, &speech_service::stt_file_transcribe_finished, this,
+            [this](int task) {
+                if (!m_job_running || task != m_task) return;
+                // results of all files have been already reported, so
+                // remaining jobs have no result
+                if (m_many_files)
+                    finish_all_jobs(false);
+                else
+                    finish_job(0, true, m_text);
+            });
+    connect(service, &speech_service::tts_speech_to_file_finished, this,
+            [this](const QString &file, int task) {
+                if (m_job_running && task == m_task) finish_job(0, true, file);
+            });
+    connect(service, &speech_service::mnt_translate_finished, this,
+            [this]([[maybe_unused]] const QString &in_text,
+                   [[maybe_unused]] const QString &in_lang,
+                   const QString &out_text,
+                   [[maybe_unused]] const QString &out_lang, int task) {
+                if (m_job_running && task == m_task)
+                    finish_job(0, true, out_text);
+            });
+    connect(service, &speech_service::task_error, this,
+            [this]([[maybe_unused]] speech_service::error_t type, int task) {
+                // errors of starting jobs are handled in start_jobs
+                if (m_job_running && task == m_task) finish_all_jobs(false);
+            });
+
+    run_next_job();
+}
+
+void batch_runner::run_next_job() {
+    if (m_finished || m_job_running) return;
+
+    auto *service = speech_service::instance();
+
+    switch (service->state()) {
+        case speech_service::state_t::unknown:
+        case speech_service::state_t::busy:
+            // waiting for service initialization
+            return;
+        case speech_service::state_t::not_configured:
+            fmt::print(stderr, "No models are installed.\n");
+            finish(exit_not_configured);
+            return;
+        default:
+            break;
+    }
+
+    if (service->current_task_id() != INVALID_TASK) return;
+
+    if (m_next_job >= m_jobs.size()) {
+        finish(m_any_failed ? exit_job_failed : exit_ok);
+        return;
+    }
+
+    start_jobs();
+}
+
+size_t batch_runner::jobs_to_group() const {
+    const auto &first = m_jobs.at(m_next_job);
+    if (first.type != job_type_t::stt) return 1;
+
+    auto end = m_next_job + 1;
+    while (end < m_jobs.size()) {
+        const auto &job = m_jobs.at(end);
+        if (job.type != job_type_t::stt || job.lang != first.lang ||
+            job.out_lang != first.out_lang || job.options != first.options)
+            break;
+        ++end;
+    }
+
+    return end - m_next_job;
+}
+
+void batch_runner::start_jobs() {
+    auto count = jobs_to_group();
+
+    qDebug() << "starting jobs:" << m_next_job << count;
+
+    auto *service = speech_service::instance();
+    const auto &job = m_jobs.at(m_next_job);
+
+    m_text.clear();
+    m_results.assign(count, std::nullopt);
+    m_many_files = count > 1;
+    m_job_running = true;
+
+    switch (job.type) {
+        case job_type_t::stt:
+            if (m_many_files) {
+                QStringList files;
+                for (size_t i = 0; i < count; ++i)
+                    files.push_back(m_jobs.at(m_next_job + i).input);
+                m_task = service->stt_transcribe_files(files, job.lang,
+                                                       job.out_lang,
+                                                       job.options);
+            } else {
+                m_task = service->stt_transcribe_file(
+                    job.input, job.lang, job.out_lang, job.options);
+            }
+            break;
+        case job_type_t::tts:
+            m_task =
+                service->tts_speech_to_file(job.input, job.lang, job.options);
+            break;
+        case job_type_t::mnt:
+            m_task = service->mnt_translate(job.input, job.lang, job.out_lang,
+                                            job.options);
+            break;
+    }
+
+    if (m_task == INVALID_TASK) finish_all_jobs(false);
+}
+
+void batch_runner::handle_file_finished(const QString &file,
+                                        const QString &out_file, bool ok) {
+    // the same file can be used in many jobs
+    size_t idx = 0;
+    while (idx < m_results.size() &&
+           (m_results.at(idx) || m_jobs.at(m_next_job + idx).input != file))
+        ++idx;
+
+    if (idx == m_results.size()) {
+        qWarning() << "unknown batch file:" << file;
+        return;
+    }
+
+    QString text;
+
+    // service writes transcription next to audio file, it is moved to
+    // job's output
+    if (ok) {
+        QFile f{out_file};
+        if (f.open(QIODevice::ReadOnly | QIODevice::Text)) {
+            text = QString::fromUtf8(f.readAll());
+            f.close();
+            f.remove();
+        } else {
+            qWarning() << "failed to read transcription:" << out_file;
+            ok = false;
+        }
+    }
+
+    finish_job(idx, ok, text);
+}
+
+void batch_runner::finish_all_jobs(bool ok, const QString &data) {
+    for (size_t i = 0; i < m_results.size(); ++i)
+        if (!m_results.at(i)) m_results.at(i) = result_t{ok, data};
+
+    finish_job(0, ok, data);
+}
+
+void batch_runner::finish_job(size_t idx, bool ok, const QString &data) {
+    if (!m_results.at(idx)) m_results.at(idx) = result_t{ok, data};
+
+    // results are written in order of jobs
+    while (!m_results.empty() && m_results.front()) {
+        const auto &job = m_jobs.at(m_next_job);
+        auto &result = *m_results.front();
+
+        if (result.ok) result.ok = write_result(job, result);
+
+        if (!result.ok) {
+            fmt::print(stderr, "Job {} failed.\n", m_next_job + 1);
+            m_any_failed = true;
+        }
+
+        qDebug() << "job finished:" << m_next_job << result.ok;
+
+        ++m_next_job;
+        m_results.pop_front();
+    }
+
+    if (!m_results.empty()) return;
+
+    m_task = INVALID_TASK;
+    m_job_running = false;
+    m_many_files = false;
+    m_text.clear();
+
+    QTimer::singleShot(0, this, &batch_runner::run_next_job);
+}
+
+bool batch_runner::write_result(const job_t &job,
+                                const result_t &result) const {
+    if (job.type == job_type_t::tts) {
+        if (job.out_file.isEmpty()) {
+            fmt::print("{}\n", result.data.toStdString());
+            return true;
+        }
+
+        QFile::remove(job.out_file);
+        if (!QFile::copy(result.data, job.out_file)) {
+            fmt::print(stderr, "Cannot write file: {}\n",
+                       job.out_file.toStdString());
+            return false;
+        }
+
+        return true;
+    }
+
+    if (job.out_file.isEmpty()) {
+        fmt::print("{}\n", result.data.toStdString());
+        std::fflush(stdout);
+        return true;
+    }
+
+    QFile file{job.out_file};
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Text)) {
+        fmt::print(stderr, "Cannot write file: {}\n",
+                   job.out_file.toStdString());
+        return false;
+    }
+
+    file.write(result.data.toUtf8());
+
+    return true;
+}
+
+void batch_runner::finish(int exit_code) {
+    if (m_finished) return;
+
+    m_finished = true;
+
+    speech_service::instance()->disconnect(this);
+
+    qDebug() << "batch finished:" << exit_code;
+
+    emit finished(exit_code);
+}
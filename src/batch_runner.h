@@ -0,0 +1,93 @@
+/* Copyright (C) 2024 Michal Kosciesza <michal@mkiol.net>
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+#ifndef BATCH_RUNNER_H
+#define BATCH_RUNNER_H
+
+#include <QByteArray>
+#include <QObject>
+#include <QString>
+#include <QVariantMap>
+#include <deque>
+#include <optional>
+#include <vector>
+
+// Runs speech jobs without GUI and D-Bus. Jobs are read from a file or
+// stdin, one JSON object per line:
+// {"stt": "memo.mp3", "lang": "en", "out": "memo.txt"}
+// {"tts": "Text to read.", "lang": "en", "out": "speech.mp3"}
+// {"mnt": "Text to translate.", "lang": "en", "out_lang": "de"}
+// Optional "options" object is passed to the service as task options.
+// Result is written to "out" file or to stdout when "out" is not set.
+// Consecutive STT jobs with the same languages and options are run as one
+// task, so files are transcribed concurrently. Results are always written
+// in order of jobs.
+
+class batch_runner : public QObject {
+    Q_OBJECT
+   public:
+    enum class job_type_t { stt, tts, mnt };
+
+    struct job_t {
+        job_type_t type = job_type_t::stt;
+        QString input;
+        QString lang;
+        QString out_lang;
+        QString out_file;
+        QVariantMap options;
+    };
+
+    enum exit_code_t : int {
+        exit_ok = 0,
+        exit_job_failed = 1,
+        exit_invalid_input = 2,
+        exit_not_configured = 3
+    };
+
+    // jobs_file equal to "-" means stdin
+    explicit batch_runner(QString jobs_file, QObject *parent = nullptr);
+    void start();
+    static std::optional<job_t> parse_job(const QByteArray &line);
+
+   signals:
+    void finished(int exit_code);
+
+   private:
+    static const int INVALID_TASK = -1;
+
+    struct result_t {
+        bool ok = false;
+        // decoded or translated text, path of audio file for tts job
+        QString data;
+    };
+
+    QString m_jobs_file;
+    std::vector<job_t> m_jobs;
+    size_t m_next_job = 0;
+    int m_task = INVALID_TASK;
+    bool m_job_running = false;
+    // jobs are transcribed with stt_transcribe_files
+    bool m_many_files = false;
+    // results of running jobs starting from m_next_job
+    std::deque<std::optional<result_t>> m_results;
+    bool m_any_failed = false;
+    bool m_finished = false;
+    QString m_text;
+
+    bool load_jobs();
+    void run_next_job();
+    size_t jobs_to_group() const;
+    void start_jobs();
+    void finish_job(size_t idx, bool ok, const QString &data = {});
+    void finish_all_jobs(bool ok, const QString &data = {});
+    void handle_file_finished(const QString &file, const QString &out_file,
+                              bool ok);
+    void finish(int exit_code);
+    bool write_result(const job_t &job, const result_t &result) const;
+};
+
+#endif  // BATCH_RUNNER_H
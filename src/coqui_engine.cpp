@@ -46,6 +46,7 @@ void coqui_engine::stop() {
     if (m_model) {
         auto task = py_executor::instance()->execute([&]() {
             try {
+                m_ref_voice_latents.reset();
                 m_model.reset();
             } catch (const std::exception& err) {
                 LOGE("py error: " << err.what());
@@ -240,6 +241,7 @@ void coqui_engine::create_model() {
                          << *m_initial_duration_threshold);
                 } else if (model_class_name == "Xtts") {
                     m_speed_supported = true;
+                    m_xtts = true;
                 } else {
                     LOGD("model does not have initial speed");
                 }
@@ -292,22 +294,36 @@ bool coqui_engine::encode_speech_impl(const std::string& text,
                 }
             }
 
-            auto wav = m_model->attr("tts")(
-                "text"_a = text,
-                "speaker_name"_a =
-                    m_config.speaker_id.empty()
-                        ? static_cast<py::object>(py::none())
-                        : static_cast<py::object>(py::str(m_config.speaker_id)),
-                "language_name"_a = m_config.lang_code.empty()
-                                        ? m_config.lang
-                                        : m_config.lang_code,
-                "speaker_wav"_a = m_ref_voice_wav_file.empty()
-                                      ? static_cast<py::object>(py::none())
-                                      : static_cast<py::object>(
-                                            py::str(m_ref_voice_wav_file)),
-                "reference_wav"_a = py::none(), "style_wav"_a = py::none(),
-                "style_text"_a = py::none(),
-                "reference_speaker_name"_a = py::none(), "speed"_a = speed);
+            // xtts conditioning latents of ref voice are computed once
+            auto latents = m_xtts && !m_ref_voice_wav_file.empty()
+                               ? ref_voice_latents()
+                               : std::nullopt;
+
+            py::object wav;
+
+            if (latents) {
+                wav = xtts_inference(text, *latents, speed);
+            } else {
+                wav = m_model->attr("tts")(
+                    "text"_a = text,
+                    "speaker_name"_a =
+                        m_config.speaker_id.empty()
+                            ? static_cast<py::object>(py::none())
+                            : static_cast<py::object>(
+                                  py::str(m_config.speaker_id)),
+                    "language_name"_a = m_config.lang_code.empty()
+                                            ? m_config.lang
+                                            : m_config.lang_code,
+                    "speaker_wav"_a =
+                        m_ref_voice_wav_file.empty()
+                            ? static_cast<py::object>(py::none())
+                            : static_cast<py::object>(
+                                  py::str(m_ref_voice_wav_file)),
+                    "reference_wav"_a = py::none(), "style_wav"_a = py::none(),
+                    "style_text"_a = py::none(),
+                    "reference_speaker_name"_a = py::none(),
+                    "speed"_a = speed);
+            }
 
             m_model->attr("save_wav")("wav"_a = wav, "path"_a = out_file);
         } catch (const std::exception& err) {
@@ -324,6 +340,87 @@ bool coqui_engine::encode_speech_impl(const std::string& text,
     return true;
 }
 
+std::optional<py::tuple> coqui_engine::ref_voice_latents() {
+    if (!m_ref_voice_hash) return std::nullopt;
+
+    if (m_ref_voice_latents && m_ref_voice_latents->first == *m_ref_voice_hash)
+        return m_ref_voice_latents->second;
+
+    auto torch = py::module_::import("torch");
+    auto model = m_model->attr("tts_model");
+
+    // latents depend on model, so they are cached per model
+    auto latents_file = ref_voice_cache_file(fmt::format(
+        "_{}.pt", std::hash<std::string>{}(m_config.model_files.model_path)));
+
+    std::optional<py::tuple> latents;
+
+    if (access(latents_file.c_str(), R_OK) == 0) {
+        // file contains only tensors, so unpickling of arbitrary objects
+        // is not allowed
+        try {
+            latents = torch
+                          .attr("load")(latents_file,
+                                        "map_location"_a = model.attr("device"),
+                                        "weights_only"_a = true)
+                          .cast<py::tuple>();
+            LOGD("ref voice latents loaded: " << latents_file);
+        } catch (const std::exception& err) {
+            LOGW("failed to load ref voice latents: " << err.what());
+        }
+    }
+
+    if (!latents) {
+        auto config = model.attr("config");
+
+        py::list audio_path;
+        audio_path.append(m_ref_voice_wav_file);
+
+        latents = model
+                      .attr("get_conditioning_latents")(
+                          "audio_path"_a = audio_path,
+                          "gpt_cond_len"_a = config.attr("gpt_cond_len"),
+                          "gpt_cond_chunk_len"_a =
+                              config.attr("gpt_cond_chunk_len"),
+                          "max_ref_length"_a = config.attr("max_ref_len"),
+                          "sound_norm_refs"_a = config.attr("sound_norm_refs"))
+                      .cast<py::tuple>();
+
+        LOGD("ref voice latents computed");
+
+        try {
+            torch.attr("save")(*latents, latents_file);
+        } catch (const std::exception& err) {
+            LOGW("failed to save ref voice latents: " << err.what());
+        }
+    }
+
+    m_ref_voice_latents.emplace(*m_ref_voice_hash, *latents);
+
+    return latents;
+}
+
+py::object coqui_engine::xtts_inference(const std::string& text,
+                                        const py::tuple& latents,
+                                        float speed) {
+    auto model = m_model->attr("tts_model");
+    auto config = model.attr("config");
+
+    // same settings as used by synthesizer for xtts
+    auto out = model.attr("inference")(
+        "text"_a = text,
+        "language"_a =
+            m_config.lang_code.empty() ? m_config.lang : m_config.lang_code,
+        "gpt_cond_latent"_a = latents[0], "speaker_embedding"_a = latents[1],
+        "temperature"_a = config.attr("temperature"),
+        "length_penalty"_a = config.attr("length_penalty"),
+        "repetition_penalty"_a = config.attr("repetition_penalty"),
+        "top_k"_a = config.attr("top_k"), "top_p"_a = config.attr("top_p"),
+        "speed"_a = speed);
+
+    return out["wav"];
+}
+
 bool coqui_engine::model_supports_speed() const {
     return m_speed_supported || m_initial_length_scale ||
            m_initial_duration_threshold;
@@ -15,6 +15,7 @@
 
 #include <optional>
 #include <string>
+#include <utility>
 
 #include "tts_engine.hpp"
 
@@ -35,6 +36,10 @@ class coqui_engine : public tts_engine {
     std::optional<float> m_initial_length_scale;
     std::optional<float> m_initial_duration_threshold;
     bool m_speed_supported = false;
+    bool m_xtts = false;
+    // gpt conditioning latent and speaker embedding of ref voice with its
+    // content hash
+    std::optional<std::pair<size_t, py::tuple>> m_ref_voice_latents;
 
     bool model_created() const final;
     bool model_supports_speed() const final;
@@ -42,6 +47,9 @@ class coqui_engine : public tts_engine {
     bool encode_speech_impl(const std::string& text,
                             const std::string& out_file) final;
     void stop();
+    std::optional<py::tuple> ref_voice_latents();
+    py::object xtts_inference(const std::string& text,
+                              const py::tuple& latents, float speed);
     static std::string fix_config_file(const std::string& config_file,
                                        const std::string& dir, bool vocoder);
 };
@@ -7,13 +7,26 @@
 
 #include "cpu_tools.hpp"
 
+#include <dirent.h>
+#include <sched.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
 #include <algorithm>
 #include <array>
+#include <cerrno>
+#include <cstring>
 #include <fstream>
 #include <iterator>
+#include <limits>
+#include <map>
 #include <regex>
+#include <set>
+#include <sstream>
 #include <string>
 #include <thread>
+#include <utility>
 
 #include "logger.hpp"
 
@@ -49,13 +62,326 @@ std::ostream& operator<<(std::ostream& os, cpu_tools::cpuinfo_t cpuinfo) {
         os << "f16c, ";
     if (cpuinfo.feature_flags & cpu_tools::feature_flags_t::asimd)
         os << "asimd, ";
+    if (cpuinfo.feature_flags & cpu_tools::feature_flags_t::sse4)
+        os << "sse4, ";
+    if (cpuinfo.feature_flags & cpu_tools::feature_flags_t::avxvnni)
+        os << "avxvnni, ";
+    if (cpuinfo.feature_flags & cpu_tools::feature_flags_t::asimddp)
+        os << "asimddp, ";
+    if (cpuinfo.feature_flags & cpu_tools::feature_flags_t::asimdhp)
+        os << "asimdhp, ";
 
     os << "]";
 
     return os;
 }
 
+static std::string cpu_list_to_str(const std::vector<unsigned int>& cpus) {
+    std::string str;
+
+    for (auto cpu : cpus) {
+        if (!str.empty()) str += ",";
+        str += std::to_string(cpu);
+    }
+
+    return str;
+}
+
+std::ostream& operator<<(std::ostream& os,
+                         const cpu_tools::topology_t& topology) {
+    os << "cpus=" << topology.cpus.size()
+       << ", physical-cores=" << topology.physical_cores
+       << ", packages=" << topology.packages
+       << ", numa-nodes=" << topology.numa_nodes
+       << ", llc-size=" << topology.llc_size_kb << "K"
+       << ", decode-cpus=[" << cpu_list_to_str(topology.decode_cpus) << "]"
+       << ", audio-cpus=[" << cpu_list_to_str(topology.audio_cpus) << "]";
+
+    return os;
+}
+
+std::ostream& operator<<(std::ostream& os, cpu_tools::thread_role_t role) {
+    switch (role) {
+        case cpu_tools::thread_role_t::decode:
+            os << "decode";
+            break;
+        case cpu_tools::thread_role_t::audio:
+            os << "audio";
+            break;
+    }
+
+    return os;
+}
+
 namespace cpu_tools {
+// cores with capacity more than this percent above the slowest cores are
+// considered fast (prime and big cores, intel p-cores), small differences
+// (e.g. favored cores of symmetric cpu) are ignored
+static const unsigned int slow_capacity_margin_percent = 15;
+// when there are fewer fast cores, all cores are used for decoding, so a
+// small big cluster doesn't limit number of decoding threads
+static const unsigned int min_fast_cores = 4;
+// nice value for audio threads, lowering nice usually requires privileges,
+// so it is only best effort
+static const int audio_thread_nice = -5;
+
+template <typename T>
+static bool read_value(const std::string& file_path, T& value) {
+    std::ifstream file{file_path};
+    if (!file) return false;
+    return static_cast<bool>(file >> value);
+}
+
+static unsigned int parse_size_kb(const std::string& size) {
+    try {
+        size_t pos = 0;
+        auto value = std::stoul(size, &pos);
+        auto unit = pos < size.size() ? size[pos] : 'K';
+        if (unit == 'M') return value * 1024;
+        if (unit == 'G') return value * 1024 * 1024;
+        if (unit != 'K') return value / 1024;
+        return value;
+    } catch (const std::exception&) {
+        return 0;
+    }
+}
+
+std::vector<unsigned int> parse_cpu_list(const std::string& list) {
+    std::vector<unsigned int> cpus;
+
+    std::istringstream is{list};
+    for (std::string range; std::getline(is, range, ',');) {
+        try {
+            auto dash = range.find('-');
+            auto first = std::stoul(range.substr(0, dash));
+            auto last = dash == std::string::npos
+                            ? first
+                            : std::stoul(range.substr(dash + 1));
+            for (auto cpu = first; cpu <= last; ++cpu) cpus.push_back(cpu);
+        } catch (const std::exception&) {
+            continue;
+        }
+    }
+
+    return cpus;
+}
+
+static std::vector<unsigned int> list_cpu_dirs(const std::string& dir_path) {
+    std::vector<unsigned int> cpus;
+
+    auto* dirp = opendir(dir_path.c_str());
+    if (!dirp) return cpus;
+
+    while (auto* dirent = readdir(dirp)) {
+        std::string fn{dirent->d_name};
+        if (fn.size() < 4 || fn.compare(0, 3, "cpu") != 0 ||
+            !std::all_of(fn.cbegin() + 3, fn.cend(), ::isdigit))
+            continue;
+        cpus.push_back(std::stoul(fn.substr(3)));
+    }
+
+    closedir(dirp);
+
+    std::sort(cpus.begin(), cpus.end());
+
+    return cpus;
+}
+
+static int numa_node_of_cpu(const std::string& cpu_path) {
+    auto* dirp = opendir(cpu_path.c_str());
+    if (!dirp) return -1;
+
+    int node = -1;
+
+    while (auto* dirent = readdir(dirp)) {
+        std::string fn{dirent->d_name};
+        if (fn.size() > 4 && fn.compare(0, 4, "node") == 0 &&
+            std::all_of(fn.cbegin() + 4, fn.cend(), ::isdigit)) {
+            node = std::stoi(fn.substr(4));
+            break;
+        }
+    }
+
+    closedir(dirp);
+
+    return node;
+}
+
+static unsigned int llc_size_of_cpu(const std::string& cpu_path) {
+    unsigned int max_level = 0;
+    unsigned int size_kb = 0;
+
+    for (int i = 0;; ++i) {
+        auto index_path = cpu_path + "/cache/index" + std::to_string(i);
+
+        unsigned int level = 0;
+        if (!read_value(index_path + "/level", level)) break;
+
+        std::string size;
+        if (level >= max_level && read_value(index_path + "/size", size)) {
+            max_level = level;
+            size_kb = parse_size_kb(size);
+        }
+    }
+
+    return size_kb;
+}
+
+topology_t parse_topology(const std::string& sysfs_cpu_dir) {
+    topology_t topology;
+
+    std::vector<unsigned int> ids;
+    if (std::string online; read_value(sysfs_cpu_dir + "/online", online))
+        ids = parse_cpu_list(online);
+    if (ids.empty()) ids = list_cpu_dirs(sysfs_cpu_dir);
+
+    bool has_cpu_capacity = true;
+
+    for (auto id : ids) {
+        auto cpu_path = sysfs_cpu_dir + "/cpu" + std::to_string(id);
+
+        cpu_t cpu;
+        cpu.id = id;
+        read_value(cpu_path + "/topology/core_id", cpu.core_id);
+        read_value(cpu_path + "/topology/physical_package_id", cpu.package_id);
+        cpu.numa_node = numa_node_of_cpu(cpu_path);
+
+        // cpu_capacity is provided on asymmetric arm systems
+        if (!read_value(cpu_path + "/cpu_capacity", cpu.capacity))
+            has_cpu_capacity = false;
+
+        topology.llc_size_kb =
+            std::max(topology.llc_size_kb, llc_size_of_cpu(cpu_path));
+
+        topology.cpus.push_back(cpu);
+    }
+
+    if (!has_cpu_capacity) {
+        for (auto& cpu : topology.cpus) {
+            cpu.capacity = 0;
+            read_value(sysfs_cpu_dir + "/cpu" + std::to_string(cpu.id) +
+                           "/cpufreq/cpuinfo_max_freq",
+                       cpu.capacity);
+        }
+    }
+
+    auto core_of_cpu = [](const cpu_t& cpu) {
+        return std::make_pair(cpu.package_id,
+                              cpu.core_id < 0 ? -1 - static_cast<int>(cpu.id)
+                                              : cpu.core_id);
+    };
+
+    std::set<std::pair<int, int>> cores;
+    std::set<int> packages, nodes;
+    auto min_capacity = std::numeric_limits<unsigned int>::max();
+
+    for (const auto& cpu : topology.cpus) {
+        cores.insert(core_of_cpu(cpu));
+        packages.insert(cpu.package_id);
+        nodes.insert(cpu.numa_node);
+        min_capacity = std::min(min_capacity, cpu.capacity);
+    }
+
+    topology.physical_cores = cores.size();
+    topology.packages = packages.size();
+    topology.numa_nodes = nodes.size();
+
+    // all clusters above the slowest one are fast, so on tri-cluster cpus
+    // both prime and big cores are used
+    auto above_slowest = [&](const cpu_t& cpu) {
+        return 100ull * cpu.capacity >
+               (100ull + slow_capacity_margin_percent) * min_capacity;
+    };
+
+    std::set<std::pair<int, int>> fast_cores;
+    for (const auto& cpu : topology.cpus)
+        if (above_slowest(cpu)) fast_cores.insert(core_of_cpu(cpu));
+
+    const bool all_fast = fast_cores.size() < min_fast_cores;
+
+    auto fast = [&](const cpu_t& cpu) {
+        return all_fast || above_slowest(cpu);
+    };
+
+    // decoding threads share model weights, so they are kept in the numa
+    // node with most fast cores
+    std::map<int, unsigned int> fast_per_node;
+    for (const auto& cpu : topology.cpus)
+        if (fast(cpu)) ++fast_per_node[cpu.numa_node];
+
+    auto node = std::max_element(fast_per_node.cbegin(), fast_per_node.cend(),
+                                 [](const auto& a, const auto& b) {
+                                     return a.second < b.second;
+                                 });
+
+    std::set<std::pair<int, int>> decode_cores;
+
+    for (const auto& cpu : topology.cpus) {
+        auto core = core_of_cpu(cpu);
+
+        // smt siblings do not add much to compute-bound inference
+        if (fast(cpu) && node != fast_per_node.cend() &&
+            cpu.numa_node == node->first && decode_cores.insert(core).second)
+            topology.decode_cpus.push_back(cpu.id);
+        else
+            topology.audio_cpus.push_back(cpu.id);
+    }
+
+    return topology;
+}
+
+topology_t topology() {
+    static auto topology = [] {
+        auto topology = parse_topology("/sys/devices/system/cpu");
+
+        LOGD("cpu topology: " << topology);
+
+        return topology;
+    }();
+
+    return topology;
+}
+
+unsigned int decode_threads() {
+    auto size = topology().decode_cpus.size();
+    if (size > 0) return size;
+
+    return std::max(1u, std::thread::hardware_concurrency());
+}
+
+static bool set_affinity(const std::vector<unsigned int>& cpus) {
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    for (auto cpu : cpus) CPU_SET(cpu, &set);
+
+    // affects only calling thread
+    return sched_setaffinity(0, sizeof(set), &set) == 0;
+}
+
+void set_thread_policy(thread_role_t role) {
+    const auto& topology = cpu_tools::topology();
+
+    const auto& cpus = role == thread_role_t::decode ? topology.decode_cpus
+                                                     : topology.audio_cpus;
+
+    // pinning to all cpus is the same as no pinning
+    if (!cpus.empty() && cpus.size() < topology.cpus.size()) {
+        if (set_affinity(cpus))
+            LOGD("thread affinity: role=" << role << ", cpus=["
+                                          << cpu_list_to_str(cpus) << "]");
+        else
+            LOGW("failed to set thread affinity: " << std::strerror(errno));
+    }
+
+    if (role == thread_role_t::audio) {
+        if (setpriority(PRIO_PROCESS, static_cast<id_t>(syscall(SYS_gettid)),
+                        audio_thread_nice) == 0)
+            LOGD("thread priority: role=" << role
+                                          << ", nice=" << audio_thread_nice);
+        else
+            LOGD("can't set thread priority: " << std::strerror(errno));
+    }
+}
 
 arch_t arch() {
 #ifdef ARCH_X86_64
@@ -83,6 +409,9 @@ cpuinfo_t cpuinfo() {
 }
 
 cpuinfo_t parse_cpuinfo(std::istream& stream) {
+    static const std::array<std::string, 5> avx512_flags = {
+        "avx512f", "avx512cd", "avx512vl", "avx512dq", "avx512bw"};
+
     cpuinfo_t cpuinfo;
 
     try {
@@ -105,7 +434,12 @@ cpuinfo_t parse_cpuinfo(std::istream& stream) {
                     cpuinfo.feature_flags |= feature_flags_t::avx;
                 if (pieces_match[2].str().find("avx2") != std::string::npos)
                     cpuinfo.feature_flags |= feature_flags_t::avx2;
-                if (pieces_match[2].str().find("avx512") != std::string::npos)
+                // subsets enabled in avx512 builds
+                if (std::all_of(avx512_flags.cbegin(), avx512_flags.cend(),
+                                [&](const auto& flag) {
+                                    return pieces_match[2].str().find(flag) !=
+                                           std::string::npos;
+                                }))
                     cpuinfo.feature_flags |= feature_flags_t::avx512;
                 if (pieces_match[2].str().find("fma") != std::string::npos)
                     cpuinfo.feature_flags |= feature_flags_t::fma;
@@ -113,6 +447,15 @@ cpuinfo_t parse_cpuinfo(std::istream& stream) {
                     cpuinfo.feature_flags |= feature_flags_t::f16c;
                 if (pieces_match[2].str().find("asimd") != std::string::npos)
                     cpuinfo.feature_flags |= feature_flags_t::asimd;
+                if (pieces_match[2].str().find("sse4_1") != std::string::npos)
+                    cpuinfo.feature_flags |= feature_flags_t::sse4;
+                if (pieces_match[2].str().find("avx_vnni") !=
+                    std::string::npos)
+                    cpuinfo.feature_flags |= feature_flags_t::avxvnni;
+                if (pieces_match[2].str().find("asimddp") != std::string::npos)
+                    cpuinfo.feature_flags |= feature_flags_t::asimddp;
+                if (pieces_match[2].str().find("asimdhp") != std::string::npos)
+                    cpuinfo.feature_flags |= feature_flags_t::asimdhp;
 
                 LOGD("cpu flags: " << pieces_match[2].str());
                 flags_done = true;
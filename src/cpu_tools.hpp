@@ -11,6 +11,7 @@
 #include <iostream>
 #include <istream>
 #include <string>
+#include <vector>
 
 namespace cpu_tools {
 enum class arch_t { unknown, x86_64, arm32, arm64 };
@@ -22,7 +23,11 @@ enum feature_flags_t : unsigned int {
     avx512 = 1 << 2,
     fma = 1 << 3,
     f16c = 1 << 4,
-    asimd = 1 << 5
+    asimd = 1 << 5,
+    sse4 = 1 << 6,
+    avxvnni = 1 << 7,
+    asimddp = 1 << 8, /*armv8.2 dot product*/
+    asimdhp = 1 << 9  /*armv8.2 half-precision arithmetic*/
 };
 
 struct cpuinfo_t {
@@ -35,12 +40,51 @@ struct cpuinfo_t {
     }
 };
 
+struct cpu_t {
+    unsigned int id = 0;
+    int core_id = -1;
+    int package_id = -1;
+    int numa_node = -1;
+    // relative performance, cpu_capacity or max frequency (kHz)
+    unsigned int capacity = 0;
+};
+
+struct topology_t {
+    std::vector<cpu_t> cpus;
+    unsigned int physical_cores = 0;
+    unsigned int packages = 0;
+    unsigned int numa_nodes = 0;
+    // size of the last-level cache
+    unsigned int llc_size_kb = 0;
+    // one logical cpu per physical core of the fast cores (all clusters
+    // above the slowest one, or all cores when there are only few fast
+    // cores) in one numa node, used for compute-heavy threads
+    std::vector<unsigned int> decode_cpus;
+    // remaining cpus (little cores, smt siblings, other numa nodes), used
+    // for latency-sensitive threads
+    std::vector<unsigned int> audio_cpus;
+};
+
+// decode: thread that runs inference (its workers inherit affinity)
+// audio: thread that processes audio samples (denoising, vad)
+enum class thread_role_t { decode, audio };
+
 cpuinfo_t cpuinfo();
 cpuinfo_t parse_cpuinfo(std::istream& stream);
+topology_t topology();
+topology_t parse_topology(const std::string& sysfs_cpu_dir);
+std::vector<unsigned int> parse_cpu_list(const std::string& list);
+// number of threads that inference engine should use
+unsigned int decode_threads();
+// sets affinity and priority of the calling thread
+void set_thread_policy(thread_role_t role);
 arch_t arch();
 }  // namespace cpu_tools
 
 std::ostream& operator<<(std::ostream& os, cpu_tools::arch_t arch);
 std::ostream& operator<<(std::ostream& os, cpu_tools::cpuinfo_t cpuinfo);
+std::ostream& operator<<(std::ostream& os,
+                         const cpu_tools::topology_t& topology);
+std::ostream& operator<<(std::ostream& os, cpu_tools::thread_role_t role);
 
 #endif // CPU_TOOLS_CPP
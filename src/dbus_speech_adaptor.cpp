@@ -227,6 +227,14 @@ int SpeechAdaptor::KeepAliveTask(int task)
     return timer;
 }
 
+QString SpeechAdaptor::Metrics()
+{
+    // handle method call org.mkiol.Speech.Metrics
+    QString metrics;
+    QMetaObject::invokeMethod(parent(), "Metrics", Q_RETURN_ARG(QString, metrics));
+    return metrics;
+}
+
 QVariantMap SpeechAdaptor::MntGetOutLangs(const QString &lang)
 {
     // handle method call org.mkiol.Speech.MntGetOutLangs
@@ -267,6 +275,22 @@ double SpeechAdaptor::SttGetFileTranscribeProgress(int task)
     return progress;
 }
 
+QVariantMap SpeechAdaptor::SttGetIntermediateText(int task)
+{
+    // handle method call org.mkiol.Speech.SttGetIntermediateText
+    QVariantMap text;
+    QMetaObject::invokeMethod(parent(), "SttGetIntermediateText", Q_RETURN_ARG(QVariantMap, text), Q_ARG(int, task));
+    return text;
+}
+
+QVariantList SpeechAdaptor::SttGetTranscribeFilesResults(int task)
+{
+    // handle method call org.mkiol.Speech.SttGetTranscribeFilesResults
+    QVariantList results;
+    QMetaObject::invokeMethod(parent(), "SttGetTranscribeFilesResults", Q_RETURN_ARG(QVariantList, results), Q_ARG(int, task));
+    return results;
+}
+
 int SpeechAdaptor::SttStartListen(int mode, const QString &lang, const QString &out_lang)
 {
     // handle method call org.mkiol.Speech.SttStartListen
@@ -299,6 +323,14 @@ int SpeechAdaptor::SttTranscribeFile(const QString &file, const QString &lang, c
     return task;
 }
 
+int SpeechAdaptor::SttTranscribeFiles(const QStringList &files, const QString &lang, const QString &out_lang, const QVariantMap &options)
+{
+    // handle method call org.mkiol.Speech.SttTranscribeFiles
+    int task;
+    QMetaObject::invokeMethod(parent(), "SttTranscribeFiles", Q_RETURN_ARG(int, task), Q_ARG(QStringList, files), Q_ARG(QString, lang), Q_ARG(QString, out_lang), Q_ARG(QVariantMap, options));
+    return task;
+}
+
 double SpeechAdaptor::TtsGetSpeechToFileProgress(int task)
 {
     // handle method call org.mkiol.Speech.TtsGetSpeechToFileProgress
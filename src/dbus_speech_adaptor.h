@@ -136,6 +136,13 @@ class SpeechAdaptor: public QDBusAbstractAdaptor
 "      <arg direction=\"out\" type=\"s\" name=\"lang\"/>\n"
 "      <arg direction=\"out\" type=\"i\" name=\"task\"/>\n"
 "    </signal>\n"
+"    <signal name=\"SttIntermediateTextChanged\">\n"
+"      <arg direction=\"out\" type=\"i\" name=\"task\"/>\n"
+"      <arg direction=\"out\" type=\"i\" name=\"base_revision\"/>\n"
+"      <arg direction=\"out\" type=\"i\" name=\"offset\"/>\n"
+"      <arg direction=\"out\" type=\"i\" name=\"replaced\"/>\n"
+"      <arg direction=\"out\" type=\"s\" name=\"text\"/>\n"
+"    </signal>\n"
 "    <signal name=\"SttTextDecoded\">\n"
 "      <arg direction=\"out\" type=\"s\" name=\"text\"/>\n"
 "      <arg direction=\"out\" type=\"s\" name=\"lang\"/>\n"
@@ -144,6 +151,12 @@ class SpeechAdaptor: public QDBusAbstractAdaptor
 "    <signal name=\"SttFileTranscribeFinished\">\n"
 "      <arg direction=\"out\" type=\"i\" name=\"task\"/>\n"
 "    </signal>\n"
+"    <signal name=\"SttTranscribeFilesFileFinished\">\n"
+"      <arg direction=\"out\" type=\"i\" name=\"task\"/>\n"
+"      <arg direction=\"out\" type=\"s\" name=\"file\"/>\n"
+"      <arg direction=\"out\" type=\"s\" name=\"out_file\"/>\n"
+"      <arg direction=\"out\" type=\"b\" name=\"ok\"/>\n"
+"    </signal>\n"
 "    <signal name=\"TtsPlaySpeechFinished\">\n"
 "      <arg direction=\"out\" type=\"i\" name=\"task\"/>\n"
 "    </signal>\n"
@@ -178,6 +191,16 @@ class SpeechAdaptor: public QDBusAbstractAdaptor
 "      <arg direction=\"in\" type=\"i\" name=\"task\"/>\n"
 "      <arg direction=\"out\" type=\"d\" name=\"progress\"/>\n"
 "    </method>\n"
+"    <method name=\"SttGetIntermediateText\">\n"
+"      <annotation value=\"QVariantMap\" name=\"org.qtproject.QtDBus.QtTypeName.Out0\"/>\n"
+"      <arg direction=\"in\" type=\"i\" name=\"task\"/>\n"
+"      <arg direction=\"out\" type=\"a{sv}\" name=\"text\"/>\n"
+"    </method>\n"
+"    <method name=\"SttGetTranscribeFilesResults\">\n"
+"      <annotation value=\"QVariantList\" name=\"org.qtproject.QtDBus.QtTypeName.Out0\"/>\n"
+"      <arg direction=\"in\" type=\"i\" name=\"task\"/>\n"
+"      <arg direction=\"out\" type=\"av\" name=\"results\"/>\n"
+"    </method>\n"
 "    <method name=\"TtsGetSpeechToFileProgress\">\n"
 "      <arg direction=\"in\" type=\"i\" name=\"task\"/>\n"
 "      <arg direction=\"out\" type=\"d\" name=\"progress\"/>\n"
@@ -230,6 +253,14 @@ class SpeechAdaptor: public QDBusAbstractAdaptor
 "      <arg direction=\"in\" type=\"a{sv}\" name=\"options\"/>\n"
 "      <arg direction=\"out\" type=\"i\" name=\"task\"/>\n"
 "    </method>\n"
+"    <method name=\"SttTranscribeFiles\">\n"
+"      <annotation value=\"QVariantMap\" name=\"org.qtproject.QtDBus.QtTypeName.In3\"/>\n"
+"      <arg direction=\"in\" type=\"as\" name=\"files\"/>\n"
+"      <arg direction=\"in\" type=\"s\" name=\"lang\"/>\n"
+"      <arg direction=\"in\" type=\"s\" name=\"out_lang\"/>\n"
+"      <arg direction=\"in\" type=\"a{sv}\" name=\"options\"/>\n"
+"      <arg direction=\"out\" type=\"i\" name=\"task\"/>\n"
+"    </method>\n"
 "    <method name=\"TtsPlaySpeech\">\n"
 "      <arg direction=\"in\" type=\"s\" name=\"text\"/>\n"
 "      <arg direction=\"in\" type=\"s\" name=\"lang\"/>\n"
@@ -270,6 +301,9 @@ class SpeechAdaptor: public QDBusAbstractAdaptor
 "      <arg direction=\"out\" type=\"a{sv}\" name=\"features\"/>\n"
 "    </method>\n"
 "    <signal name=\"FeaturesAvailabilityUpdated\"/>\n"
+"    <method name=\"Metrics\">\n"
+"      <arg direction=\"out\" type=\"s\" name=\"metrics\"/>\n"
+"    </method>\n"
 "    <method name=\"Reload\">\n"
 "      <arg direction=\"out\" type=\"i\" name=\"result\"/>\n"
 "    </method>\n"
@@ -378,15 +412,19 @@ public Q_SLOTS: // METHODS
     QVariantMap FeaturesAvailability();
     int KeepAliveService();
     int KeepAliveTask(int task);
+    QString Metrics();
     QVariantMap MntGetOutLangs(const QString &lang);
     int MntTranslate(const QString &text, const QString &lang, const QString &out_lang);
     int MntTranslate2(const QString &text, const QString &lang, const QString &out_lang, const QVariantMap &options);
     int Reload();
     double SttGetFileTranscribeProgress(int task);
+    QVariantMap SttGetIntermediateText(int task);
+    QVariantList SttGetTranscribeFilesResults(int task);
     int SttStartListen(int mode, const QString &lang, const QString &out_lang);
     int SttStartListen2(int mode, const QString &lang, const QString &out_lang, const QVariantMap &options);
     int SttStopListen(int task);
     int SttTranscribeFile(const QString &file, const QString &lang, const QString &out_lang, const QVariantMap &options);
+    int SttTranscribeFiles(const QStringList &files, const QString &lang, const QString &out_lang, const QVariantMap &options);
     double TtsGetSpeechToFileProgress(int task);
     int TtsPauseSpeech(int task);
     int TtsPlaySpeech(const QString &text, const QString &lang);
@@ -411,11 +449,13 @@ Q_SIGNALS: // SIGNALS
     void StatePropertyChanged(int state);
     void SttFileTranscribeFinished(int task);
     void SttFileTranscribeProgress(double progress, int task);
+    void SttIntermediateTextChanged(int task, int base_revision, int offset, int replaced, const QString &text);
     void SttIntermediateTextDecoded(const QString &text, const QString &lang, int task);
     void SttLangListChanged(const QVariantList &langs);
     void SttLangsPropertyChanged(const QVariantMap &langs);
     void SttModelsPropertyChanged(const QVariantMap &models);
     void SttTextDecoded(const QString &text, const QString &lang, int task);
+    void SttTranscribeFilesFileFinished(int task, const QString &file, const QString &out_file, bool ok);
     void SttTtsLangListChanged(const QVariantList &langs);
     void TaskStatePropertyChanged(int taskState);
     void TtsLangListChanged(const QVariantList &langs);
@@ -158,6 +158,12 @@ public Q_SLOTS: // METHODS
         return asyncCallWithArgumentList(QStringLiteral("KeepAliveTask"), argumentList);
     }
 
+    inline QDBusPendingReply<QString> Metrics()
+    {
+        QList<QVariant> argumentList;
+        return asyncCallWithArgumentList(QStringLiteral("Metrics"), argumentList);
+    }
+
     inline QDBusPendingReply<QVariantMap> MntGetOutLangs(const QString &lang)
     {
         QList<QVariant> argumentList;
@@ -192,6 +198,20 @@ public Q_SLOTS: // METHODS
         return asyncCallWithArgumentList(QStringLiteral("SttGetFileTranscribeProgress"), argumentList);
     }
 
+    inline QDBusPendingReply<QVariantMap> SttGetIntermediateText(int task)
+    {
+        QList<QVariant> argumentList;
+        argumentList << QVariant::fromValue(task);
+        return asyncCallWithArgumentList(QStringLiteral("SttGetIntermediateText"), argumentList);
+    }
+
+    inline QDBusPendingReply<QVariantList> SttGetTranscribeFilesResults(int task)
+    {
+        QList<QVariant> argumentList;
+        argumentList << QVariant::fromValue(task);
+        return asyncCallWithArgumentList(QStringLiteral("SttGetTranscribeFilesResults"), argumentList);
+    }
+
     inline QDBusPendingReply<int> SttStartListen(int mode, const QString &lang, const QString &out_lang)
     {
         QList<QVariant> argumentList;
@@ -220,6 +240,13 @@ public Q_SLOTS: // METHODS
         return asyncCallWithArgumentList(QStringLiteral("SttTranscribeFile"), argumentList);
     }
 
+    inline QDBusPendingReply<int> SttTranscribeFiles(const QStringList &files, const QString &lang, const QString &out_lang, const QVariantMap &options)
+    {
+        QList<QVariant> argumentList;
+        argumentList << QVariant::fromValue(files) << QVariant::fromValue(lang) << QVariant::fromValue(out_lang) << QVariant::fromValue(options);
+        return asyncCallWithArgumentList(QStringLiteral("SttTranscribeFiles"), argumentList);
+    }
+
     inline QDBusPendingReply<double> TtsGetSpeechToFileProgress(int task)
     {
         QList<QVariant> argumentList;
@@ -286,11 +313,13 @@ Q_SIGNALS: // SIGNALS
     void StatePropertyChanged(int state);
     void SttFileTranscribeFinished(int task);
     void SttFileTranscribeProgress(double progress, int task);
+    void SttIntermediateTextChanged(int task, int base_revision, int offset, int replaced, const QString &text);
     void SttIntermediateTextDecoded(const QString &text, const QString &lang, int task);
     void SttLangListChanged(const QVariantList &langs);
     void SttLangsPropertyChanged(const QVariantMap &langs);
     void SttModelsPropertyChanged(const QVariantMap &models);
     void SttTextDecoded(const QString &text, const QString &lang, int task);
+    void SttTranscribeFilesFileFinished(int task, const QString &file, const QString &out_file, bool ok);
     void SttTtsLangListChanged(const QVariantList &langs);
     void TaskStatePropertyChanged(int taskState);
     void TtsLangListChanged(const QVariantList &langs);
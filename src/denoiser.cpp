@@ -16,9 +16,10 @@ extern "C" {
 #include <stdexcept>
 
 #include "logger.hpp"
+#include "metrics.hpp"
 
 denoiser::denoiser(int sample_rate, int tasks, uint64_t full_size)
-    : m_task_flags{tasks}, m_full_size{full_size} {
+    : m_task_flags{tasks}, m_full_size{full_size}, m_sample_rate{sample_rate} {
     if ((m_task_flags & task_denoise) || (m_task_flags & task_probs)) {
         auto* model = rnnoise_get_model("orig");
         if (model == nullptr) LOGE("rnnoise model not found");
@@ -102,6 +103,9 @@ void denoiser::process_char(char* buf, size_t size) {
 }
 
 void denoiser::process(sample_t* buf, size_t size) {
+    metrics::scoped_timer timer{metrics::stage_t::denoise,
+                                metrics::samples_to_ms(size, m_sample_rate)};
+
     if ((m_task_flags & task_denoise) || (m_task_flags & task_probs)) {
         frame_t frame;
 
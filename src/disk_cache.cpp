@@ -0,0 +1,259 @@
+/* Copyright (C) 2024 Michal Kosciesza <michal@mkiol.net>
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+#include "disk_cache.hpp"
+
+#include <fcntl.h>
+#include <sys/file.h>
+#include <unistd.h>
+
+#include <array>
+#include <cstdio>
+#include <limits>
+
+#include "logger.hpp"
+
+disk_cache::disk_cache(std::string file, size_t max_size)
+    : m_file{std::move(file)}, m_max_size{max_size} {
+    if (lock_file())
+        load();
+    else
+        LOGW("cache file is used by other process, cache is not persisted: "
+             << m_file);
+}
+
+disk_cache::~disk_cache() {
+    std::lock_guard lock{m_mtx};
+
+    if (m_file_size > m_size + m_magic.size()) compact();
+
+    m_log.close();
+
+    if (m_lock_fd >= 0) close(m_lock_fd);
+}
+
+bool disk_cache::lock_file() {
+    // separate lock file because cache file is replaced on compaction
+    auto lock_file = m_file + ".lock";
+
+    m_lock_fd = open(lock_file.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0600);
+    if (m_lock_fd < 0) {
+        LOGE("failed to open cache lock file: " << lock_file);
+        return false;
+    }
+
+    if (flock(m_lock_fd, LOCK_EX | LOCK_NB) != 0) {
+        close(m_lock_fd);
+        m_lock_fd = -1;
+        return false;
+    }
+
+    return true;
+}
+
+std::optional<std::string> disk_cache::get(const std::string& key) {
+    std::lock_guard lock{m_mtx};
+
+    auto it = m_index.find(key);
+    if (it == m_index.end()) return std::nullopt;
+
+    m_entries.splice(m_entries.begin(), m_entries, it->second);
+
+    return it->second->value;
+}
+
+void disk_cache::put(std::string key, std::string value) {
+    if (key.size() > std::numeric_limits<uint32_t>::max() ||
+        value.size() > std::numeric_limits<uint32_t>::max())
+        return;
+
+    // entry bigger than the whole budget is never stored
+    if (m_record_header_size + key.size() + value.size() > m_max_size) return;
+
+    std::lock_guard lock{m_mtx};
+
+    insert(std::move(key), std::move(value));
+
+    append_to_log(m_entries.front());
+
+    evict();
+
+    if (m_file_size > 2 * m_max_size) compact();
+}
+
+void disk_cache::clear() {
+    std::lock_guard lock{m_mtx};
+
+    m_index.clear();
+    m_entries.clear();
+    m_size = 0;
+
+    compact();
+}
+
+size_t disk_cache::size() const {
+    std::lock_guard lock{m_mtx};
+    return m_size;
+}
+
+size_t disk_cache::count() const {
+    std::lock_guard lock{m_mtx};
+    return m_entries.size();
+}
+
+void disk_cache::insert(std::string key, std::string value) {
+    if (auto it = m_index.find(key); it != m_index.end()) {
+        m_size -= it->second->size();
+        m_entries.erase(it->second);
+        m_index.erase(it);
+    }
+
+    m_entries.push_front({std::move(key), std::move(value)});
+    m_size += m_entries.front().size();
+    m_index.emplace(m_entries.front().key, m_entries.begin());
+}
+
+void disk_cache::evict() {
+    while (m_size > m_max_size && !m_entries.empty()) {
+        auto& entry = m_entries.back();
+        m_size -= entry.size();
+        m_index.erase(entry.key);
+        m_entries.pop_back();
+    }
+}
+
+void disk_cache::load() {
+    std::ifstream is{m_file, std::ios::binary};
+
+    bool valid = false;
+
+    if (is) {
+        std::array<char, m_magic.size()> magic{};
+        is.read(magic.data(), magic.size());
+        valid = is.gcount() == static_cast<std::streamsize>(magic.size()) &&
+                std::string_view{magic.data(), magic.size()} == m_magic;
+        if (!valid) LOGW("invalid cache file: " << m_file);
+    }
+
+    if (valid) {
+        m_file_size = m_magic.size();
+
+        while (true) {
+            std::array<uint32_t, 2> sizes{};
+            is.read(reinterpret_cast<char*>(sizes.data()),
+                    m_record_header_size);
+            if (is.gcount() == 0) break;
+            if (is.gcount() != static_cast<std::streamsize>(
+                                   m_record_header_size)) {
+                valid = false;
+                break;
+            }
+
+            // such record could not be stored, so file is broken
+            if (m_record_header_size + sizes[0] + sizes[1] > m_max_size) {
+                valid = false;
+                break;
+            }
+
+            std::string key(sizes[0], '\0');
+            std::string value(sizes[1], '\0');
+            is.read(key.data(), key.size());
+            is.read(value.data(), value.size());
+            if (!is) {
+                valid = false;
+                break;
+            }
+
+            m_file_size += m_record_header_size + key.size() + value.size();
+
+            insert(std::move(key), std::move(value));
+        }
+
+        evict();
+
+        if (!valid) LOGW("cache file is truncated: " << m_file);
+    }
+
+    is.close();
+
+    LOGD("cache loaded: file=" << m_file << ", entries=" << m_entries.size()
+                               << ", size=" << m_size);
+
+    // stale or broken records are removed by rewriting the file
+    if (!valid || m_file_size > 2 * m_max_size)
+        compact();
+    else
+        open_log();
+}
+
+void disk_cache::open_log() {
+    m_log.close();
+    m_log.clear();
+    m_log.open(m_file, std::ios::binary | std::ios::app);
+    if (!m_log) LOGE("failed to open cache file: " << m_file);
+}
+
+void disk_cache::append_to_log(const entry_t& entry) {
+    if (!m_log.is_open() || !m_log) return;
+
+    std::array<uint32_t, 2> sizes{static_cast<uint32_t>(entry.key.size()),
+                                  static_cast<uint32_t>(entry.value.size())};
+    m_log.write(reinterpret_cast<const char*>(sizes.data()),
+                m_record_header_size);
+    m_log.write(entry.key.data(), entry.key.size());
+    m_log.write(entry.value.data(), entry.value.size());
+    m_log.flush();
+
+    m_file_size += entry.size();
+}
+
+void disk_cache::compact() {
+    if (m_lock_fd < 0) return;
+
+    m_log.close();
+
+    auto tmp_file = m_file + ".tmp";
+
+    {
+        std::ofstream os{tmp_file, std::ios::binary | std::ios::trunc};
+        if (!os) {
+            LOGE("failed to open cache file: " << tmp_file);
+            return;
+        }
+
+        os.write(m_magic.data(), m_magic.size());
+
+        // least recently used first, so loading restores the order
+        for (auto it = m_entries.crbegin(); it != m_entries.crend(); ++it) {
+            std::array<uint32_t, 2> sizes{
+                static_cast<uint32_t>(it->key.size()),
+                static_cast<uint32_t>(it->value.size())};
+            os.write(reinterpret_cast<const char*>(sizes.data()),
+                     m_record_header_size);
+            os.write(it->key.data(), it->key.size());
+            os.write(it->value.data(), it->value.size());
+        }
+
+        if (!os) {
+            LOGE("failed to write cache file: " << tmp_file);
+            unlink(tmp_file.c_str());
+            return;
+        }
+    }
+
+    if (std::rename(tmp_file.c_str(), m_file.c_str()) != 0) {
+        LOGE("failed to rename cache file: " << tmp_file);
+        unlink(tmp_file.c_str());
+        return;
+    }
+
+    m_file_size = m_magic.size() + m_size;
+
+    LOGD("cache compacted: file=" << m_file << ", size=" << m_file_size);
+
+    open_log();
+}
@@ -0,0 +1,75 @@
+/* Copyright (C) 2024 Michal Kosciesza <michal@mkiol.net>
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+#ifndef DISK_CACHE_HPP
+#define DISK_CACHE_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <list>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+// Persistent key-value cache with LRU eviction and size budget.
+// Entries are kept in memory and appended to a log file, which is
+// compacted when it grows above twice the budget. File is used by only one
+// cache at a time, when it is locked by other process, entries are kept
+// only in memory.
+
+class disk_cache {
+   public:
+    disk_cache(std::string file, size_t max_size);
+    ~disk_cache();
+    disk_cache(const disk_cache&) = delete;
+    disk_cache& operator=(const disk_cache&) = delete;
+    std::optional<std::string> get(const std::string& key);
+    void put(std::string key, std::string value);
+    void clear();
+    size_t size() const;
+    size_t count() const;
+    inline const std::string& file() const { return m_file; }
+
+   private:
+    inline static constexpr std::string_view m_magic{"DSCACHE1"};
+    inline static constexpr size_t m_record_header_size = 2 * sizeof(uint32_t);
+
+    struct entry_t {
+        std::string key;
+        std::string value;
+        inline size_t size() const {
+            return m_record_header_size + key.size() + value.size();
+        }
+    };
+    // most recently used entry is first
+    using entries_t = std::list<entry_t>;
+
+    std::string m_file;
+    size_t m_max_size = 0;
+    size_t m_size = 0;
+    size_t m_file_size = 0;
+    entries_t m_entries;
+    // keys are views of keys stored in m_entries
+    std::unordered_map<std::string_view, entries_t::iterator> m_index;
+    std::ofstream m_log;
+    // descriptor of lock file, held as long as cache uses the file
+    int m_lock_fd = -1;
+    mutable std::mutex m_mtx;
+
+    bool lock_file();
+    void load();
+    void insert(std::string key, std::string value);
+    void evict();
+    void append_to_log(const entry_t& entry);
+    void compact();
+    void open_log();
+};
+
+#endif  // DISK_CACHE_HPP
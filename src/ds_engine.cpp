@@ -16,6 +16,7 @@
 
 #include "cpu_tools.hpp"
 #include "logger.hpp"
+#include "metrics.hpp"
 
 using namespace std::chrono_literals;
 
@@ -178,7 +179,7 @@ stt_engine::samples_process_result_t ds_engine::process_buff() {
 
     if (sof) {
         m_speech_buf.clear();
-        m_start_time.reset();
+        reset_sentence_timer();
         m_vad.reset();
         reset_segment_counters();
 
@@ -187,14 +188,14 @@ stt_engine::samples_process_result_t ds_engine::process_buff() {
 
         m_decoding_duration = 0;
         m_decoded_samples = 0;
+        m_partial_scheduler.reset();
     }
 
     m_denoiser.process(m_in_buf.buf.data(), m_in_buf.size);
 
-    const auto& vad_buf =
-        m_vad.remove_silence(m_in_buf.buf.data(), m_in_buf.size);
+    const auto& vad_spans = m_vad.process(m_in_buf.buf.data(), m_in_buf.size);
 
-    bool vad_status = !vad_buf.empty();
+    bool vad_status = !vad_spans.empty();
 
     if (vad_status) {
         LOGD("vad: speech detected");
@@ -204,12 +205,15 @@ stt_engine::samples_process_result_t ds_engine::process_buff() {
             set_speech_detection_status(
                 speech_detection_status_t::speech_detected);
 
-        if (m_config.text_format == text_format_t::raw)
-            m_speech_buf.insert(m_speech_buf.end(), vad_buf.cbegin(),
-                                vad_buf.cend());
-        else
+        if (m_config.text_format == text_format_t::raw) {
+            for (const auto& span : vad_spans)
+                m_speech_buf.insert(m_speech_buf.end(),
+                                    m_vad.samples() + span.start,
+                                    m_vad.samples() + span.end);
+        } else {
             m_speech_buf.insert(m_speech_buf.end(), m_in_buf.buf.cbegin(),
                                 m_in_buf.buf.cbegin() + m_in_buf.size);
+        }
 
         restart_sentence_timer();
     } else {
@@ -254,12 +258,17 @@ stt_engine::samples_process_result_t ds_engine::process_buff() {
         m_segment_time_offset += m_segment_time_discarded_before;
         m_segment_time_discarded_before = 0;
 
-        decode_speech(m_speech_buf, final_decode);
+        {
+            metrics::scoped_timer timer{
+                metrics::stage_t::decode,
+                metrics::samples_to_ms(m_speech_buf.size(), m_sample_rate)};
+            decode_speech(m_speech_buf, final_decode);
+        }
 
         m_segment_time_offset += m_segment_time_discarded_after;
         m_segment_time_discarded_after = 0;
 
-        if (m_config.speech_started) set_state(state_t::idle);
+        if (speech_status()) set_state(state_t::idle);
 
         m_speech_buf.clear();
 
@@ -363,8 +372,20 @@ void ds_engine::decode_speech(const ds_buf_t& buf, bool eof) {
         set_intermediate_text(
             text_tools::segments_to_subrip_text(segments.second));
     } else {
+        // intermediate decoding runs over whole stream, so it is done only
+        // when partial result is due
+        if (!eof && !partial_due(buf.size())) {
+            LOGD("partial result not needed yet");
+            return;
+        }
+
+        auto partial_start = std::chrono::steady_clock::now();
+
         auto* cstr = eof ? m_ds_api.STT_FinishStream(m_ds_stream)
                          : m_ds_api.STT_IntermediateDecode(m_ds_stream);
+
+        if (!eof) partial_decoded(partial_start);
+
         std::string result{cstr};
         m_ds_api.STT_FreeString(cstr);
 
@@ -394,7 +415,7 @@ void ds_engine::decode_speech(const ds_buf_t& buf, bool eof) {
                  << ")");
         }
 
-        if (m_punctuator) result = m_punctuator->process(result);
+        if (m_punctuator) result = restore_punctuation(result, eof);
 
         if (!m_intermediate_text || m_intermediate_text != result)
             set_intermediate_text(result);
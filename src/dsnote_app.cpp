@@ -471,22 +471,25 @@ void dsnote_app::update_listen() {
     if (m_files_to_open.empty()) cancel();
 }
 
-void dsnote_app::handle_stt_intermediate_text(const QString &text,
-                                              const QString &lang, int task) {
+void dsnote_app::handle_stt_intermediate_text(int task, int base_revision,
+                                              int offset, int replaced,
+                                              const QString &text) {
     if (settings::instance()->launch_mode() ==
         settings::launch_mode_t::app_stanalone) {
 #ifdef DEBUG
-        qDebug() << "stt intermediate text decoded:" << text << lang << task;
+        qDebug() << "stt intermediate text changed:" << task << base_revision
+                 << offset << replaced << text;
 #else
-        qDebug() << "stt intermediate text decoded: ***" << lang << task;
+        qDebug() << "stt intermediate text changed: ***" << task
+                 << base_revision << offset << replaced;
 #endif
     } else {
 #ifdef DEBUG
-        qDebug() << "[dbus => app] signal SttIntermediateTextDecoded:" << text
-                 << lang << task;
+        qDebug() << "[dbus => app] signal SttIntermediateTextChanged:" << task
+                 << base_revision << offset << replaced << text;
 #else
-        qDebug() << "[dbus => app] signal SttIntermediateTextDecoded: ***"
-                 << lang << task;
+        qDebug() << "[dbus => app] signal SttIntermediateTextChanged: ***"
+                 << task << base_revision << offset << replaced;
 #endif
     }
 
@@ -495,8 +498,52 @@ void dsnote_app::handle_stt_intermediate_text(const QString &text,
         return;
     }
 
+    // every task starts with empty text
+    if (m_intermediate_text_task != task) {
+        m_intermediate_text_task = task;
+        m_intermediate_text_revision = 0;
+        m_intermediate_text.clear();
+    }
+
+    // change from offset 0 replaces whole text, so it can be applied even if
+    // text was cleared locally
+    if (base_revision != m_intermediate_text_revision || offset < 0 ||
+        replaced < 0 ||
+        (offset != 0 && offset + replaced != m_intermediate_text.size())) {
+        qWarning() << "intermediate text out of sync:" << base_revision
+                   << m_intermediate_text_revision;
+        sync_intermediate_text(task);
+        return;
+    }
+
+    m_intermediate_text_revision = base_revision + 1;
+
+    if (replaced == 0 && text.isEmpty()) return;
+
+    m_intermediate_text.truncate(offset);
+    m_intermediate_text.append(text);
+
+    emit intermediate_text_changed();
+}
+
+void dsnote_app::sync_intermediate_text(int task) {
+    QVariantMap snapshot;
+
+    if (settings::instance()->launch_mode() ==
+        settings::launch_mode_t::app_stanalone) {
+        snapshot = speech_service::instance()->stt_intermediate_text(task);
+    } else {
+        qDebug() << "[app => dbus] call SttGetIntermediateText";
+        snapshot = m_dbus_service.SttGetIntermediateText(task);
+    }
+
+    m_intermediate_text_task = task;
+    m_intermediate_text_revision =
+        snapshot.value(QStringLiteral("revision")).toInt();
+
+    auto text = snapshot.value(QStringLiteral("text")).toString();
     if (m_intermediate_text != text) {
-        m_intermediate_text = text;
+        m_intermediate_text = std::move(text);
         emit intermediate_text_changed();
     }
 }
@@ -507,12 +554,14 @@ static std::pair<QChar, QString> full_stop(const QString &lang) {
     return {'.', " "};
 }
 
-QString dsnote_app::insert_to_note(QString note, QString new_text,
+// Returns text that should be appended to the note
+QString dsnote_app::text_to_insert(const QString &note, QString new_text,
                                    const QString &lang,
                                    settings::insert_mode_t mode) {
-    if (new_text.isEmpty()) return note;
+    if (new_text.isEmpty()) return {};
 
-    QTextStream ss{&note, QIODevice::WriteOnly};
+    QString text;
+    QTextStream ss{&text, QIODevice::WriteOnly};
 
     auto [dot, space] = full_stop(lang);
 
@@ -545,7 +594,9 @@ QString dsnote_app::insert_to_note(QString note, QString new_text,
 
     if (new_text.at(new_text.size() - 1).isLetterOrNumber()) ss << dot;
 
-    return note;
+    ss.flush();
+
+    return text;
 }
 
 void dsnote_app::handle_stt_text_decoded(const QString &text,
@@ -574,19 +625,19 @@ void dsnote_app::handle_stt_text_decoded(const QString &text,
     switch (m_text_destination) {
         case text_destination_t::note_add:
             make_undo();
-            set_note(
-                insert_to_note(settings::instance()->note(), text, lang,
-                               settings::instance()->stt_tts_text_format() ==
-                                       settings::text_format_t::TextFormatSubRip
-                                   ? settings::insert_mode_t::InsertInLine
-                                   : settings::instance()->insert_mode()));
+            append_to_note(text_to_insert(
+                note(), text, lang,
+                settings::instance()->stt_tts_text_format() ==
+                        settings::text_format_t::TextFormatSubRip
+                    ? settings::insert_mode_t::InsertInLine
+                    : settings::instance()->insert_mode()));
             this->m_intermediate_text.clear();
             emit text_changed();
             emit intermediate_text_changed();
             break;
         case text_destination_t::note_replace:
             make_undo();
-            set_note(insert_to_note(QString{}, text, lang,
+            set_note(text_to_insert(QString{}, text, lang,
                                     settings::instance()->insert_mode()));
             m_text_destination = text_destination_t::note_add;
             this->m_intermediate_text.clear();
@@ -735,7 +786,7 @@ void dsnote_app::connect_service_signals() {
             },
             Qt::QueuedConnection);
         connect(speech_service::instance(),
-                &speech_service::stt_intermediate_text_decoded, this,
+                &speech_service::stt_intermediate_text_changed, this,
                 &dsnote_app::handle_stt_intermediate_text,
                 Qt::QueuedConnection);
         connect(speech_service::instance(), &speech_service::stt_text_decoded,
@@ -806,7 +857,7 @@ void dsnote_app::connect_service_signals() {
         connect(&m_dbus_service, &OrgMkiolSpeechInterface::ErrorOccured, this,
                 &dsnote_app::handle_service_error);
         connect(&m_dbus_service,
-                &OrgMkiolSpeechInterface::SttIntermediateTextDecoded, this,
+                &OrgMkiolSpeechInterface::SttIntermediateTextChanged, this,
                 &dsnote_app::handle_stt_intermediate_text);
         connect(&m_dbus_service, &OrgMkiolSpeechInterface::SttTextDecoded, this,
                 &dsnote_app::handle_stt_text_decoded);
@@ -2861,54 +2912,68 @@ void dsnote_app::set_translated_text(const QString text) {
 QString dsnote_app::note() const { return settings::instance()->note(); }
 
 void dsnote_app::set_note(const QString text) {
-    auto old = can_undo_or_redu_note();
+    auto old = std::make_pair(can_undo_note(), can_redo_note());
     settings::instance()->set_note(text);
-    if (old != can_undo_or_redu_note()) emit can_undo_or_redu_note_changed();
+    if (old != std::make_pair(can_undo_note(), can_redo_note()))
+        emit can_undo_or_redu_note_changed();
     if (text.isEmpty()) set_translated_text({});
 }
 
+void dsnote_app::append_to_note(const QString &text) {
+    auto old = std::make_pair(can_undo_note(), can_redo_note());
+    settings::instance()->append_note(text);
+    if (old != std::make_pair(can_undo_note(), can_redo_note()))
+        emit can_undo_or_redu_note_changed();
+}
+
 void dsnote_app::update_note(const QString &text, bool replace) {
     make_undo();
 
     if (replace) {
         set_note(text);
     } else {
-        set_note(insert_to_note(settings::instance()->note(), text, "",
-                                settings::instance()->insert_mode()));
+        append_to_note(text_to_insert(note(), text, "",
+                                      settings::instance()->insert_mode()));
     }
 }
 
-void dsnote_app::make_undo() {
-    auto old = can_undo_or_redu_note();
-    m_prev_text = note();
-    m_undo_flag = true;
-    if (old != can_undo_or_redu_note()) emit can_undo_or_redu_note_changed();
-}
+void dsnote_app::make_undo() { settings::instance()->make_note_undo_point(); }
 
 bool dsnote_app::can_undo_note() const {
-    return can_undo_or_redu_note() && m_undo_flag;
+    return settings::instance()->can_undo_note();
 }
 
 bool dsnote_app::can_redo_note() const {
-    return can_undo_or_redu_note() && !m_undo_flag;
+    return settings::instance()->can_redo_note();
 }
 
 bool dsnote_app::can_undo_or_redu_note() const {
-    return !m_prev_text.isEmpty() && m_prev_text != note();
+    return can_undo_note() || can_redo_note();
 }
 
-void dsnote_app::undo_or_redu_note() {
-    if (!can_undo_or_redu_note()) return;
+void dsnote_app::undo_note() {
+    if (!settings::instance()->undo_note()) return;
 
-    auto prev_text{m_prev_text};
-    m_prev_text = note();
-    set_note(prev_text);
+    if (note().isEmpty()) set_translated_text({});
 
-    m_undo_flag = !m_undo_flag;
+    emit can_undo_or_redu_note_changed();
+}
+
+void dsnote_app::redo_note() {
+    if (!settings::instance()->redo_note()) return;
+
+    if (note().isEmpty()) set_translated_text({});
 
     emit can_undo_or_redu_note_changed();
 }
 
+void dsnote_app::undo_or_redu_note() {
+    if (can_undo_note())
+        undo_note();
+    else
+        redo_note();
+}
+
 void dsnote_app::handle_translator_settings_changed() {
     if (settings::instance()->translator_mode()) {
         if (settings::instance()->translate_when_typing()) translate_delayed();
@@ -3016,8 +3081,8 @@ bool dsnote_app::import_text_file(const QString &input_file, bool replace) {
     if (replace) {
         set_note(file.readAll());
     } else {
-        set_note(insert_to_note(settings::instance()->note(), file.readAll(),
-                                "", settings::instance()->insert_mode()));
+        append_to_note(text_to_insert(note(), file.readAll(), "",
+                                      settings::instance()->insert_mode()));
     }
 
     return true;
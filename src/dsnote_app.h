@@ -340,6 +340,8 @@ class dsnote_app : public QObject {
     Q_INVOKABLE void copy_text_to_clipboard(const QString &text);
     Q_INVOKABLE QVariantMap file_info(const QString &file) const;
     Q_INVOKABLE void undo_or_redu_note();
+    Q_INVOKABLE void undo_note();
+    Q_INVOKABLE void redo_note();
     Q_INVOKABLE void make_undo();
     Q_INVOKABLE void update_note(const QString &text, bool replace);
     Q_INVOKABLE void close_desktop_notification();
@@ -502,6 +504,8 @@ class dsnote_app : public QObject {
     QString m_active_tts_model_for_out_mnt;
     QVariantMap m_available_tts_models_for_out_mnt_map;
     QString m_intermediate_text;
+    int m_intermediate_text_task = INVALID_TASK;
+    int m_intermediate_text_revision = 0;
     double m_speech_to_file_progress = -1.0;
     double m_translate_progress = -1.0;
     double m_transcribe_progress = -1.0;
@@ -527,8 +531,6 @@ class dsnote_app : public QObject {
     QString m_dest_file_title_tag;
     QString m_dest_file_track_tag;
     QString m_translated_text;
-    QString m_prev_text;
-    bool m_undo_flag = false;  // true => undo, false => redu
     std::queue<QString> m_files_to_open;
     std::optional<action_t> m_pending_action;
     text_destination_t m_text_destination = text_destination_t::note_add;
@@ -608,8 +610,9 @@ class dsnote_app : public QObject {
     void update_listen();
     void set_service_state(service_state_t new_service_state);
     void set_task_state(service_task_state_t new_task_state);
-    void handle_stt_intermediate_text(const QString &text, const QString &lang,
-                                      int task);
+    void handle_stt_intermediate_text(int task, int base_revision, int offset,
+                                      int replaced, const QString &text);
+    void sync_intermediate_text(int task);
     [[nodiscard]] int active_stt_model_idx() const;
     inline QString active_stt_model() { return m_active_stt_model; }
     QString active_stt_model_name() const;
@@ -692,11 +695,12 @@ class dsnote_app : public QObject {
     void connect_service_signals();
     void start_keepalive();
     QVariantMap translations() const;
-    static QString insert_to_note(QString note, QString new_text,
+    static QString text_to_insert(const QString &note, QString new_text,
                                   const QString &lang,
                                   settings::insert_mode_t mode);
     QString note() const;
     void set_note(const QString text);
+    void append_to_note(const QString &text);
     bool can_undo_note() const;
     bool can_redo_note() const;
     bool can_undo_or_redu_note() const;
@@ -8,7 +8,6 @@
 #include "fasterwhisper_engine.hpp"
 
 #include <dlfcn.h>
-#include <pybind11/numpy.h>
 
 #include <algorithm>
 #include <chrono>
@@ -18,6 +17,8 @@
 #include "cpu_tools.hpp"
 #include "gpu_tools.hpp"
 #include "logger.hpp"
+#include "metrics.hpp"
+#include "py_buf_tools.hpp"
 #include "py_executor.hpp"
 #include "text_tools.hpp"
 
@@ -27,6 +28,7 @@ fasterwhisper_engine::fasterwhisper_engine(config_t config,
                                            callbacks_t call_backs)
     : stt_engine{std::move(config), std::move(call_backs)} {
     m_speech_buf.reserve(m_speech_max_size);
+    m_use_decoding_thread = true;
 }
 
 fasterwhisper_engine::~fasterwhisper_engine() {
@@ -55,18 +57,7 @@ void fasterwhisper_engine::stop() {
 }
 
 void fasterwhisper_engine::push_buf_to_whisper_buf(
-    const std::vector<in_buf_t::buf_t::value_type>& buf,
-    whisper_buf_t& whisper_buf) {
-    // convert s16 to f32 sample format
-    std::transform(buf.cbegin(), buf.cend(), std::back_inserter(whisper_buf),
-                   [](auto sample) {
-                       return static_cast<whisper_buf_t::value_type>(sample) /
-                              32768.0F;
-                   });
-}
-
-void fasterwhisper_engine::push_buf_to_whisper_buf(
-    in_buf_t::buf_t::value_type* data, in_buf_t::buf_t::size_type size,
+    const in_buf_t::buf_t::value_type* data, in_buf_t::buf_t::size_type size,
     whisper_buf_t& whisper_buf) {
     // convert s16 to f32 sample format
     whisper_buf.reserve(whisper_buf.size() + size);
@@ -91,9 +82,8 @@ void fasterwhisper_engine::create_model() {
     LOGD("creating fasterwhisper model");
 
     auto task = py_executor::instance()->execute([&]() {
-        auto n_threads = std::min(
-            m_threads,
-            std::max(1, static_cast<int>(std::thread::hardware_concurrency())));
+        auto n_threads =
+            std::min(m_threads, static_cast<int>(cpu_tools::decode_threads()));
         auto use_cuda = m_config.use_gpu &&
                         m_config.gpu_device.api == gpu_api_t::cuda &&
                         gpu_tools::has_cudnn();
@@ -143,17 +133,21 @@ stt_engine::samples_process_result_t fasterwhisper_engine::process_buff() {
 
     if (sof) {
         m_speech_buf.clear();
-        m_start_time.reset();
+        reset_sentence_timer();
         m_vad.reset();
-        reset_segment_counters();
+        m_segment_time_discarded_before = 0;
+        m_segment_time_discarded_after = 0;
+        run_after_decoding([this] {
+            m_segment_offset = 0;
+            m_segment_time_offset = m_config.sub_config.time_offset_ms;
+        });
     }
 
     m_denoiser.process(m_in_buf.buf.data(), m_in_buf.size);
 
-    const auto& vad_buf =
-        m_vad.remove_silence(m_in_buf.buf.data(), m_in_buf.size);
+    const auto& vad_spans = m_vad.process(m_in_buf.buf.data(), m_in_buf.size);
 
-    bool vad_status = !vad_buf.empty();
+    bool vad_status = !vad_spans.empty();
 
     if (vad_status) {
         LOGD("vad: speech detected");
@@ -163,11 +157,14 @@ stt_engine::samples_process_result_t fasterwhisper_engine::process_buff() {
             set_speech_detection_status(
                 speech_detection_status_t::speech_detected);
 
-        if (m_config.text_format == text_format_t::raw)
-            push_buf_to_whisper_buf(vad_buf, m_speech_buf);
-        else
+        if (m_config.text_format == text_format_t::raw) {
+            for (const auto& span : vad_spans)
+                push_buf_to_whisper_buf(m_vad.samples() + span.start,
+                                        span.size(), m_speech_buf);
+        } else {
             push_buf_to_whisper_buf(m_in_buf.buf.data(), m_in_buf.size,
                                     m_speech_buf);
+        }
 
         restart_sentence_timer();
     } else {
@@ -219,7 +216,9 @@ stt_engine::samples_process_result_t fasterwhisper_engine::process_buff() {
         if (eof || (m_config.speech_mode == speech_mode_t::manual &&
                     m_speech_detection_status ==
                         speech_detection_status_t::no_speech)) {
-            flush(eof ? flush_t::eof : flush_t::regular);
+            run_after_decoding([this, eof] {
+                flush(eof ? flush_t::eof : flush_t::regular);
+            });
             free_buf();
             return samples_process_result_t::no_samples_needed;
         }
@@ -233,36 +232,51 @@ stt_engine::samples_process_result_t fasterwhisper_engine::process_buff() {
         return samples_process_result_t::no_samples_needed;
     }
 
-    set_state(state_t::decoding);
-
     if (!vad_status) {
         set_speech_detection_status(speech_detection_status_t::no_speech);
     }
 
     LOGD("speech frame: samples=" << m_speech_buf.size());
 
-    m_segment_time_offset += m_segment_time_discarded_before;
-    m_segment_time_discarded_before = 0;
+    auto flush_type =
+        eof || m_config.speech_mode == speech_mode_t::single_sentence
+            ? flush_t::eof
+            : flush_t::regular;
+
+    // next samples are processed while speech is decoded
+    push_decode_task([this, buf = std::move(m_speech_buf),
+                      discarded_before = m_segment_time_discarded_before,
+                      discarded_after = m_segment_time_discarded_after,
+                      flush_type] {
+        set_state(state_t::decoding);
+
+        m_segment_time_offset += discarded_before;
+
+        {
+            metrics::scoped_timer timer{
+                metrics::stage_t::decode,
+                metrics::samples_to_ms(buf.size(), m_sample_rate)};
+            decode_speech(buf);
+        }
 
-    decode_speech(m_speech_buf);
+        m_segment_time_offset +=
+            (discarded_after + (1000 * buf.size() / m_sample_rate));
 
-    m_segment_time_offset += (m_segment_time_discarded_after +
-                              (1000 * m_speech_buf.size() / m_sample_rate));
-    m_segment_time_discarded_after = 0;
+        set_state(state_t::idle);
 
-    set_state(state_t::idle);
+        if (m_config.speech_mode == speech_mode_t::single_sentence &&
+            (!m_intermediate_text || m_intermediate_text->empty())) {
+            LOGD("no speech decoded, forcing sentence timeout");
+            m_call_backs.sentence_timeout();
+        }
 
-    if (m_config.speech_mode == speech_mode_t::single_sentence &&
-        (!m_intermediate_text || m_intermediate_text->empty())) {
-        LOGD("no speech decoded, forcing sentence timeout");
-        m_call_backs.sentence_timeout();
-    }
+        flush(flush_type);
+    });
 
+    m_segment_time_discarded_before = 0;
+    m_segment_time_discarded_after = 0;
     m_speech_buf.clear();
-
-    flush(eof || m_config.speech_mode == speech_mode_t::single_sentence
-              ? flush_t::eof
-              : flush_t::regular);
+    m_speech_buf.reserve(m_speech_max_size);
 
     free_buf();
 
@@ -278,9 +292,9 @@ void fasterwhisper_engine::decode_speech(const whisper_buf_t& buf) {
 
     auto task = py_executor::instance()->execute([&]() {
         try {
-            py::array_t<float> array(buf.size());
-            auto r = array.mutable_unchecked<1>();
-            for (py::ssize_t i = 0; i < r.shape(0); ++i) r(i) = buf[i];
+            // array shares memory with buf, segments are iterated before
+            // buf is released
+            auto array = py_buf_tools::make_array_view(buf);
 
             auto seg_tuple = m_model->attr("transcribe")(
                 "audio"_a = array, "beam_size"_a = 5,
@@ -356,13 +370,9 @@ void fasterwhisper_engine::decode_speech(const whisper_buf_t& buf) {
                 ((1000 * buf.size()) / static_cast<double>(m_sample_rate))
          << ")");
 
-    auto result = merge_texts(m_intermediate_text.value_or(std::string{}),
-                              std::move(text));
-
 #ifdef DEBUG
-    LOGD("speech decoded: text=" << result);
+    LOGD("speech decoded: text=" << text);
 #endif
 
-    if (!m_intermediate_text || m_intermediate_text != result)
-        set_intermediate_text(result);
+    append_intermediate_text(text);
 }
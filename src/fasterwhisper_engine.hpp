@@ -41,11 +41,8 @@ class fasterwhisper_engine : public stt_engine {
     samples_process_result_t process_buff() override;
     void decode_speech(const whisper_buf_t& buf);
     static void push_buf_to_whisper_buf(
-        const std::vector<in_buf_t::buf_t::value_type>& buf,
-        whisper_buf_t& whisper_buf);
-    static void push_buf_to_whisper_buf(in_buf_t::buf_t::value_type* data,
-                                        in_buf_t::buf_t::size_type size,
-                                        whisper_buf_t& whisper_buf);
+        const in_buf_t::buf_t::value_type* data,
+        in_buf_t::buf_t::size_type size, whisper_buf_t& whisper_buf);
 
     void reset_impl() override;
     void stop_processing_impl() override;
@@ -9,8 +9,13 @@
 
 #include <QDebug>
 
-file_source::file_source(const QString &file, int stream_index, QObject *parent)
-    : audio_source{parent}, m_file{file}, m_stream_index{stream_index} {
+file_source::file_source(const QString &file, int stream_index,
+                         media_compressor::clip_info_t clip_info,
+                         QObject *parent)
+    : audio_source{parent},
+      m_file{file},
+      m_stream_index{stream_index},
+      m_clip_info{clip_info} {
     start();
 }
 
@@ -58,7 +63,7 @@ void file_source::start() {
         {media_compressor::quality_t::vbr_medium, /*mono=*/true,
          /*sample_rate_16=*/true, /*stream=*/std::move(stream)},
         /*data_ready_callback=*/{},
-        /*task_finished_callback=*/{});
+        /*task_finished_callback=*/{}, m_clip_info);
 }
 
 void file_source::handle_read_timeout() {
@@ -20,6 +20,7 @@ class file_source : public audio_source {
     Q_OBJECT
    public:
     explicit file_source(const QString &file, int stream_index,
+                         media_compressor::clip_info_t clip_info = {},
                          QObject *parent = nullptr);
     bool ok() const override;
     audio_data read_audio(char *buf, size_t max_size) override;
@@ -45,6 +46,7 @@ class file_source : public audio_source {
     media_compressor m_mc;
     double m_progress = 0.0;
     int m_stream_index = -1;
+    media_compressor::clip_info_t m_clip_info;
 
     void start();
     void handle_read_timeout();
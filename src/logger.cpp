@@ -11,11 +11,166 @@
 #include <fmt/core.h>
 #include <threads.h>
 
+#include <atomic>
 #include <chrono>
+#include <condition_variable>
+#include <cstdint>
 #include <cstdio>
+#include <cstdlib>
+#include <mutex>
+#include <thread>
+
+// Bounded multi-producer single-consumer queue of formatted log lines.
+// Producers never block. When queue is full, line is dropped.
+class LogQueue {
+   public:
+    explicit LogQueue(size_t size_power_of_two)
+        : m_mask{size_power_of_two - 1},
+          m_slots{std::make_unique<slot_t[]>(size_power_of_two)} {
+        for (size_t i = 0; i < size_power_of_two; ++i)
+            m_slots[i].seq.store(i, std::memory_order_relaxed);
+    }
+
+    bool push(std::string &&line) {
+        auto pos = m_push_pos.load(std::memory_order_relaxed);
+
+        while (true) {
+            auto &slot = m_slots[pos & m_mask];
+            auto seq = slot.seq.load(std::memory_order_acquire);
+            auto diff =
+                static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos);
+
+            if (diff == 0) {
+                if (m_push_pos.compare_exchange_weak(
+                        pos, pos + 1, std::memory_order_relaxed)) {
+                    slot.line = std::move(line);
+                    slot.seq.store(pos + 1, std::memory_order_release);
+                    return true;
+                }
+            } else if (diff < 0) {
+                return false;  // full
+            } else {
+                pos = m_push_pos.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    // only one consumer is allowed
+    bool pop(std::string &line) {
+        auto &slot = m_slots[m_pop_pos & m_mask];
+
+        if (slot.seq.load(std::memory_order_acquire) != m_pop_pos + 1)
+            return false;  // empty
+
+        line = std::move(slot.line);
+        slot.line.clear();
+        slot.seq.store(m_pop_pos + m_mask + 1, std::memory_order_release);
+        ++m_pop_pos;
+
+        return true;
+    }
+
+   private:
+    struct slot_t {
+        std::atomic<size_t> seq{0};
+        std::string line;
+    };
+
+    const size_t m_mask;
+    std::unique_ptr<slot_t[]> m_slots;
+    std::atomic<size_t> m_push_pos{0};
+    size_t m_pop_pos = 0;
+};
+
+struct Logger::AsyncSink {
+    static const size_t queue_size = 4096;
+    static const int max_push_retries = 1000;
+    static constexpr auto flush_interval = std::chrono::milliseconds{100};
+
+    LogQueue queue{queue_size};
+    std::atomic<size_t> dropped{0};
+    std::atomic_bool stop_requested = false;
+    std::mutex mtx;
+    std::condition_variable cv;
+    // only one thread at a time can consume queue
+    std::mutex write_mtx;
+    std::thread thread{&AsyncSink::loop, this};
+
+    ~AsyncSink() { stop(); }
+
+    // returns false when sink is stopped and line should be written directly
+    bool push(std::string &&line) {
+        if (stop_requested) return false;
+
+        // when queue is full, give writer a chance to catch up before
+        // dropping line
+        for (int i = 0; !queue.push(std::move(line)); ++i) {
+            if (i == max_push_retries) {
+                ++dropped;
+                return true;
+            }
+            cv.notify_one();
+            std::this_thread::yield();
+        }
+
+        return true;
+    }
+
+    // writes pending lines and then given line on calling thread
+    void write_now(const std::string &line) {
+        std::lock_guard lock{write_mtx};
+        drain_locked();
+        Logger::write(line, true);
+    }
+
+    void stop() {
+        stop_requested = true;
+        cv.notify_one();
+        if (thread.joinable()) thread.join();
+    }
+
+    void drain() {
+        std::lock_guard lock{write_mtx};
+        drain_locked();
+    }
+
+    void drain_locked() {
+        std::string line;
+        bool written = false;
+
+        while (queue.pop(line)) {
+            Logger::write(line, false);
+            written = true;
+        }
+
+        if (auto n = dropped.exchange(0); n > 0) {
+            Logger::write(fmt::format("[W] logger queue full, {} message(s) "
+                                      "dropped\n",
+                                      n),
+                          false);
+            written = true;
+        }
+
+        if (written) Logger::write({}, true);
+    }
+
+    void loop() {
+        while (!stop_requested) {
+            {
+                std::unique_lock lock{mtx};
+                cv.wait_for(lock, flush_interval);
+            }
+
+            drain();
+        }
+
+        drain();
+    }
+};
 
 Logger::LogType Logger::m_level = Logger::LogType::Error;
 std::optional<std::ofstream> Logger::m_file = std::nullopt;
+std::atomic<Logger::AsyncSink *> Logger::m_sink = nullptr;
 
 std::ostream &operator<<(std::ostream &os, Logger::LogType type) {
     switch (type) {
@@ -41,7 +196,9 @@ std::ostream &operator<<(std::ostream &os, Logger::LogType type) {
     return os;
 }
 
-void Logger::init(LogType level, const std::string &file) {
+void Logger::init(LogType level, const std::string &file, bool async) {
+    if (auto *sink = m_sink.exchange(nullptr)) sink->stop();
+
     m_level = level;
 
     if (file.empty()) {
@@ -56,6 +213,34 @@ void Logger::init(LogType level, const std::string &file) {
             LOGI("logging to file enabled");
         }
     }
+
+    if (async) {
+        m_sink.store(new AsyncSink{});
+
+        static bool handlers_registered = false;
+        if (!handlers_registered) {
+            handlers_registered = true;
+            std::atexit(shutdown);
+            std::at_quick_exit(shutdown);
+        }
+
+        LOGI("async logging enabled");
+    }
+}
+
+void Logger::shutdown() {
+    // sink object is not destroyed because other threads may still log
+    if (auto *sink = m_sink.load()) sink->stop();
+}
+
+void Logger::write(const std::string &line, bool flush) {
+    if (m_file) {
+        if (!line.empty()) *m_file << line;
+        if (flush) m_file->flush();
+    } else {
+        if (!line.empty()) fmt::print(stderr, "{}", line);
+        if (flush) fflush(stderr);
+    }
 }
 
 void Logger::setLevel(LogType level) {
@@ -68,10 +253,6 @@ void Logger::setLevel(LogType level) {
 
 Logger::LogType Logger::level() { return m_level; }
 
-bool Logger::match(LogType type) {
-    return static_cast<int>(type) >= static_cast<int>(m_level);
-}
-
 Logger::Message::Message(LogType type, const char *file, const char *function,
                          int line)
     : m_type{type}, m_file{file}, m_fun{function}, m_line{line} {}
@@ -114,12 +295,14 @@ Logger::Message::~Message() {
     try {
         auto line = fmt::format(fmt, typeToChar(m_type), now, msecs,
                                 thrd_current(), m_fun, str, m_line);
-        if (Logger::m_file) {
-            *Logger::m_file << line;
-            Logger::m_file->flush();
-        } else {
-            fmt::print(stderr, line);
-            fflush(stderr);
+        auto *sink = Logger::m_sink.load();
+        if (!sink) {
+            Logger::write(line, true);
+        } else if (m_type >= Logger::LogType::Error) {
+            // errors must not be lost when process aborts or crashes
+            sink->write_now(line);
+        } else if (!sink->push(std::move(line))) {
+            Logger::write(line, true);
         }
     } catch (const std::runtime_error &e) {
         fmt::print(stderr, "logger error: {}\n", e.what());
@@ -8,25 +8,34 @@
 #ifndef LOGGER_H
 #define LOGGER_H
 
+#include <atomic>
 #include <fstream>
+#include <memory>
 #include <optional>
 #include <sstream>
 
+// Messages with level lower than LOG_MIN_LEVEL are removed at compile time.
+#ifndef LOG_MIN_LEVEL
+#define LOG_MIN_LEVEL 0
+#endif
+
+// Level is checked before message is formatted, so filtered out messages
+// cost only one comparison.
+#define LOG_MESSAGE(type, msg)                                             \
+    do {                                                                   \
+        if (static_cast<int>(type) >= LOG_MIN_LEVEL && Logger::match(type)) \
+            Logger::Message(type, __FILE__, __func__, __LINE__) << msg;    \
+    } while (false)
+
 #ifdef USE_TRACE_LOGS
-#define LOGT(msg) \
-    Logger::Message(logger::LogType::Trace, __FILE__, __func__, __LINE__) << msg
+#define LOGT(msg) LOG_MESSAGE(Logger::LogType::Trace, msg)
 #else
 #define LOGT(msg)
 #endif
-#define LOGD(msg) \
-    Logger::Message(Logger::LogType::Debug, __FILE__, __func__, __LINE__) << msg
-#define LOGI(msg) \
-    Logger::Message(Logger::LogType::Info, __FILE__, __func__, __LINE__) << msg
-#define LOGW(msg)                                                           \
-    Logger::Message(Logger::LogType::Warning, __FILE__, __func__, __LINE__) \
-        << msg
-#define LOGE(msg) \
-    Logger::Message(Logger::LogType::Error, __FILE__, __func__, __LINE__) << msg
+#define LOGD(msg) LOG_MESSAGE(Logger::LogType::Debug, msg)
+#define LOGI(msg) LOG_MESSAGE(Logger::LogType::Info, msg)
+#define LOGW(msg) LOG_MESSAGE(Logger::LogType::Warning, msg)
+#define LOGE(msg) LOG_MESSAGE(Logger::LogType::Error, msg)
 
 class Logger {
    public:
@@ -58,16 +67,30 @@ class Logger {
         }
     };
 
-    static void init(LogType level, const std::string &file = {});
+    // When 'async' is true, messages are passed to background writer
+    // through lock-free queue and output is flushed in batches. Errors are
+    // written and flushed synchronously after all pending messages.
+    static void init(LogType level, const std::string &file = {},
+                     bool async = true);
     static void setLevel(LogType level);
     static LogType level();
-    static bool match(LogType type);
+    inline static bool match(LogType type) {
+        return static_cast<int>(type) >= static_cast<int>(m_level);
+    }
+    // Writes all pending messages and stops background writer.
+    static void shutdown();
     Logger() = delete;
 
    private:
+    struct AsyncSink;
+
     inline static const char *m_emptyStr = "()";
     static LogType m_level;
     static std::optional<std::ofstream> m_file;
+    // never deleted because other threads may log until process ends
+    static std::atomic<AsyncSink *> m_sink;
+
+    static void write(const std::string &line, bool flush);
 };
 
 #endif  // LOGGER_H
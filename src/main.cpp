@@ -17,8 +17,10 @@
 #include <QString>
 #include <QStringList>
 #include <QTextCodec>
+#include <QTimer>
 #include <QTranslator>
 #include <QUrl>
+#include <chrono>
 #include <csignal>
 #include <cstdlib>
 #include <memory>
@@ -45,23 +47,28 @@
 
 #include "app_server.hpp"
 #include "avlogger.hpp"
+#include "batch_runner.h"
 #include "config.h"
 #include "cpu_tools.hpp"
 #include "dsnote_app.h"
 #include "logger.hpp"
+#include "metrics.hpp"
 #include "models_list_model.h"
 #include "qtlogger.hpp"
 #include "settings.h"
 #include "speech_config.h"
 #include "speech_service.h"
 
-static void exit_program() {
-    qDebug() << "exiting";
+static void exit_program(int exit_code = 0) {
+    qDebug() << "exiting:" << exit_code;
 
     speech_service::remove_cached_media_files();
 
+    // final metrics dump
+    metrics::instance()->disable_dump();
+
     // workaround for python thread locking
-    std::quick_exit(0);
+    std::quick_exit(exit_code);
 }
 
 static void signal_handler(int sig) {
@@ -81,8 +88,11 @@ struct cmd_options {
     bool reset_models = false;
     bool start_in_tray = false;
     QString action;
+    QString batch_file;
     QStringList files;
     QString log_file;
+    QString metrics_file;
+    int metrics_interval = 60;
 };
 
 static cmd_options check_options(const QCoreApplication& app) {
@@ -123,6 +133,23 @@ static cmd_options check_options(const QCoreApplication& app) {
         QStringLiteral("action")};
     parser.addOption(action_opt);
 
+    QCommandLineOption batch_opt{
+        QStringLiteral("batch"),
+        QStringLiteral(
+            "Runs STT, TTS and translation jobs from <jobs-file> without GUI "
+            "and exits. Use '-' to read jobs from stdin. Every line of the "
+            "file is a JSON object describing one job, for instance: "
+            "{\"stt\": \"memo.mp3\", \"lang\": \"en\", \"out\": \"memo.txt\"}, "
+            "{\"tts\": \"Hello.\", \"lang\": \"en\", \"out\": \"hello.mp3\"}, "
+            "{\"mnt\": \"Hello.\", \"lang\": \"en\", \"out_lang\": \"de\"}. "
+            "Results without \"out\" are written to stdout. Jobs are run "
+            "one after another, so multiple cores are used only by engines "
+            "which decode with many threads. Exit code is 0 when all jobs "
+            "succeeded, 1 when any job failed, 2 when jobs file is invalid "
+            "and 3 when models are not installed."),
+        QStringLiteral("jobs-file")};
+    parser.addOption(batch_opt);
+
     QCommandLineOption gen_checksum_opt{
         QStringLiteral("gen-checksums"),
         QStringLiteral(
@@ -163,6 +190,20 @@ static cmd_options check_options(const QCoreApplication& app) {
         QStringLiteral("log-file")};
     parser.addOption(log_file_opt);
 
+    QCommandLineOption metrics_file_opt{
+        QStringLiteral("metrics-file"),
+        QStringLiteral("Periodically writes performance metrics in JSON "
+                       "format to <metrics-file>."),
+        QStringLiteral("metrics-file")};
+    parser.addOption(metrics_file_opt);
+
+    QCommandLineOption metrics_interval_opt{
+        QStringLiteral("metrics-interval"),
+        QStringLiteral("Interval in seconds between metrics dumps (default "
+                       "60). Used only with --metrics-file."),
+        QStringLiteral("seconds")};
+    parser.addOption(metrics_interval_opt);
+
     parser.addHelpOption();
     parser.addVersionOption();
 
@@ -224,7 +265,26 @@ static cmd_options check_options(const QCoreApplication& app) {
         }
     }
 
+    options.batch_file = parser.value(batch_opt);
+    if (!options.batch_file.isEmpty() &&
+        (parser.isSet(app_opt) || parser.isSet(sttservice_opt))) {
+        fmt::print(stderr,
+                   "Option --batch cannot be used with --app or --service.\n");
+        options.valid = false;
+    }
+
     options.log_file = parser.value(log_file_opt);
+    options.metrics_file = parser.value(metrics_file_opt);
+    if (parser.isSet(metrics_interval_opt)) {
+        bool ok = false;
+        auto interval = parser.value(metrics_interval_opt).toInt(&ok);
+        if (ok && interval > 0) {
+            options.metrics_interval = interval;
+        } else {
+            fmt::print(stderr, "Invalid metrics interval.\n");
+            options.valid = false;
+        }
+    }
     options.verbose = parser.isSet(verbose_opt);
     options.gen_cheksums = parser.isSet(gen_checksum_opt);
     options.gpu_scan_off = parser.isSet(gpuscanoff_opt);
@@ -300,6 +360,26 @@ static void start_service(const cmd_options& options) {
     QGuiApplication::exec();
 }
 
+static void start_batch(const cmd_options& options) {
+    if (options.gpu_scan_off) settings::instance()->disable_gpu_scan();
+    if (options.py_scan_off) settings::instance()->disable_py_scan();
+
+    // engines are used directly without GUI and D-Bus
+    settings::instance()->set_launch_mode(
+        settings::launch_mode_t::app_stanalone);
+
+    speech_service::instance();
+
+    batch_runner runner{options.batch_file};
+
+    QObject::connect(&runner, &batch_runner::finished,
+                     QCoreApplication::instance(), &QCoreApplication::exit,
+                     Qt::QueuedConnection);
+    QTimer::singleShot(0, &runner, &batch_runner::start);
+
+    exit_program(QGuiApplication::exec());
+}
+
 static void start_app(const cmd_options& options, app_server& dbus_app_server) {
     if (options.gpu_scan_off) settings::instance()->disable_gpu_scan();
     if (options.py_scan_off) settings::instance()->disable_py_scan();
@@ -378,7 +458,21 @@ static void start_app(const cmd_options& options, app_server& dbus_app_server) {
     exit_program();
 }
 
+static bool batch_requested(int argc, char* argv[]) {
+    for (int i = 1; i < argc; ++i) {
+        if (qstrcmp(argv[i], "--batch") == 0 ||
+            qstrncmp(argv[i], "--batch=", 8) == 0)
+            return true;
+    }
+    return false;
+}
+
 int main(int argc, char* argv[]) {
+    // batch mode works on servers without display
+    if (batch_requested(argc, argv) &&
+        qEnvironmentVariableIsEmpty("QT_QPA_PLATFORM"))
+        qputenv("QT_QPA_PLATFORM", "offscreen");
+
 #ifdef USE_SFOS
     const auto& app = *SailfishApp::application(argc, argv);
 #else
@@ -404,7 +498,13 @@ int main(int argc, char* argv[]) {
 
     qDebug() << "version:" << APP_VERSION;
 
+    if (!cmd_opts.metrics_file.isEmpty())
+        metrics::instance()->enable_dump(
+            cmd_opts.metrics_file.toStdString(),
+            std::chrono::seconds{cmd_opts.metrics_interval});
+
     cpu_tools::cpuinfo();
+    cpu_tools::topology();
 
     install_translator();
 
@@ -412,6 +512,11 @@ int main(int argc, char* argv[]) {
 
     if (cmd_opts.reset_models) models_manager::reset_models();
 
+    if (!cmd_opts.batch_file.isEmpty()) {
+        qDebug() << "starting batch";
+        start_batch(cmd_opts);
+    }
+
     switch (cmd_opts.launch_mode) {
         case settings::launch_mode_t::service:
             qDebug() << "starting service";
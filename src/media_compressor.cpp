@@ -7,12 +7,15 @@
 
 #include "media_compressor.hpp"
 
+#include <fcntl.h>
 #include <sys/stat.h>
 #include <sys/types.h>
 #include <unistd.h>
 
 #include <algorithm>
 #include <array>
+#include <cerrno>
+#include <cstring>
 #include <iostream>
 #include <stdexcept>
 
@@ -307,6 +310,17 @@ void media_compressor::cancel() {
 
 void media_compressor::clean_av_in_format() {
     if (m_in_av_format_ctx) avformat_close_input(&m_in_av_format_ctx);
+
+    // custom io is not freed by avformat_close_input
+    if (m_in_avio_ctx) {
+        if (m_in_avio_ctx->buffer) av_freep(&m_in_avio_ctx->buffer);
+        avio_context_free(&m_in_avio_ctx);
+    }
+
+    if (m_in_fd >= 0) {
+        close(m_in_fd);
+        m_in_fd = -1;
+    }
 }
 
 void media_compressor::clean_av() {
@@ -440,6 +454,8 @@ void media_compressor::init_av_in_format(const std::string& input_file,
 
     LOGD("opening file: " << input_file);
 
+    open_in_file(input_file);
+
     if (auto ret = avformat_open_input(&m_in_av_format_ctx, input_file.c_str(),
                                        nullptr, nullptr);
         ret < 0) {
@@ -502,6 +518,12 @@ void media_compressor::init_av_in_format(const std::string& input_file,
         }
     }
 
+    // demuxer doesn't need to read packets of other streams
+    for (auto i = 0u; i < m_in_av_format_ctx->nb_streams; ++i) {
+        if (static_cast<int>(i) != m_in_stream_idx)
+            m_in_av_format_ctx->streams[i]->discard = AVDISCARD_ALL;
+    }
+
     // const auto* in_stream = m_in_av_format_ctx->streams[m_in_stream_idx];
 
     // LOGD("in stream: codec="
@@ -513,6 +535,133 @@ void media_compressor::init_av_in_format(const std::string& input_file,
     //      << static_cast<AVSampleFormat>(in_stream->codecpar->format));
 }
 
+void media_compressor::open_in_file(const std::string& input_file) {
+    m_in_fd = open(input_file.c_str(), O_RDONLY | O_CLOEXEC);
+    if (m_in_fd < 0) {
+        LOGE("failed to open input file: " << strerror(errno));
+        throw std::runtime_error("failed to open input file");
+    }
+
+    // input is read mostly sequentially, so kernel can read ahead more
+    posix_fadvise(m_in_fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+
+    auto* in_buf = static_cast<uint8_t*>(av_malloc(IN_BUF_SIZE));
+    if (!in_buf) {
+        clean_av_in_format();
+        throw std::runtime_error("unable to allocate in av buf");
+    }
+
+    m_in_avio_ctx =
+        avio_alloc_context(in_buf, IN_BUF_SIZE, 0, this, read_packet_callback,
+                           nullptr, seek_callback);
+    if (!m_in_avio_ctx) {
+        av_freep(&in_buf);
+        clean_av_in_format();
+        throw std::runtime_error("avio_alloc_context error");
+    }
+
+    m_in_av_format_ctx = avformat_alloc_context();
+    if (!m_in_av_format_ctx) {
+        clean_av_in_format();
+        throw std::runtime_error("avformat_alloc_context error");
+    }
+
+    m_in_av_format_ctx->pb = m_in_avio_ctx;
+    m_in_av_format_ctx->flags |= AVFMT_FLAG_CUSTOM_IO;
+}
+
+int media_compressor::read_packet_callback(void* opaque, uint8_t* buf,
+                                           int buf_size) {
+    auto fd = static_cast<media_compressor*>(opaque)->m_in_fd;
+
+    while (true) {
+        auto ret = read(fd, buf, buf_size);
+        if (ret > 0) return static_cast<int>(ret);
+        if (ret == 0) return AVERROR_EOF;
+        if (errno != EINTR) return AVERROR(errno);
+    }
+}
+
+int64_t media_compressor::seek_callback(void* opaque, int64_t offset,
+                                        int whence) {
+    auto fd = static_cast<media_compressor*>(opaque)->m_in_fd;
+
+    if (whence == AVSEEK_SIZE) {
+        struct stat st {};
+        if (fstat(fd, &st) < 0) return AVERROR(errno);
+        return st.st_size;
+    }
+
+    auto ret = lseek(fd, offset, whence & ~AVSEEK_FORCE);
+    if (ret < 0) return AVERROR(errno);
+    return ret;
+}
+
+void media_compressor::init_clip_by_time() {
+    const auto* in_stream = m_in_av_format_ctx->streams[m_in_stream_idx];
+
+    auto stream_start_ts =
+        in_stream->start_time == AV_NOPTS_VALUE ? 0 : in_stream->start_time;
+
+    m_clip_start_ts = stream_start_ts + av_rescale_q(m_clip_info.start_time_ms,
+                                                     AVRational{1, 1000},
+                                                     in_stream->time_base);
+    m_clip_stop_ts =
+        m_clip_info.stop_time_ms == clip_info_t::max
+            ? INT64_MAX
+            : stream_start_ts + av_rescale_q(m_clip_info.stop_time_ms,
+                                             AVRational{1, 1000},
+                                             in_stream->time_base);
+
+    LOGD("clip by time: start=" << m_clip_info.start_time_ms
+                                << "ms, stop=" << m_clip_info.stop_time_ms
+                                << "ms");
+
+    if (m_clip_info.start_time_ms > 0) {
+        // nearest key frame before start, decoder output is trimmed later
+        if (auto ret = avformat_seek_file(m_in_av_format_ctx, m_in_stream_idx,
+                                          INT64_MIN, m_clip_start_ts,
+                                          m_clip_start_ts, 0);
+            ret < 0) {
+            LOGW("seek error, decoding from the beginning: "
+                 << str_from_av_error(ret));
+        }
+    }
+
+    // progress is measured in time when end of range is known
+    uint64_t stop_ms = m_clip_info.stop_time_ms;
+    if (stop_ms == clip_info_t::max && in_stream->duration != AV_NOPTS_VALUE)
+        stop_ms = av_rescale_q(in_stream->duration, in_stream->time_base,
+                               AVRational{1, 1000});
+
+    if (stop_ms != clip_info_t::max && stop_ms > m_clip_info.start_time_ms) {
+        m_clip_time_progress = true;
+        m_clip_time_read_ms = 0;
+        m_data_info.total = stop_ms - m_clip_info.start_time_ms;
+    }
+}
+
+bool media_compressor::clip_time_reached(const AVPacket* pkt) {
+    if (!m_clip_by_time) return false;
+
+    auto pts = pkt->pts != AV_NOPTS_VALUE ? pkt->pts : pkt->dts;
+    if (pts == AV_NOPTS_VALUE) return false;
+
+    if (pts >= m_clip_stop_ts) {
+        m_clip_time_eof = true;
+        return true;
+    }
+
+    if (pts > m_clip_start_ts) {
+        m_clip_time_read_ms = av_rescale_q(
+            pts - m_clip_start_ts,
+            m_in_av_format_ctx->streams[m_in_stream_idx]->time_base,
+            AVRational{1, 1000});
+    }
+
+    return false;
+}
+
 static uint64_t time_ms_to_pcm_bytes(uint64_t time_ms, int sample_rate,
                                      int channels) {
     return (time_ms * 2 * sample_rate * channels) / 1000.0;
@@ -578,6 +727,15 @@ void media_compressor::init_av(task_t task) {
             in_stream->codecpar->ch_layout.nb_channels);
     }
 
+    // compressed input is clipped by seeking to start and trimming decoded
+    // audio, pcm input is clipped by bytes
+    m_clip_by_time = !m_no_decode && m_input_files.empty() &&
+                     in_stream->codecpar->codec_type == AVMEDIA_TYPE_AUDIO &&
+                     in_stream->codecpar->codec_id != AV_CODEC_ID_PCM_S16LE &&
+                     m_clip_info.time_range();
+    m_clip_time_eof = false;
+    m_clip_time_progress = false;
+
     if (m_no_decode) {
         LOGD("no decode");
     } else {
@@ -608,6 +766,10 @@ void media_compressor::init_av(task_t task) {
 
         m_in_av_ctx->time_base = in_stream->time_base;
 
+        // decoders that support threading use all available cores
+        m_in_av_ctx->thread_count = 0;
+        m_in_av_ctx->thread_type = FF_THREAD_FRAME | FF_THREAD_SLICE;
+
         if (auto ret = avcodec_open2(m_in_av_ctx, nullptr, nullptr); ret != 0) {
             clean_av();
             LOGE("avcodec_open2 error: " << str_from_av_error(ret));
@@ -818,7 +980,19 @@ void media_compressor::init_av(task_t task) {
                 throw std::runtime_error("av_audio_fifo_alloc error");
             }
 
-            init_av_filter("anull");
+            if (m_clip_by_time) {
+                init_clip_by_time();
+
+                // trimmed audio starts at zero pts
+                auto filter =
+                    "atrim=start_pts=" + std::to_string(m_clip_start_ts);
+                if (m_clip_stop_ts < INT64_MAX)
+                    filter += ":end_pts=" + std::to_string(m_clip_stop_ts);
+                filter += ",asetpts=PTS-STARTPTS";
+                init_av_filter(filter.c_str());
+            } else {
+                init_av_filter("anull");
+            }
         }
     }
 
@@ -934,7 +1108,8 @@ void media_compressor::write_to_buf(const char* data, int size) {
     std::unique_lock lock{m_mtx};
     m_cv.wait(lock, [&]() {
         if (m_shutdown) return true;
-        if (m_buf.size() + size <= BUF_MAX_SIZE) return true;
+        if (m_buf_unbounded || m_buf.size() + size <= BUF_MAX_SIZE)
+            return true;
 
         if (m_data_ready_callback) m_data_ready_callback();
 
@@ -971,8 +1146,65 @@ void media_compressor::setup_input_files(
     });
 }
 
+static std::optional<std::pair<int64_t, int64_t>> file_size_and_mtime(
+    const std::string& file) {
+    struct stat st {};
+    if (stat(file.c_str(), &st) != 0) return std::nullopt;
+
+    return std::make_pair(
+        static_cast<int64_t>(st.st_size),
+        static_cast<int64_t>(st.st_mtim.tv_sec) * 1000000000 +
+            st.st_mtim.tv_nsec);
+}
+
+std::optional<media_compressor::probe_t> media_compressor::cached_probe(
+    const std::string& file) {
+    auto stamp = file_size_and_mtime(file);
+    if (!stamp) return std::nullopt;
+
+    std::lock_guard lock{m_probe_cache_mtx};
+
+    auto it = m_probe_cache.find(file);
+    if (it == m_probe_cache.end()) return std::nullopt;
+
+    if (it->second.size != stamp->first ||
+        it->second.mtime_ns != stamp->second) {
+        m_probe_cache.erase(it);
+        return std::nullopt;
+    }
+
+    return it->second;
+}
+
+void media_compressor::update_probe_cache(
+    const std::string& file, const std::function<void(probe_t&)>& update) {
+    auto stamp = file_size_and_mtime(file);
+    if (!stamp) return;
+
+    std::lock_guard lock{m_probe_cache_mtx};
+
+    auto it = m_probe_cache.find(file);
+    if (it == m_probe_cache.end() || it->second.size != stamp->first ||
+        it->second.mtime_ns != stamp->second) {
+        if (it != m_probe_cache.end()) {
+            m_probe_cache.erase(it);
+        } else if (m_probe_cache.size() >= m_probe_cache_max_size) {
+            m_probe_cache.erase(m_probe_cache.begin());
+        }
+
+        it = m_probe_cache
+                 .emplace(file, probe_t{stamp->first, stamp->second, {}, {}})
+                 .first;
+    }
+
+    update(it->second);
+}
+
 std::optional<media_compressor::media_info_t> media_compressor::media_info(
     const std::string& input_file) {
+    if (auto probe = cached_probe(input_file); probe && probe->media_info)
+        return probe->media_info;
+
     media_info_t media_info_data{};
 
     try {
@@ -1033,18 +1265,38 @@ std::optional<media_compressor::media_info_t> media_compressor::media_info(
         return std::nullopt;
     }
 
+    update_probe_cache(input_file, [&](probe_t& probe) {
+        probe.media_info = media_info_data;
+    });
+
     return media_info_data;
 }
 
 size_t media_compressor::duration(const std::string& input_file) {
+    // only duration of default stream is cached
+    bool use_cache = !m_options.stream;
+
+    if (use_cache) {
+        if (auto probe = cached_probe(input_file); probe && probe->duration)
+            return *probe->duration;
+    }
+
     try {
         init_av_in_format(input_file, false);
 
         const auto* in_stream = m_in_av_format_ctx->streams[m_in_stream_idx];
 
-        return std::max<size_t>(
+        size_t duration = std::max<size_t>(
             0, av_rescale_q(in_stream->duration, in_stream->time_base,
                             AVRational{1, 1000}));
+
+        if (use_cache) {
+            update_probe_cache(input_file, [duration](probe_t& probe) {
+                probe.duration = duration;
+            });
+        }
+
+        return duration;
     } catch (const std::runtime_error& err) {
         LOGE("can't get duration: " << err.what());
     }
@@ -1082,11 +1334,12 @@ void media_compressor::decompress_async_internal(
     task_t task, std::vector<std::string>&& input_files,
     std::string output_file, options_t options,
     data_ready_callback_t&& data_ready_callback,
-    task_finished_callback_t&& task_finished_callback) {
+    task_finished_callback_t&& task_finished_callback, clip_info_t clip_info) {
     setup_input_files(std::move(input_files));
 
     m_output_file = std::move(output_file);
     m_options = std::move(options);
+    m_clip_info = clip_info;
 
     init_av(task);
 
@@ -1115,13 +1368,45 @@ void media_compressor::decompress_async_internal(
 void media_compressor::decompress_to_data_raw_async(
     std::vector<std::string> input_files, options_t options,
     data_ready_callback_t data_ready_callback,
-    task_finished_callback_t task_finished_callback) {
+    task_finished_callback_t task_finished_callback, clip_info_t clip_info) {
     LOGD("task decompress to data raw async");
 
     decompress_async_internal(task_t::decompress_to_data_raw_async,
                               std::move(input_files), {}, std::move(options),
                               std::move(data_ready_callback),
-                              std::move(task_finished_callback));
+                              std::move(task_finished_callback), clip_info);
+}
+
+std::pair<media_compressor::pcm_info_t, std::string>
+media_compressor::decompress_to_data_raw(std::vector<std::string> input_files,
+                                         options_t options) {
+    LOGD("task decompress to data raw");
+
+    setup_input_files(std::move(input_files));
+
+    m_options = std::move(options);
+
+    init_av(task_t::decompress_to_data_raw_async);
+
+    if (!m_out_av_ctx || m_out_av_ctx->codec_type != AVMEDIA_TYPE_AUDIO) {
+        clean_av();
+        throw std::runtime_error("input is not audio");
+    }
+
+    pcm_info_t info{m_out_av_ctx->sample_rate,
+                    m_out_av_ctx->ch_layout.nb_channels};
+
+    // nobody reads data while decoding, so whole output is buffered
+    m_buf_unbounded = true;
+
+    process();
+
+    std::pair<pcm_info_t, std::string> result{
+        info, std::string{m_buf.cbegin(), m_buf.cend()}};
+
+    m_buf.clear();
+
+    return result;
 }
 
 void media_compressor::decompress_to_data_format_async(
@@ -1375,7 +1660,8 @@ bool media_compressor::decode_frame(AVPacket* pkt, AVFrame* frame_in,
         while (!m_shutdown &&
                av_audio_fifo_size(m_av_fifo) < m_out_av_ctx->frame_size &&
                !m_data_info.eof) {
-            if (do_clip && m_in_bytes_read >= m_clip_info.stop_bytes) {
+            if ((do_clip && m_in_bytes_read >= m_clip_info.stop_bytes) ||
+                m_clip_time_eof) {
                 LOGD("demuxer clip stop");
                 m_data_info.eof = true;
                 break;
@@ -1398,7 +1684,8 @@ bool media_compressor::decode_frame(AVPacket* pkt, AVFrame* frame_in,
             if (m_data_info.eof) {
                 if (!filter_frame(nullptr, frame_out)) continue;
             } else {
-                if (pkt->stream_index != m_in_stream_idx) {
+                if (pkt->stream_index != m_in_stream_idx ||
+                    clip_time_reached(pkt)) {
                     av_packet_unref(pkt);
                     continue;
                 }
@@ -1462,7 +1749,8 @@ bool media_compressor::decode_frame(AVPacket* pkt, AVFrame* frame_in,
         }
     } else {
         while (!m_shutdown) {
-            if (do_clip && m_in_bytes_read >= m_clip_info.stop_bytes) {
+            if ((do_clip && m_in_bytes_read >= m_clip_info.stop_bytes) ||
+                m_clip_time_eof) {
                 LOGD("demuxer clip stop");
                 m_data_info.eof = true;
                 break;
@@ -1493,7 +1781,8 @@ bool media_compressor::decode_frame(AVPacket* pkt, AVFrame* frame_in,
                 }
             }
 
-            if (pkt->stream_index != m_in_stream_idx) {
+            if (pkt->stream_index != m_in_stream_idx ||
+                clip_time_reached(pkt)) {
                 av_packet_unref(pkt);
                 continue;
             }
@@ -1647,7 +1936,10 @@ media_compressor::data_info_t media_compressor::get_data(char* data,
     lock.unlock();
     m_cv.notify_all();
 
-    if (m_in_av_format_ctx && m_in_av_format_ctx->pb) {
+    if (m_clip_time_progress) {
+        m_data_info.bytes_read =
+            std::min(m_clip_time_read_ms, m_data_info.total);
+    } else if (m_in_av_format_ctx && m_in_av_format_ctx->pb) {
         m_data_info.bytes_read = m_in_av_format_ctx->pb->bytes_read;
     } else {
         m_data_info.bytes_read = m_data_info.total;
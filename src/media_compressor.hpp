@@ -12,10 +12,13 @@
 #include <condition_variable>
 #include <cstdint>
 #include <functional>
+#include <limits>
+#include <mutex>
 #include <optional>
 #include <queue>
 #include <string>
 #include <thread>
+#include <unordered_map>
 #include <utility>
 #include <vector>
 
@@ -78,6 +81,8 @@ class media_compressor {
     using data_ready_callback_t = std::function<void()>;
 
     static const int BUF_MAX_SIZE = 16384;
+    // read-ahead buffer of input file
+    static const int IN_BUF_SIZE = 1048576;
 
     struct data_info_t {
         size_t size = 0;
@@ -86,6 +91,11 @@ class media_compressor {
         bool eof = false;
     };
 
+    struct pcm_info_t {
+        int sample_rate = 0;
+        int channels = 0;
+    };
+
     struct clip_info_t {
         static const uint64_t max = std::numeric_limits<uint64_t>::max();
 
@@ -95,6 +105,9 @@ class media_compressor {
         uint64_t stop_bytes = max;
 
         inline bool valid_time() const { return start_time_ms < stop_time_ms; }
+        inline bool time_range() const {
+            return valid_time() && (start_time_ms > 0 || stop_time_ms < max);
+        }
         inline bool valid_bytes() const { return start_bytes < stop_bytes; }
     };
 
@@ -118,11 +131,15 @@ class media_compressor {
     void decompress_to_data_raw_async(
         std::vector<std::string> input_files, options_t options,
         data_ready_callback_t data_ready_callback,
-        task_finished_callback_t task_finished_callback);
+        task_finished_callback_t task_finished_callback,
+        clip_info_t clip_info = {});
     void decompress_to_data_format_async(
         std::vector<std::string> input_files, options_t options,
         data_ready_callback_t data_ready_callback,
         task_finished_callback_t task_finished_callback);
+    // decodes whole input to s16le pcm in memory
+    std::pair<pcm_info_t, std::string> decompress_to_data_raw(
+        std::vector<std::string> input_files, options_t options);
     data_info_t get_data(char* data, size_t max_size);
     std::pair<data_info_t, std::string> get_all_data();
     size_t data_size() const;
@@ -138,6 +155,14 @@ class media_compressor {
         decompress_to_data_format_async
     };
 
+    // probe results of file, valid as long as size and mtime are the same
+    struct probe_t {
+        int64_t size = 0;
+        int64_t mtime_ns = 0;
+        std::optional<media_info_t> media_info;
+        std::optional<size_t> duration;
+    };
+
     struct filter_ctx {
         AVFilterInOut* out = nullptr;
         AVFilterInOut* in = nullptr;
@@ -150,6 +175,8 @@ class media_compressor {
     std::string m_output_file;
     format_t m_format = format_t::unknown;
     AVFormatContext* m_in_av_format_ctx = nullptr;
+    AVIOContext* m_in_avio_ctx = nullptr;
+    int m_in_fd = -1;
     AVFormatContext* m_out_av_format_ctx = nullptr;
     AVCodecContext* m_in_av_ctx = nullptr;
     AVCodecContext* m_out_av_ctx = nullptr;
@@ -162,18 +189,34 @@ class media_compressor {
     std::mutex m_mtx;
     bool m_error = false;
     std::vector<char> m_buf;
+    bool m_buf_unbounded = false;
     data_info_t m_data_info;
     clip_info_t m_clip_info;
     options_t m_options;
     bool m_no_decode = false;
     data_ready_callback_t m_data_ready_callback;
     uint64_t m_in_bytes_read = 0;
+    inline static const size_t m_probe_cache_max_size = 100;
+    inline static std::unordered_map<std::string, probe_t> m_probe_cache;
+    inline static std::mutex m_probe_cache_mtx;
+    // clipping by seeking and trimming decoded audio
+    bool m_clip_by_time = false;
+    bool m_clip_time_eof = false;
+    int64_t m_clip_stop_ts = 0;
+    int64_t m_clip_start_ts = 0;
+    uint64_t m_clip_time_read_ms = 0;
+    bool m_clip_time_progress = false;
 
     void init_av(task_t task);
     void init_av_filter(const char* arg);
     void init_av_in_format(const std::string& input_file,
                            bool skip_stream_discovery);
+    void init_clip_by_time();
+    bool clip_time_reached(const AVPacket* pkt);
     void clean_av();
+    static std::optional<probe_t> cached_probe(const std::string& file);
+    static void update_probe_cache(const std::string& file,
+                                   const std::function<void(probe_t&)>& update);
     void clean_av_in_format();
     void process();
     bool read_frame(AVPacket* pkt);
@@ -192,9 +235,13 @@ class media_compressor {
         task_t task, std::vector<std::string>&& input_files,
         std::string output_file, options_t options,
         data_ready_callback_t&& data_ready_callback,
-        task_finished_callback_t&& task_finished_callback);
+        task_finished_callback_t&& task_finished_callback,
+        clip_info_t clip_info = {});
     void write_to_buf(const char* data, int size);
     static int write_packet_callback(void* opaque, uint8_t* buf, int buf_size);
+    static int read_packet_callback(void* opaque, uint8_t* buf, int buf_size);
+    static int64_t seek_callback(void* opaque, int64_t offset, int whence);
+    void open_in_file(const std::string& input_file);
 };
 
 #endif // MEDIA_COMPRESSOR_HPP
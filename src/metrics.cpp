@@ -0,0 +1,263 @@
+/* Copyright (C) 2024 Michal Kosciesza <michal@mkiol.net>
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+#include "metrics.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+
+#include "logger.hpp"
+#include "nlohmann/json.hpp"
+
+std::ostream& operator<<(std::ostream& os, metrics::stage_t stage) {
+    switch (stage) {
+        case metrics::stage_t::audio_capture:
+            os << "audio-capture";
+            break;
+        case metrics::stage_t::denoise:
+            os << "denoise";
+            break;
+        case metrics::stage_t::vad:
+            os << "vad";
+            break;
+        case metrics::stage_t::input_wait:
+            os << "input-wait";
+            break;
+        case metrics::stage_t::decode:
+            os << "decode";
+            break;
+        case metrics::stage_t::tts_synth:
+            os << "tts-synth";
+            break;
+        case metrics::stage_t::tts_stretch:
+            os << "tts-stretch";
+            break;
+        case metrics::stage_t::tts_compress:
+            os << "tts-compress";
+            break;
+        case metrics::stage_t::mnt_translate:
+            os << "mnt-translate";
+            break;
+        case metrics::stage_t::model_load:
+            os << "model-load";
+            break;
+    }
+
+    return os;
+}
+
+void metrics::scoped_timer::stop() {
+    if (m_stopped) return;
+    m_stopped = true;
+
+    metrics::instance()->record_since(m_stage, m_start, m_units);
+}
+
+metrics::metrics() : m_start_time{clock::now()} {}
+
+metrics::~metrics() { disable_dump(); }
+
+uint64_t metrics::samples_to_ms(size_t samples, int sample_rate) {
+    if (sample_rate <= 0) return 0;
+    return (static_cast<uint64_t>(samples) * 1000) / sample_rate;
+}
+
+bool metrics::is_audio_stage(stage_t stage) {
+    switch (stage) {
+        case stage_t::audio_capture:
+        case stage_t::denoise:
+        case stage_t::vad:
+        case stage_t::input_wait:
+        case stage_t::decode:
+            return true;
+        case stage_t::tts_synth:
+        case stage_t::tts_stretch:
+        case stage_t::tts_compress:
+        case stage_t::mnt_translate:
+        case stage_t::model_load:
+            break;
+    }
+
+    return false;
+}
+
+void metrics::record(stage_t stage, std::chrono::microseconds duration,
+                     uint64_t units) {
+    auto us = static_cast<uint64_t>(std::max<int64_t>(0, duration.count()));
+
+    auto& sm = m_stages.at(static_cast<size_t>(stage));
+
+    sm.count.fetch_add(1, std::memory_order_relaxed);
+    sm.total_us.fetch_add(us, std::memory_order_relaxed);
+    sm.units.fetch_add(units, std::memory_order_relaxed);
+
+    auto max_us = sm.max_us.load(std::memory_order_relaxed);
+    while (max_us < us && !sm.max_us.compare_exchange_weak(
+                              max_us, us, std::memory_order_relaxed)) {
+    }
+
+    auto bucket = static_cast<size_t>(
+        std::distance(m_bucket_bounds.cbegin(),
+                      std::lower_bound(m_bucket_bounds.cbegin(),
+                                       m_bucket_bounds.cend(), us)));
+    sm.buckets[bucket].fetch_add(1, std::memory_order_relaxed);
+}
+
+void metrics::record_since(stage_t stage, clock::time_point start,
+                           uint64_t units) {
+    record(stage,
+           std::chrono::duration_cast<std::chrono::microseconds>(clock::now() -
+                                                                 start),
+           units);
+}
+
+void metrics::reset() {
+    for (auto& sm : m_stages) {
+        sm.count = 0;
+        sm.total_us = 0;
+        sm.max_us = 0;
+        sm.units = 0;
+        for (auto& b : sm.buckets) b = 0;
+    }
+}
+
+uint64_t metrics::percentile(const stage_metrics_t& stage_metrics,
+                             uint64_t count, double p) {
+    if (count == 0) return 0;
+
+    auto rank = static_cast<uint64_t>(p * count);
+    if (rank == 0) rank = 1;
+
+    uint64_t acc = 0;
+    for (size_t i = 0; i < m_bucket_bounds.size(); ++i) {
+        acc += stage_metrics.buckets[i].load(std::memory_order_relaxed);
+        if (acc >= rank)
+            return std::min(m_bucket_bounds[i],
+                            stage_metrics.max_us.load(std::memory_order_relaxed));
+    }
+
+    return stage_metrics.max_us.load(std::memory_order_relaxed);
+}
+
+std::string metrics::to_json() const {
+    auto to_ms = [](uint64_t us) { return static_cast<double>(us) / 1000.0; };
+
+    nlohmann::json stages = nlohmann::json::object();
+
+    for (size_t i = 0; i < m_stage_count; ++i) {
+        const auto& sm = m_stages[i];
+        auto stage = static_cast<stage_t>(i);
+
+        auto count = sm.count.load(std::memory_order_relaxed);
+        auto total_us = sm.total_us.load(std::memory_order_relaxed);
+        auto units = sm.units.load(std::memory_order_relaxed);
+
+        nlohmann::json json_stage{
+            {"count", count},
+            {"total_ms", to_ms(total_us)},
+            {"avg_ms", count == 0 ? 0.0 : to_ms(total_us) / count},
+            {"max_ms", to_ms(sm.max_us.load(std::memory_order_relaxed))},
+            {"p50_ms", to_ms(percentile(sm, count, 0.5))},
+            {"p90_ms", to_ms(percentile(sm, count, 0.9))},
+            {"p99_ms", to_ms(percentile(sm, count, 0.99))}};
+
+        if (is_audio_stage(stage)) {
+            json_stage["audio_ms"] = units;
+            // real-time factor: processing time / audio duration
+            if (units > 0 && stage != stage_t::input_wait)
+                json_stage["rtf"] = to_ms(total_us) / units;
+        } else if (stage != stage_t::model_load) {
+            json_stage["chars"] = units;
+        }
+
+        nlohmann::json buckets = nlohmann::json::array();
+        for (size_t b = 0; b < sm.buckets.size(); ++b) {
+            auto bucket_count = sm.buckets[b].load(std::memory_order_relaxed);
+            if (bucket_count == 0) continue;
+            if (b < m_bucket_bounds.size())
+                buckets.push_back(
+                    {{"le_ms", to_ms(m_bucket_bounds[b])}, {"count", bucket_count}});
+            else
+                buckets.push_back({{"le_ms", "inf"}, {"count", bucket_count}});
+        }
+        json_stage["buckets"] = std::move(buckets);
+
+        std::ostringstream os;
+        os << stage;
+        stages[os.str()] = std::move(json_stage);
+    }
+
+    nlohmann::json json{
+        {"uptime_s", std::chrono::duration_cast<std::chrono::seconds>(
+                         clock::now() - m_start_time)
+                         .count()},
+        {"stages", std::move(stages)}};
+
+    return json.dump();
+}
+
+bool metrics::dump_to_file(const std::string& file) const {
+    // write to temporary file and rename to never expose partial content
+    auto tmp_file = file + ".tmp";
+
+    {
+        std::ofstream os{tmp_file, std::ios::trunc};
+        if (!os) {
+            LOGE("failed to open metrics file: " << tmp_file);
+            return false;
+        }
+        os << to_json() << '\n';
+    }
+
+    if (std::rename(tmp_file.c_str(), file.c_str()) != 0) {
+        LOGE("failed to rename metrics file: " << tmp_file);
+        return false;
+    }
+
+    return true;
+}
+
+void metrics::dump_loop(std::string file, std::chrono::seconds interval) {
+    LOGD("metrics dump started: file=" << file
+                                       << ", interval=" << interval.count());
+
+    bool exit = false;
+
+    while (!exit) {
+        {
+            std::unique_lock lock{m_dump_mtx};
+            exit = m_dump_cv.wait_for(lock, interval,
+                                      [this] { return m_dump_exit_requested; });
+        }
+
+        dump_to_file(file);
+    }
+
+    LOGD("metrics dump ended");
+}
+
+void metrics::enable_dump(std::string file, std::chrono::seconds interval) {
+    disable_dump();
+
+    if (file.empty()) return;
+
+    m_dump_exit_requested = false;
+    m_dump_thread = std::thread{&metrics::dump_loop, this, std::move(file),
+                                std::max(interval, std::chrono::seconds{1})};
+}
+
+void metrics::disable_dump() {
+    {
+        std::lock_guard lock{m_dump_mtx};
+        m_dump_exit_requested = true;
+    }
+
+    m_dump_cv.notify_one();
+    if (m_dump_thread.joinable()) m_dump_thread.join();
+}
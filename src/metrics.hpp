@@ -0,0 +1,110 @@
+/* Copyright (C) 2024 Michal Kosciesza <michal@mkiol.net>
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+#ifndef METRICS_HPP
+#define METRICS_HPP
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <thread>
+
+#include "singleton.h"
+
+// Registry of per-stage counters and latency histograms.
+// Recording is lock-free and can be done from any thread.
+
+class metrics : public singleton<metrics> {
+   public:
+    enum class stage_t : size_t {
+        audio_capture = 0,
+        denoise,
+        vad,
+        // time audio waited in input buffer before processing
+        input_wait,
+        decode,
+        tts_synth,
+        tts_stretch,
+        tts_compress,
+        mnt_translate,
+        model_load
+    };
+    friend std::ostream& operator<<(std::ostream& os, stage_t stage);
+
+    using clock = std::chrono::steady_clock;
+
+    // Measures time from construction to destruction (or to stop()).
+    class scoped_timer {
+       public:
+        explicit scoped_timer(stage_t stage, uint64_t units = 0)
+            : m_stage{stage}, m_units{units}, m_start{clock::now()} {}
+        ~scoped_timer() { stop(); }
+        scoped_timer(const scoped_timer&) = delete;
+        scoped_timer& operator=(const scoped_timer&) = delete;
+        inline void set_units(uint64_t units) { m_units = units; }
+        void stop();
+        void cancel() { m_stopped = true; }
+
+       private:
+        stage_t m_stage;
+        uint64_t m_units = 0;
+        clock::time_point m_start;
+        bool m_stopped = false;
+    };
+
+    metrics();
+    ~metrics() override;
+    // 'units' is amount of processed data: audio duration in ms for audio
+    // stages and number of characters for text stages
+    void record(stage_t stage, std::chrono::microseconds duration,
+                uint64_t units = 0);
+    void record_since(stage_t stage, clock::time_point start,
+                      uint64_t units = 0);
+    std::string to_json() const;
+    void reset();
+    // Periodically writes metrics in JSON format to 'file'.
+    void enable_dump(std::string file, std::chrono::seconds interval);
+    void disable_dump();
+    static uint64_t samples_to_ms(size_t samples, int sample_rate);
+
+   private:
+    inline static const size_t m_stage_count =
+        static_cast<size_t>(stage_t::model_load) + 1;
+    // upper bounds of histogram buckets in us, last bucket is unbounded
+    inline static const std::array<uint64_t, 18> m_bucket_bounds{
+        100,     250,     500,     1000,     2500,     5000,
+        10000,   25000,   50000,   100000,   250000,   500000,
+        1000000, 2500000, 5000000, 10000000, 30000000, 60000000};
+
+    struct stage_metrics_t {
+        std::atomic<uint64_t> count = 0;
+        std::atomic<uint64_t> total_us = 0;
+        std::atomic<uint64_t> max_us = 0;
+        std::atomic<uint64_t> units = 0;
+        std::array<std::atomic<uint64_t>, m_bucket_bounds.size() + 1> buckets{};
+    };
+
+    std::array<stage_metrics_t, m_stage_count> m_stages;
+    clock::time_point m_start_time;
+    std::thread m_dump_thread;
+    std::mutex m_dump_mtx;
+    std::condition_variable m_dump_cv;
+    bool m_dump_exit_requested = false;
+
+    static bool is_audio_stage(stage_t stage);
+    static uint64_t percentile(const stage_metrics_t& stage_metrics,
+                               uint64_t count, double p);
+    void dump_loop(std::string file, std::chrono::seconds interval);
+    bool dump_to_file(const std::string& file) const;
+};
+
+#endif  // METRICS_HPP
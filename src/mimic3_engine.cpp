@@ -19,6 +19,7 @@
 #include <utility>
 
 #include "logger.hpp"
+#include "py_buf_tools.hpp"
 #include "py_executor.hpp"
 
 using namespace pybind11::literals;
@@ -148,16 +149,8 @@ bool mimic3_engine::encode_speech_impl(const std::string& text,
             for (auto& result : results) {
                 sample_rate = result.attr("sample_rate_hz").cast<int>();
 
-                auto bytes = result.attr("audio_bytes");
-
-                std::vector<unsigned char> data;
-                data.reserve(py::len(bytes));
-
-                for (const auto& byte : bytes)
-                    data.push_back(byte.cast<unsigned char>());
-
-                wav_file.write(reinterpret_cast<char*>(data.data()),
-                               data.size());
+                py_buf_tools::write_to_stream(result.attr("audio_bytes"),
+                                              wav_file);
             }
         } catch (const std::exception& err) {
             LOGE("py error: " << err.what());
@@ -15,10 +15,10 @@
 #include <array>
 #include <chrono>
 #include <numeric>
-#include <regex>
 
 #include "cpu_tools.hpp"
 #include "logger.hpp"
+#include "metrics.hpp"
 #include "text_tools.hpp"
 
 std::ostream& operator<<(std::ostream& os,
@@ -65,7 +65,8 @@ std::ostream& operator<<(std::ostream& os,
 std::ostream& operator<<(std::ostream& os, const mnt_engine::config_t& config) {
     os << "lang=" << config.lang << ", clean-text=" << config.clean_text
        << ", text-format=" << config.text_format
-       << ", options=" << config.options << ", model-files=["
+       << ", options=" << config.options
+       << ", cache-dir=" << config.cache_dir << ", model-files=["
        << config.model_files << "]";
 
     return os;
@@ -349,57 +350,67 @@ std::string mnt_engine::translate_internal(std::string text) {
 
     auto start = std::chrono::steady_clock::now();
 
-    std::ostringstream out_ss;
-
-    std::regex r{html ? "</p>|</div>|</h1>|</h2>|</h3>|</h4>" : "\n"};
-    std::string line;
-
-    const size_t segment_size = 1000;
-    const size_t segment_max_size = 10 * segment_size;
-
-    for (std::smatch sm;
-         std::regex_search(text, sm, r) || !line.empty() || !text.empty();) {
-        if (sm.empty()) {
-            line.append(text);
-            text.clear();
-        } else {
-            line.append(sm.prefix().str() + sm.str());
-            text.assign(sm.suffix());
-        }
-
-        if (line.size() > segment_max_size) {
-            text.insert(0, line, segment_max_size);
-            line.resize(segment_max_size);
+    // Translations are cached per segment. Segments end on content-defined
+    // boundaries and don't depend on number of workers, so unchanged parts
+    // of edited document keep their cache keys. Segments missing in cache
+    // are joined into batches. Bergamot splits each request into sentences
+    // and distributes them among all workers, so one batch should be big
+    // enough to keep every worker busy.
+    const auto batch_size = m_segment_size * m_num_workers;
+
+    std::vector<batch_t> batches;
+    for (auto segment : split_to_cache_segments(text, html)) {
+        if (m_cache) {
+            if (auto cached = m_cache->get(make_cache_key(segment, html))) {
+                auto& batch = batches.emplace_back();
+                batch.source = segment;
+                batch.segments.push_back(segment);
+                batch.text = std::move(*cached);
+                batch.cached = true;
+                continue;
+            }
         }
 
-        if (sm.empty() || line.size() > segment_size) {
-            try {
-                if (is_shutdown()) return {};
-
-                line.assign(m_bergamot_api_api.bergamot_api_translate(
-                    m_bergamot_ctx_first, line.c_str(), html));
+        if (batches.empty() || batches.back().cached ||
+            batches.back().source.size() >= batch_size)
+            batches.emplace_back();
+
+        auto& batch = batches.back();
+        // segments are adjacent, so batch is also a view into text
+        batch.source = batch.source.empty()
+                           ? segment
+                           : std::string_view{batch.source.data(),
+                                              batch.source.size() +
+                                                  segment.size()};
+        batch.segments.push_back(segment);
+    }
 
-                if (is_shutdown()) return {};
+    for (auto& batch : batches) {
+        if (!batch.cached) batch.text.assign(batch.source);
+    }
 
-                if (m_bergamot_ctx_second)
-                    line.assign(m_bergamot_api_api.bergamot_api_translate(
-                        m_bergamot_ctx_second, line.c_str(), html));
+    LOGD("translating batches: count="
+         << batches.size() << ", cached="
+         << std::count_if(batches.cbegin(), batches.cend(),
+                          [](const auto& batch) { return batch.cached; })
+         << ", pivot=" << (m_bergamot_ctx_second ? "yes" : "no"));
 
-                if (is_shutdown()) return {};
-            } catch (const std::runtime_error& err) {
-                LOGE("translation error: " << err.what());
-                if (m_call_backs.error) m_call_backs.error(error_t::runtime);
-            }
+    std::string out;
+    out.reserve(text.size());
 
-            out_ss << line;
-            line.clear();
+    if (m_bergamot_ctx_second) {
+        if (!translate_batches_pipelined(batches, html, out)) return {};
+    } else {
+        for (auto& batch : batches) {
+            if (!batch.cached &&
+                !translate_batch(m_bergamot_ctx_first, batch.text, html))
+                return {};
 
-            m_progress.current = m_progress.total - text.size();
-            if (m_call_backs.progress_changed) m_call_backs.progress_changed();
+            batch_translated(batch, html, out);
         }
     }
 
-    text.assign(out_ss.str());
+    text = std::move(out);
 
     auto dur = std::chrono::duration_cast<std::chrono::milliseconds>(
                    std::chrono::steady_clock::now() - start)
@@ -424,9 +435,306 @@ std::string mnt_engine::translate_internal(std::string text) {
     return text;
 }
 
+// Returns end position of first segment boundary (line break or closing
+// tag of html block) found in text[pos, limit). When boundary is not
+// found, returns npos.
+static size_t find_segment_boundary(std::string_view text, size_t pos,
+                                    size_t limit, bool html) {
+    static const std::array<std::string_view, 6> block_end_tags{
+        "</p>", "</div>", "</h1>", "</h2>", "</h3>", "</h4>"};
+
+    // text after limit is never scanned
+    text = text.substr(0, limit);
+
+    const char delim = html ? '<' : '\n';
+
+    while (pos < text.size()) {
+        pos = text.find(delim, pos);
+        if (pos == std::string_view::npos) break;
+
+        if (!html) return pos + 1;
+
+        auto tail = text.substr(pos);
+        for (auto tag : block_end_tags) {
+            if (tail.substr(0, tag.size()) == tag) return pos + tag.size();
+        }
+
+        ++pos;
+    }
+
+    return std::string_view::npos;
+}
+
+static size_t count_segment_boundaries(std::string_view text, bool html) {
+    size_t count = 0;
+
+    for (auto pos = find_segment_boundary(text, 0, text.size(), html);
+         pos != std::string_view::npos;
+         pos = find_segment_boundary(text, pos, text.size(), html))
+        ++count;
+
+    return count;
+}
+
+std::vector<std::string_view> mnt_engine::split_to_segments(
+    std::string_view text, bool html, size_t min_size) {
+    std::vector<std::string_view> segments;
+
+    size_t start = 0;
+    size_t pos = 0;
+
+    while (pos < text.size()) {
+        // boundary is searched only up to max segment size, so every
+        // character is visited once
+        auto limit = std::min(text.size(), start + m_segment_max_size);
+
+        pos = find_segment_boundary(text, pos, limit, html);
+        if (pos == std::string_view::npos) pos = limit;
+
+        if (pos == text.size() || pos - start > min_size ||
+            pos - start == m_segment_max_size) {
+            segments.push_back(text.substr(start, pos - start));
+            start = pos;
+        }
+    }
+
+    return segments;
+}
+
+// Segment ends after block which content matches a hash pattern, so the same
+// text produces the same segments even when preceding text has changed.
+// Thanks to that, cached translations of unchanged parts of edited document
+// can be reused.
+std::vector<std::string_view> mnt_engine::split_to_cache_segments(
+    std::string_view text, bool html, size_t segment_size) {
+    std::vector<std::string_view> segments;
+
+    std::string_view segment;
+    for (auto block : split_to_segments(text, html, 0)) {
+        // blocks are adjacent, so segment is also a view into text
+        segment = segment.empty() ? block
+                                  : std::string_view{segment.data(),
+                                                     segment.size() +
+                                                         block.size()};
+
+        if (segment.size() >= m_segment_max_factor * segment_size ||
+            (segment.size() >= segment_size &&
+             std::hash<std::string_view>{}(block) % m_segment_boundary_ratio ==
+                 0)) {
+            segments.push_back(segment);
+            segment = {};
+        }
+    }
+
+    if (!segment.empty()) segments.push_back(segment);
+
+    return segments;
+}
+
+// Translation preserves segment boundaries, so translation of n-th segment
+// ends after as many boundaries as there are in first n segments. Returns
+// empty vector when boundaries in translation don't match source.
+std::vector<std::string_view> mnt_engine::split_translation(
+    const std::vector<std::string_view>& segments,
+    std::string_view translation, bool html) {
+    if (segments.empty()) return {};
+
+    if (segments.size() > 1) {
+        size_t source_count = 0;
+        for (auto segment : segments)
+            source_count += count_segment_boundaries(segment, html);
+
+        if (source_count != count_segment_boundaries(translation, html))
+            return {};
+    }
+
+    std::vector<std::string_view> parts;
+
+    size_t start = 0;
+    size_t pos = 0;
+
+    for (size_t i = 0; i + 1 < segments.size(); ++i) {
+        const auto segment = segments[i];
+
+        size_t segment_pos = 0;
+        while (true) {
+            auto end = find_segment_boundary(segment, segment_pos,
+                                             segment.size(), html);
+            if (end == std::string_view::npos) break;
+            segment_pos = end;
+
+            pos = find_segment_boundary(translation, pos, translation.size(),
+                                        html);
+            if (pos == std::string_view::npos) return {};
+        }
+
+        // segment cut in the middle of block can't be matched
+        if (segment_pos != segment.size()) return {};
+
+        parts.push_back(translation.substr(start, pos - start));
+        start = pos;
+    }
+
+    parts.push_back(translation.substr(start));
+
+    return parts;
+}
+
+// Runs of spaces and tabs are collapsed and leading and trailing spaces in
+// lines are removed. Line breaks are preserved because they are meaningful for
+// translation.
+std::string mnt_engine::normalize_cache_text(std::string_view text) {
+    std::string normalized;
+    normalized.reserve(text.size());
+
+    bool space = false;
+    for (auto c : text) {
+        if (c == ' ' || c == '\t' || c == '\r') {
+            space = true;
+            continue;
+        }
+
+        if (space && c != '\n' && !normalized.empty() &&
+            normalized.back() != '\n')
+            normalized.push_back(' ');
+        space = false;
+
+        normalized.push_back(c);
+    }
+
+    return normalized;
+}
+
+std::string mnt_engine::make_cache_key(std::string_view text, bool html) const {
+    auto key = m_config.model_files.model_path_first;
+    key.push_back('\n');
+    key.append(m_config.model_files.model_path_second);
+    key.push_back('\n');
+    key.push_back(html ? '1' : '0');
+    key.push_back('\n');
+    key.append(normalize_cache_text(text));
+
+    return key;
+}
+
+bool mnt_engine::translate_batch(void* bergamot_ctx, std::string& batch,
+                                 bool html) {
+    try {
+        if (is_shutdown()) return false;
+
+        batch.assign(m_bergamot_api_api.bergamot_api_translate(
+            bergamot_ctx, batch.c_str(), html));
+
+        if (is_shutdown()) return false;
+    } catch (const std::runtime_error& err) {
+        LOGE("translation error: " << err.what());
+        if (m_call_backs.error) m_call_backs.error(error_t::runtime);
+        return false;
+    }
+
+    return true;
+}
+
+void mnt_engine::batch_translated(batch_t& batch, bool html,
+                                  std::string& out) {
+    if (m_cache && !batch.cached) {
+        auto parts = split_translation(batch.segments, batch.text, html);
+
+        if (parts.empty())
+            LOGW("translated batch can't be split to segments, not cached");
+
+        for (size_t i = 0; i < parts.size(); ++i)
+            m_cache->put(make_cache_key(batch.segments[i], html),
+                         std::string{parts[i]});
+    }
+
+    out.append(batch.text);
+
+    m_progress.current += batch.source.size();
+    if (m_call_backs.progress_changed) m_call_backs.progress_changed();
+}
+
+// Two-stage pipeline for pivot translation. First model runs in a separate
+// thread and translates batch N+1 while second model translates batch N.
+// Batches are exchanged through a bounded queue of batch indexes. Cached
+// batches skip both stages.
+bool mnt_engine::translate_batches_pipelined(std::vector<batch_t>& batches,
+                                             bool html, std::string& out) {
+    std::mutex mtx;
+    std::condition_variable cv;
+    std::queue<size_t> ready;
+    bool first_done = false;
+    bool exit_requested = false;
+
+    std::thread first_stage{[&] {
+        for (size_t i = 0; i < batches.size(); ++i) {
+            if (batches[i].cached) continue;
+
+            {
+                std::unique_lock lock{mtx};
+                cv.wait(lock, [&] {
+                    return exit_requested ||
+                           ready.size() < m_pivot_queue_max_size;
+                });
+                if (exit_requested) break;
+            }
+
+            if (!translate_batch(m_bergamot_ctx_first, batches[i].text, html))
+                break;
+
+            {
+                std::lock_guard lock{mtx};
+                ready.push(i);
+            }
+            cv.notify_all();
+        }
+
+        {
+            std::lock_guard lock{mtx};
+            first_done = true;
+        }
+        cv.notify_all();
+    }};
+
+    bool ok = true;
+
+    for (auto& batch : batches) {
+        if (!batch.cached) {
+            {
+                std::unique_lock lock{mtx};
+                cv.wait(lock, [&] { return first_done || !ready.empty(); });
+                if (ready.empty()) {
+                    ok = false;
+                    break;
+                }
+                // first stage processes batches in order
+                ready.pop();
+            }
+            cv.notify_all();
+
+            ok = translate_batch(m_bergamot_ctx_second, batch.text, html);
+            if (!ok) break;
+        }
+
+        batch_translated(batch, html, out);
+    }
+
+    {
+        std::lock_guard lock{mtx};
+        exit_requested = true;
+    }
+    cv.notify_all();
+    first_stage.join();
+
+    return ok && !is_shutdown();
+}
+
 void mnt_engine::process() {
     LOGD("mnt processing started");
 
+    // bergamot workers are created in this thread and inherit its affinity
+    cpu_tools::set_thread_policy(cpu_tools::thread_role_t::decode);
+
     decltype(m_queue) queue;
 
     while (!is_shutdown()) {
@@ -442,7 +750,10 @@ void mnt_engine::process() {
         if (!model_created()) {
             set_state(state_t::initializing);
 
-            create_model();
+            {
+                metrics::scoped_timer timer{metrics::stage_t::model_load};
+                create_model();
+            }
 
             if (!model_created()) {
                 set_state(state_t::error);
@@ -457,8 +768,13 @@ void mnt_engine::process() {
             auto task = std::move(queue.front());
             queue.pop();
 
+            metrics::scoped_timer timer{metrics::stage_t::mnt_translate,
+                                        task.text.size()};
+
             auto text = translate_internal(task.text);
 
+            timer.stop();
+
             if (is_shutdown()) break;
 
             m_call_backs.text_translated(task.text, m_config.lang,
@@ -484,6 +800,16 @@ bool mnt_engine::model_created() const {
 }
 
 void mnt_engine::create_model() {
+    if (!m_cache && !m_config.cache_dir.empty())
+        m_cache.emplace(m_config.cache_dir + "/" + m_cache_file_name,
+                        m_cache_max_size);
+
+    m_num_workers =
+        std::min<size_t>(m_max_workers, cpu_tools::decode_threads());
+
+    LOGD("using workers: " << m_num_workers << "/"
+                           << std::thread::hardware_concurrency());
+
     auto create = [this](void** bergamot_ctx, const std::string& model_path) {
         auto model_file = find_file_with_name_prefix(model_path, "model");
         auto vocab_file = find_file_with_name_prefix(model_path, "vocab");
@@ -510,7 +836,7 @@ void mnt_engine::create_model() {
             *bergamot_ctx = m_bergamot_api_api.bergamot_api_make(
                 model_file.c_str(), src_vocab_file.c_str(),
                 trg_vocab_file.c_str(), shortlist_path.c_str(),
-                /*num_workers=*/1,
+                /*num_workers=*/m_num_workers,
                 /*cache_size=*/500000, nullptr);
         } catch (const std::exception& err) {
             LOGE("error: " << err.what());
@@ -18,9 +18,12 @@
 #include <optional>
 #include <queue>
 #include <string>
+#include <string_view>
 #include <thread>
 #include <vector>
 
+#include "disk_cache.hpp"
+
 class mnt_engine {
    public:
     enum class state_t {
@@ -72,6 +75,7 @@ class mnt_engine {
         std::string out_lang;
         text_format_t text_format = text_format_t::raw;
         std::string options;
+        std::string cache_dir;
         bool clean_text = false;
     };
     friend std::ostream& operator<<(std::ostream& os, const config_t& config);
@@ -115,11 +119,34 @@ class mnt_engine {
         }
     };
 
+    struct batch_t {
+        // view into source text
+        std::string_view source;
+        // views of cache segments which make the batch
+        std::vector<std::string_view> segments;
+        // source text before translation, translated text after
+        std::string text;
+        bool cached = false;
+    };
+
     struct progress_t {
         unsigned int current = 0;
         unsigned int total = 0;
     };
 
+    inline static const size_t m_max_workers = 8;
+    inline static const size_t m_segment_size = 1000;
+    inline static const size_t m_segment_max_size = 10 * m_segment_size;
+    // max number of batches translated by first model and waiting for
+    // second model in pivot translation
+    inline static const size_t m_pivot_queue_max_size = 2;
+    // cache segment is closed after on average every n-th block once it
+    // reaches target size, and always when it reaches factor * target size
+    inline static const size_t m_segment_boundary_ratio = 8;
+    inline static const size_t m_segment_max_factor = 4;
+    inline static const char* const m_cache_file_name = "mnt_cache.bin";
+    inline static const size_t m_cache_max_size = 64 * 1024 * 1024;
+
     config_t m_config;
     callbacks_t m_call_backs;
     bergamot_api_api m_bergamot_api_api;
@@ -132,6 +159,8 @@ class mnt_engine {
     void* m_bergamot_ctx_first = nullptr;
     void* m_bergamot_ctx_second = nullptr;
     progress_t m_progress;
+    size_t m_num_workers = 1;
+    std::optional<disk_cache> m_cache;
 
     static std::string find_file_with_name_prefix(std::string dir_path,
                                                   std::string prefix);
@@ -141,6 +170,19 @@ class mnt_engine {
     void set_state(state_t new_state);
     void process();
     std::string translate_internal(std::string text);
+    static std::vector<std::string_view> split_to_segments(
+        std::string_view text, bool html, size_t min_size = m_segment_size);
+    static std::vector<std::string_view> split_to_cache_segments(
+        std::string_view text, bool html, size_t segment_size = m_segment_size);
+    static std::vector<std::string_view> split_translation(
+        const std::vector<std::string_view>& segments,
+        std::string_view translation, bool html);
+    static std::string normalize_cache_text(std::string_view text);
+    std::string make_cache_key(std::string_view text, bool html) const;
+    void batch_translated(batch_t& batch, bool html, std::string& out);
+    bool translate_batch(void* bergamot_ctx, std::string& batch, bool html);
+    bool translate_batches_pipelined(std::vector<batch_t>& batches,
+                                     bool html, std::string& out);
     void open_lib();
     inline bool is_shutdown() const {
         return m_state == state_t::stopping || m_state == state_t::stopped ||
@@ -0,0 +1,289 @@
+/* Copyright (C) 2024 Michal Kosciesza <michal@mkiol.net>
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+#include "note_store.h"
+
+#include <QDataStream>
+#include <QDebug>
+#include <QSaveFile>
+#include <algorithm>
+
+// size of edit record in the log: pos, size, text length and utf-16 text
+static qint64 log_record_size(const QString& text) {
+    return 3 * static_cast<qint64>(sizeof(qint32)) +
+           2 * static_cast<qint64>(text.size());
+}
+
+note_store::~note_store() { close_log(); }
+
+bool note_store::load(const QString& file) {
+    close_log();
+
+    m_file = file;
+    m_text.clear();
+    m_log_size = 0;
+    clear_history();
+
+    if (m_file.isEmpty()) return true;
+
+    QFile f{m_file};
+
+    if (!f.exists()) {
+        compact();
+        return true;
+    }
+
+    if (!f.open(QIODevice::ReadOnly)) {
+        qWarning() << "failed to open note file:" << m_file;
+        return false;
+    }
+
+    QDataStream ds{&f};
+    ds.setVersion(QDataStream::Qt_5_0);
+
+    quint32 magic = 0;
+    qint32 version = 0;
+    ds >> magic >> version >> m_text;
+
+    bool valid = ds.status() == QDataStream::Ok && magic == m_magic &&
+                 version == m_version;
+
+    if (valid) {
+        while (!ds.atEnd()) {
+            qint32 pos = 0, size = 0;
+            QString text;
+            ds >> pos >> size >> text;
+
+            if (ds.status() != QDataStream::Ok || pos < 0 || size < 0 ||
+                pos > m_text.size() || size > m_text.size() - pos) {
+                valid = false;
+                break;
+            }
+
+            m_text.replace(pos, size, text);
+            m_log_size += log_record_size(text);
+        }
+
+        if (!valid) qWarning() << "note file is truncated:" << m_file;
+    } else {
+        qWarning() << "invalid note file:" << m_file;
+        m_text.clear();
+    }
+
+    f.close();
+
+    qDebug() << "note loaded:" << m_file << m_text.size();
+
+    // broken records are removed by rewriting the file
+    if (!valid ||
+        m_log_size > std::max(m_compact_min_size, 2 * log_record_size(m_text)))
+        compact();
+    else
+        open_log();
+
+    return valid;
+}
+
+void note_store::set_file(const QString& file) {
+    if (file == m_file) return;
+
+    close_log();
+
+    if (!m_file.isEmpty()) QFile::remove(m_file);
+
+    m_file = file;
+    m_log_size = 0;
+
+    if (!m_file.isEmpty()) compact();
+}
+
+bool note_store::set_text(const QString& text) {
+    auto old_size = m_text.size();
+    auto new_size = text.size();
+    auto l = std::min(old_size, new_size);
+
+    // only the part between common prefix and suffix is changed
+    int prefix = 0;
+    while (prefix < l && m_text.at(prefix) == text.at(prefix)) ++prefix;
+
+    if (prefix == old_size && prefix == new_size) return false;
+
+    int suffix = 0;
+    while (suffix < l - prefix &&
+           m_text.at(old_size - 1 - suffix) == text.at(new_size - 1 - suffix))
+        ++suffix;
+
+    replace(prefix, old_size - prefix - suffix,
+            text.mid(prefix, new_size - prefix - suffix));
+
+    return true;
+}
+
+void note_store::append(const QString& text) {
+    replace(m_text.size(), 0, text);
+}
+
+void note_store::replace(int pos, int size, const QString& text) {
+    pos = std::clamp(pos, 0, m_text.size());
+    size = std::clamp(size, 0, m_text.size() - pos);
+
+    if (size == 0 && text.isEmpty()) return;
+
+    record(pos, apply(pos, size, text), text);
+}
+
+void note_store::make_undo_point() { m_group_open = false; }
+
+bool note_store::undo() {
+    if (m_undo.empty()) return false;
+
+    auto group = std::move(m_undo.back());
+    m_undo.pop_back();
+
+    for (auto it = group.crbegin(); it != group.crend(); ++it) {
+        apply(it->pos, it->inserted.size(), it->removed);
+        m_undo_size -= it->removed.size() + it->inserted.size();
+    }
+
+    m_redo.push_back(std::move(group));
+    m_group_open = false;
+
+    return true;
+}
+
+bool note_store::redo() {
+    if (m_redo.empty()) return false;
+
+    auto group = std::move(m_redo.back());
+    m_redo.pop_back();
+
+    for (const auto& edit : group) {
+        apply(edit.pos, edit.removed.size(), edit.inserted);
+        m_undo_size += edit.removed.size() + edit.inserted.size();
+    }
+
+    m_undo.push_back(std::move(group));
+    m_group_open = false;
+
+    trim_undo();
+
+    return true;
+}
+
+void note_store::clear_history() {
+    m_undo.clear();
+    m_redo.clear();
+    m_undo_size = 0;
+    m_group_open = false;
+}
+
+QString note_store::apply(int pos, int size, const QString& text) {
+    auto removed = m_text.mid(pos, size);
+
+    m_text.replace(pos, size, text);
+
+    append_to_log(pos, size, text);
+
+    return removed;
+}
+
+void note_store::record(int pos, QString removed, const QString& inserted) {
+    m_redo.clear();
+
+    if (m_group_open && !m_undo.empty()) {
+        auto& last = m_undo.back().back();
+        auto last_end = last.pos + last.inserted.size();
+
+        // typing and deleting at the end of previous insertion is merged
+        // into one edit
+        if (removed.isEmpty() && pos == last_end) {
+            last.inserted.append(inserted);
+            m_undo_size += inserted.size();
+            trim_undo();
+            return;
+        }
+
+        if (inserted.isEmpty() && pos >= last.pos &&
+            pos + removed.size() == last_end) {
+            last.inserted.chop(removed.size());
+            m_undo_size -= removed.size();
+            return;
+        }
+    }
+
+    if (!m_group_open || m_undo.empty()) {
+        m_undo.emplace_back();
+        m_group_open = true;
+    }
+
+    m_undo_size += removed.size() + inserted.size();
+    m_undo.back().push_back({pos, std::move(removed), inserted});
+
+    trim_undo();
+}
+
+void note_store::trim_undo() {
+    // the most recent group is always kept
+    while (m_undo.size() > 1 && (m_undo.size() > m_max_undo_groups ||
+                                 m_undo_size > m_max_undo_size)) {
+        for (const auto& edit : m_undo.front())
+            m_undo_size -= edit.removed.size() + edit.inserted.size();
+        m_undo.pop_front();
+    }
+}
+
+void note_store::append_to_log(int pos, int size, const QString& text) {
+    if (!m_log.isOpen()) return;
+
+    QDataStream ds{&m_log};
+    ds.setVersion(QDataStream::Qt_5_0);
+    ds << static_cast<qint32>(pos) << static_cast<qint32>(size) << text;
+    m_log.flush();
+
+    m_log_size += log_record_size(text);
+
+    if (m_log_size >
+        std::max(m_compact_min_size, 2 * log_record_size(m_text)))
+        compact();
+}
+
+bool note_store::compact() {
+    close_log();
+
+    QSaveFile f{m_file};
+    if (!f.open(QIODevice::WriteOnly)) {
+        qWarning() << "failed to open note file:" << m_file;
+        return false;
+    }
+
+    QDataStream ds{&f};
+    ds.setVersion(QDataStream::Qt_5_0);
+    ds << m_magic << m_version << m_text;
+
+    if (ds.status() != QDataStream::Ok || !f.commit()) {
+        qWarning() << "failed to write note file:" << m_file;
+        return false;
+    }
+
+    m_log_size = 0;
+
+    qDebug() << "note file compacted:" << m_file;
+
+    open_log();
+
+    return true;
+}
+
+void note_store::open_log() {
+    m_log.setFileName(m_file);
+    if (!m_log.open(QIODevice::WriteOnly | QIODevice::Append))
+        qWarning() << "failed to open note file:" << m_file;
+}
+
+void note_store::close_log() {
+    if (m_log.isOpen()) m_log.close();
+}
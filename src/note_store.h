@@ -0,0 +1,78 @@
+/* Copyright (C) 2024 Michal Kosciesza <michal@mkiol.net>
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+#ifndef NOTE_STORE_H
+#define NOTE_STORE_H
+
+#include <QFile>
+#include <QString>
+#include <deque>
+#include <vector>
+
+// Note text persisted as a snapshot followed by a log of edits. Every
+// change appends only the edited part to the file. The file is rewritten
+// (compacted) when the log grows bigger than the text itself.
+// Undo history is kept as a list of edits grouped by undo points.
+
+class note_store {
+   public:
+    note_store() = default;
+    ~note_store();
+    note_store(const note_store&) = delete;
+    note_store& operator=(const note_store&) = delete;
+
+    // loads note from the file and keeps it in sync with the file
+    bool load(const QString& file);
+    // writes current note to the file and keeps it in sync with the file,
+    // empty file name removes previous file and keeps note only in memory
+    void set_file(const QString& file);
+    inline const QString& file() const { return m_file; }
+    inline const QString& text() const { return m_text; }
+    bool set_text(const QString& text);
+    void append(const QString& text);
+    void replace(int pos, int size, const QString& text);
+    // changes after undo point are reverted in a single undo step
+    void make_undo_point();
+    inline bool can_undo() const { return !m_undo.empty(); }
+    inline bool can_redo() const { return !m_redo.empty(); }
+    bool undo();
+    bool redo();
+    void clear_history();
+
+   private:
+    struct edit_t {
+        int pos = 0;
+        QString removed;
+        QString inserted;
+    };
+    using group_t = std::vector<edit_t>;
+
+    inline static const quint32 m_magic = 0x4E4F5445;  // NOTE
+    inline static const qint32 m_version = 1;
+    inline static const size_t m_max_undo_groups = 100;
+    inline static const qint64 m_max_undo_size = 1000000;  // chars
+    inline static const qint64 m_compact_min_size = 1000000;  // bytes
+
+    QString m_text;
+    QString m_file;
+    QFile m_log;
+    qint64 m_log_size = 0;
+    std::deque<group_t> m_undo;
+    std::vector<group_t> m_redo;
+    qint64 m_undo_size = 0;
+    bool m_group_open = false;
+
+    QString apply(int pos, int size, const QString& text);
+    void record(int pos, QString removed, const QString& inserted);
+    void trim_undo();
+    void append_to_log(int pos, int size, const QString& text);
+    bool compact();
+    void open_log();
+    void close_log();
+};
+
+#endif  // NOTE_STORE_H
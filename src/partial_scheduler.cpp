@@ -0,0 +1,57 @@
+/* Copyright (C) 2024 Michal Kosciesza <michal@mkiol.net>
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+#include "partial_scheduler.hpp"
+
+#include <algorithm>
+
+#include "logger.hpp"
+
+partial_scheduler::partial_scheduler(config_t config) : m_config{config} {}
+
+void partial_scheduler::reset() {
+    m_audio_since_partial_ms = 0;
+    m_backoff = 1;
+}
+
+size_t partial_scheduler::interval_ms() const {
+    auto interval = static_cast<double>(m_config.latency_target_ms);
+
+    if (m_cost_ms && m_config.max_load > 0)
+        interval = std::max(interval, *m_cost_ms / m_config.max_load);
+
+    return std::min(m_config.max_interval_ms,
+                    static_cast<size_t>(interval * m_backoff));
+}
+
+bool partial_scheduler::feed(size_t audio_ms, size_t lag_ms) {
+    m_audio_since_partial_ms += audio_ms;
+
+    if (lag_ms > m_config.max_lag_ms) {
+        if (m_backoff < m_max_backoff) {
+            m_backoff *= 2;
+            LOGD("partial interval backoff: lag="
+                 << lag_ms << "ms, backoff=" << m_backoff);
+        }
+    } else if (m_backoff > 1) {
+        m_backoff /= 2;
+    }
+
+    if (m_audio_since_partial_ms < interval_ms()) return false;
+
+    m_audio_since_partial_ms = 0;
+
+    return true;
+}
+
+void partial_scheduler::partial_decoded(size_t decode_ms) {
+    if (m_cost_ms)
+        m_cost_ms =
+            m_cost_alpha * decode_ms + (1.0 - m_cost_alpha) * *m_cost_ms;
+    else
+        m_cost_ms = decode_ms;
+}
@@ -0,0 +1,55 @@
+/* Copyright (C) 2024 Michal Kosciesza <michal@mkiol.net>
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+#ifndef PARTIAL_SCHEDULER_H
+#define PARTIAL_SCHEDULER_H
+
+#include <cstddef>
+#include <optional>
+
+// Decides when streaming engine should produce partial (intermediate)
+// result. Interval between partials is never shorter than latency target
+// and is extended when partial decoding would take more than max load of
+// audio time. When engine falls behind audio input, interval is doubled
+// and it goes back to normal when input is processed on time.
+
+class partial_scheduler {
+   public:
+    struct config_t {
+        // desired interval between partial results
+        size_t latency_target_ms = 500;
+        // max part of audio time spent on partial decoding
+        double max_load = 0.5;
+        size_t max_interval_ms = 10000;
+        // input waiting longer than this means that engine is behind
+        size_t max_lag_ms = 250;
+    };
+
+    partial_scheduler() = default;
+    explicit partial_scheduler(config_t config);
+    // clears counters of current stream, measured decoding cost is kept
+    void reset();
+    // audio_ms - duration of audio fed since last call, lag_ms - how long
+    // input was waiting for processing, returns true when partial is due
+    bool feed(size_t audio_ms, size_t lag_ms);
+    // duration of partial decoding
+    void partial_decoded(size_t decode_ms);
+    size_t interval_ms() const;
+    inline const auto& config() const { return m_config; }
+
+   private:
+    inline static const double m_cost_alpha = 0.3;
+    inline static const unsigned int m_max_backoff = 16;
+
+    config_t m_config;
+    size_t m_audio_since_partial_ms = 0;
+    // moving average of partial decoding duration
+    std::optional<double> m_cost_ms;
+    unsigned int m_backoff = 1;
+};
+
+#endif  // PARTIAL_SCHEDULER_H
@@ -0,0 +1,248 @@
+/* Copyright (C) 2024 Michal Kosciesza <michal@mkiol.net>
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+#include "pcm_player.h"
+
+#include <QAudioDeviceInfo>
+#include <QDebug>
+#include <algorithm>
+#include <cstring>
+
+void pcm_player::buffer_t::push(QByteArray data) {
+    if (data.isEmpty()) return;
+
+    m_size_pushed += data.size();
+    m_chunks.push_back(std::move(data));
+
+    emit readyRead();
+}
+
+void pcm_player::buffer_t::clear() {
+    m_chunks.clear();
+    m_chunk_pos = 0;
+    m_size_pushed = 0;
+}
+
+qint64 pcm_player::buffer_t::bytesAvailable() const {
+    qint64 size = -m_chunk_pos;
+    for (const auto& chunk : m_chunks) size += chunk.size();
+    return size + QIODevice::bytesAvailable();
+}
+
+qint64 pcm_player::buffer_t::readData(char* data, qint64 max_size) {
+    qint64 total = 0;
+
+    while (total < max_size && !m_chunks.empty()) {
+        const auto& chunk = m_chunks.front();
+
+        auto size = std::min(max_size - total, chunk.size() - m_chunk_pos);
+        memcpy(data + total, chunk.constData() + m_chunk_pos, size);
+
+        total += size;
+        m_chunk_pos += size;
+
+        if (m_chunk_pos >= chunk.size()) {
+            m_chunks.pop_front();
+            m_chunk_pos = 0;
+        }
+    }
+
+    return total;
+}
+
+qint64 pcm_player::buffer_t::writeData([[maybe_unused]] const char* data,
+                                       [[maybe_unused]] qint64 size) {
+    return -1;
+}
+
+pcm_player::pcm_player(QObject* parent) : QObject{parent} {
+    m_buffer.open(QIODevice::ReadOnly);
+}
+
+pcm_player::~pcm_player() {
+    if (m_output) {
+        m_output->disconnect(this);
+        m_output->stop();
+        // output reads from buffer, so it can't outlive it
+        delete m_output;
+    }
+}
+
+QAudioFormat pcm_player::make_format(int sample_rate, int channels) {
+    QAudioFormat format;
+    format.setSampleRate(sample_rate);
+    format.setChannelCount(channels);
+    format.setSampleSize(16);
+    format.setCodec(QStringLiteral("audio/pcm"));
+    format.setByteOrder(QAudioFormat::LittleEndian);
+    format.setSampleType(QAudioFormat::SignedInt);
+
+    return format;
+}
+
+int pcm_player::append(QByteArray pcm, int sample_rate, int channels) {
+    auto id = ++m_last_id;
+
+    m_segments.push_back({id, std::move(pcm), sample_rate, channels});
+
+    feed();
+
+    return id;
+}
+
+void pcm_player::pause() {
+    if (m_state == state_t::paused) return;
+
+    // player is paused also when nothing is playing, so new segments
+    // don't start until resume
+    if (m_output && m_output->state() == QAudio::ActiveState)
+        m_output->suspend();
+
+    set_state(state_t::paused);
+}
+
+void pcm_player::resume() {
+    if (m_state != state_t::paused) return;
+
+    if (m_output && m_output->state() == QAudio::SuspendedState) {
+        m_output->resume();
+        set_state(state_t::playing);
+    } else {
+        set_state(state_t::stopped);
+    }
+
+    feed();
+}
+
+void pcm_player::stop() {
+    m_segments.clear();
+    m_pending_starts.clear();
+
+    set_state(state_t::stopped);
+
+    if (m_output) m_output->stop();
+
+    m_buffer.clear();
+}
+
+void pcm_player::feed() {
+    bool running = m_output && (m_output->state() == QAudio::ActiveState ||
+                                m_output->state() == QAudio::SuspendedState);
+
+    if (!running) {
+        if (m_state == state_t::paused) return;
+
+        // all data passed to output so far has been played
+        m_buffer.clear();
+
+        auto it = std::find_if(
+            m_segments.cbegin(), m_segments.cend(),
+            [](const auto& segment) { return !segment.pcm.isEmpty(); });
+
+        if (it != m_segments.cend()) {
+            auto format = make_format(it->sample_rate, it->channels);
+            if (!m_output || format != m_format) start_output(format);
+        }
+    }
+
+    while (!m_segments.empty()) {
+        auto& segment = m_segments.front();
+
+        // segment in other format waits until output is drained
+        if (!segment.pcm.isEmpty() &&
+            make_format(segment.sample_rate, segment.channels) != m_format)
+            break;
+
+        m_pending_starts.emplace_back(m_buffer.size_pushed(), segment.id);
+        m_buffer.push(std::move(segment.pcm));
+        m_segments.pop_front();
+    }
+
+    if (!running && m_output && m_buffer.size_pushed() > 0) {
+        m_output->start(&m_buffer);
+        set_state(state_t::playing);
+    }
+
+    update_position();
+}
+
+void pcm_player::start_output(const QAudioFormat& format) {
+    if (m_output) {
+        // old output can be a sender of currently handled signal
+        m_output->disconnect(this);
+        m_output->stop();
+        m_output->deleteLater();
+    }
+
+    auto info = QAudioDeviceInfo::defaultOutputDevice();
+    if (!info.isFormatSupported(format))
+        qWarning() << "audio format may not be supported by output:"
+                   << info.deviceName() << format;
+
+    qDebug() << "audio output format:" << format;
+
+    m_format = format;
+    m_output = new QAudioOutput{info, m_format, this};
+    m_output->setNotifyInterval(m_notify_interval);
+
+    connect(m_output, &QAudioOutput::notify, this,
+            &pcm_player::update_position);
+    connect(m_output, &QAudioOutput::stateChanged, this,
+            &pcm_player::handle_output_state_changed);
+}
+
+void pcm_player::update_position() {
+    bool running = m_output && (m_output->state() == QAudio::ActiveState ||
+                                m_output->state() == QAudio::SuspendedState);
+
+    auto played = running
+                      ? m_format.bytesForDuration(m_output->processedUSecs())
+                      : m_buffer.size_pushed();
+
+    // handler of segment_started can stop player, so queue is checked every
+    // time
+    while (!m_pending_starts.empty() &&
+           m_pending_starts.front().first <= played) {
+        auto id = m_pending_starts.front().second;
+        m_pending_starts.pop_front();
+        emit segment_started(id);
+    }
+}
+
+void pcm_player::handle_output_state_changed(QAudio::State new_state) {
+    switch (new_state) {
+        case QAudio::IdleState:
+            // all data has been played
+            m_output->stop();
+            break;
+        case QAudio::StoppedState:
+            if (m_output->error() != QAudio::NoError &&
+                m_output->error() != QAudio::UnderrunError)
+                qWarning() << "audio output error:" << m_output->error();
+
+            update_position();
+
+            feed();
+
+            if (m_state == state_t::playing &&
+                m_output->state() != QAudio::ActiveState)
+                set_state(state_t::stopped);
+            break;
+        case QAudio::ActiveState:
+        case QAudio::SuspendedState:
+        case QAudio::InterruptedState:
+            break;
+    }
+}
+
+void pcm_player::set_state(state_t new_state) {
+    if (m_state == new_state) return;
+
+    m_state = new_state;
+
+    emit state_changed();
+}
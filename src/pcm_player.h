@@ -0,0 +1,90 @@
+/* Copyright (C) 2024 Michal Kosciesza <michal@mkiol.net>
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+#ifndef PCM_PLAYER_H
+#define PCM_PLAYER_H
+
+#include <QAudio>
+#include <QAudioFormat>
+#include <QAudioOutput>
+#include <QByteArray>
+#include <QIODevice>
+#include <QObject>
+#include <deque>
+#include <utility>
+
+// Plays s16le PCM segments one after another without gaps. Segments are
+// appended while previous ones are still playing. Segments with different
+// format are played after the output is drained and reconfigured.
+
+class pcm_player : public QObject {
+    Q_OBJECT
+   public:
+    enum class state_t { stopped, playing, paused };
+
+    explicit pcm_player(QObject* parent = nullptr);
+    ~pcm_player() override;
+    // empty segment is a marker which starts when all previous segments
+    // are played, returns id of segment
+    int append(QByteArray pcm, int sample_rate, int channels);
+    void pause();
+    void resume();
+    // stops playback and removes all segments
+    void stop();
+    inline state_t state() const { return m_state; }
+
+   signals:
+    void segment_started(int id);
+    void state_changed();
+
+   private:
+    static const int m_notify_interval = 50;  // ms
+
+    struct segment_t {
+        int id = 0;
+        QByteArray pcm;
+        int sample_rate = 0;
+        int channels = 0;
+    };
+
+    // feeds queued pcm data to audio output
+    class buffer_t : public QIODevice {
+       public:
+        void push(QByteArray data);
+        void clear();
+        inline qint64 size_pushed() const { return m_size_pushed; }
+        inline bool isSequential() const override { return true; }
+        qint64 bytesAvailable() const override;
+
+       private:
+        std::deque<QByteArray> m_chunks;
+        qint64 m_chunk_pos = 0;
+        qint64 m_size_pushed = 0;
+
+        qint64 readData(char* data, qint64 max_size) override;
+        qint64 writeData(const char* data, qint64 size) override;
+    };
+
+    QAudioOutput* m_output = nullptr;
+    QAudioFormat m_format;
+    buffer_t m_buffer;
+    // segments not passed to buffer yet
+    std::deque<segment_t> m_segments;
+    // segments in buffer which didn't start yet: offset in buffer and id
+    std::deque<std::pair<qint64, int>> m_pending_starts;
+    state_t m_state = state_t::stopped;
+    int m_last_id = 0;
+
+    static QAudioFormat make_format(int sample_rate, int channels);
+    void feed();
+    void start_output(const QAudioFormat& format);
+    void update_position();
+    void handle_output_state_changed(QAudio::State new_state);
+    void set_state(state_t new_state);
+};
+
+#endif  // PCM_PLAYER_H
@@ -8,8 +8,10 @@
 #include "punctuator.hpp"
 
 #include <algorithm>
+#include <cctype>
+#include <chrono>
 #include <iostream>
-#include <numeric>
+#include <iterator>
 
 #include "logger.hpp"
 #include "py_executor.hpp"
@@ -56,6 +58,8 @@ punctuator::punctuator(const std::string& model_path, int device) {
 punctuator::~punctuator() {
     LOGD("puntuator dtor");
 
+    wait_for_pending();
+
     auto task = py_executor::instance()->execute([&]() {
         try {
             m_pipeline.reset();
@@ -70,51 +74,210 @@ punctuator::~punctuator() {
     LOGD("puntuator stopped");
 }
 
+// converts offset in code points (python str) to offset in utf-8 bytes
+static size_t utf8_offset(const std::string& text, size_t cp_offset) {
+    size_t pos = 0;
+    while (pos < text.size() && cp_offset > 0) {
+        ++pos;
+        while (pos < text.size() && (text[pos] & 0xC0) == 0x80) ++pos;
+        --cp_offset;
+    }
+    return pos;
+}
+
+bool punctuator::sentence_end(const std::string& text) {
+    return !text.empty() &&
+           (text.back() == '.' || text.back() == '?' || text.back() == '!');
+}
+
+std::string punctuator::join_spans(std::vector<span_t>::const_iterator first,
+                                   std::vector<span_t>::const_iterator last,
+                                   bool capitalize_first) {
+    std::string text;
+
+    for (auto it = first; it != last; ++it) {
+        auto word = it->word;
+
+        if (!word.empty() &&
+            (text.empty() ? capitalize_first : sentence_end(text)))
+            word.front() = std::toupper(word.front());
+
+        if (!text.empty()) text += " ";
+
+        text += word;
+
+        if (it->punct != "0") text += it->punct;
+    }
+
+    return text;
+}
+
+std::vector<punctuator::span_t> punctuator::run_pipeline(
+    const std::string& text) {
+    std::vector<span_t> spans;
+
+    auto result = m_pipeline->attr("__call__")(text);
+    if (result.is_none()) return spans;
+
+    for (const auto& item : result.cast<py::list>()) {
+        const auto& dict = item.cast<py::dict>();
+
+        span_t span;
+        span.word = dict["word"].cast<std::string>();
+        span.punct = dict["entity_group"].cast<std::string>();
+        if (dict.contains("end") && !dict["end"].is_none())
+            span.end = utf8_offset(text, dict["end"].cast<size_t>());
+
+        spans.push_back(std::move(span));
+    }
+
+    return spans;
+}
+
 std::string punctuator::process(std::string text) {
-    auto task =
-        py_executor::instance()->execute(
-            [&]() {
-                try {
-                    auto result = m_pipeline->attr("__call__")(text);
-
-                    if (!result.is_none()) {
-                        auto list = result.cast<py::list>();
-
-                        text = std::accumulate(
-                            list.begin(), list.end(), std::string{},
-                            [](auto text, const auto& item) {
-                                const auto& dict =
-                                    item.template cast<py::dict>();
-                                const auto& eg =
-                                    dict["entity_group"]
-                                        .template cast<decltype(text)>();
-                                auto word =
-                                    dict["word"]
-                                        .template cast<decltype(text)>();
-
-                                if (!word.empty() &&
-                                    (text.empty() || text.back() == '.' ||
-                                     text.back() == '?' || text.back() == '!'))
-                                    word.front() = std::toupper(word.front());
-
-                                if (!text.empty()) text += " ";
-
-                                text += word;
-
-                                if (eg != "0") text += eg;
-
-                                return text;
-                            });
-                    }
-                } catch (const std::exception& err) {
-                    LOGE(
-                        "failed to restore punctuation, error: " << err.what());
-                }
-
-                return text;
-            });
+    auto task = py_executor::instance()->execute([&]() {
+        try {
+            auto spans = run_pipeline(text);
+            if (!spans.empty())
+                text = join_spans(spans.cbegin(), spans.cend(), true);
+        } catch (const std::exception& err) {
+            LOGE("failed to restore punctuation, error: " << err.what());
+        }
+
+        return text;
+    });
 
     if (task) return std::any_cast<std::string>(task->get());
 
     return text;
 }
+
+std::string punctuator::process_tail(const std::string& text) {
+    if (text.compare(0, m_done_in.size(), m_done_in) != 0) {
+        // text is not continuation of the previous one
+        m_done_in.clear();
+        m_done_out.clear();
+    }
+
+    auto tail = text.substr(m_done_in.size());
+
+    auto spans = run_pipeline(tail);
+    auto first = spans.cbegin();
+    auto capitalize = m_done_out.empty() || sentence_end(m_done_out);
+
+    if (tail.size() > m_window_size) {
+        // words far enough from the end are finalized, preferably at the end
+        // of the sentence, so they are not punctuated again
+        auto limit = tail.size() - m_context_size;
+        auto force = tail.size() > 2 * m_window_size;
+
+        auto cut = first;
+        for (auto it = spans.cbegin(); it != spans.cend(); ++it) {
+            if (it->end == std::string::npos || it->end > limit) break;
+            if (force || sentence_end(it->punct)) cut = it + 1;
+        }
+
+        if (cut != first) {
+            auto out = join_spans(first, cut, capitalize);
+            if (!m_done_out.empty()) m_done_out += " ";
+            m_done_out += out;
+            m_done_in += tail.substr(0, std::prev(cut)->end);
+            first = cut;
+            capitalize = sentence_end(m_done_out);
+
+            LOGD("punctuation finalized: size=" << m_done_in.size());
+        }
+    }
+
+    auto out = join_spans(first, spans.cend(), capitalize);
+
+    if (m_done_out.empty()) return out;
+    if (out.empty()) return m_done_out;
+    return m_done_out + " " + out;
+}
+
+std::string punctuator::process_incremental(const std::string& text) {
+    wait_for_pending();
+
+    auto task = py_executor::instance()->execute([&]() {
+        try {
+            return process_tail(text);
+        } catch (const std::exception& err) {
+            LOGE("failed to restore punctuation, error: " << err.what());
+        }
+
+        return text;
+    });
+
+    if (task) {
+        auto result = task->get();
+        if (result.has_value()) {
+            m_last_in = text;
+            m_last_out = std::any_cast<std::string>(std::move(result));
+            return m_last_out;
+        }
+    }
+
+    return text;
+}
+
+std::string punctuator::process_async(const std::string& text) {
+    if (m_pending && m_pending->wait_for(std::chrono::seconds{0}) ==
+                         std::future_status::ready)
+        take_pending();
+
+    // only one task is in flight, texts that came in the meantime are
+    // skipped and the latest one is punctuated next
+    if (!m_pending && text != m_last_in) {
+        m_pending = py_executor::instance()->execute([this, text]() {
+            try {
+                return process_tail(text);
+            } catch (const std::exception& err) {
+                LOGE("failed to restore punctuation, error: " << err.what());
+            }
+
+            return text;
+        });
+        if (m_pending) m_pending_in = text;
+    }
+
+    if (!m_last_in.empty() &&
+        text.compare(0, m_last_in.size(), m_last_in) == 0)
+        return m_last_out + text.substr(m_last_in.size());
+
+    return text;
+}
+
+void punctuator::take_pending() {
+    try {
+        auto result = m_pending->get();
+        if (result.has_value()) {
+            m_last_out = std::any_cast<std::string>(std::move(result));
+            m_last_in = std::move(m_pending_in);
+        }
+    } catch (const std::exception& err) {
+        LOGE("failed to restore punctuation, error: " << err.what());
+    }
+
+    m_pending.reset();
+    m_pending_in.clear();
+}
+
+void punctuator::wait_for_pending() {
+    if (m_pending) take_pending();
+}
+
+void punctuator::reset() {
+    wait_for_pending();
+
+    m_last_in.clear();
+    m_last_out.clear();
+
+    auto task = py_executor::instance()->execute([&]() {
+        m_done_in.clear();
+        m_done_out.clear();
+        return std::any{};
+    });
+
+    if (task) task->get();
+}
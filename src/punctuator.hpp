@@ -13,19 +13,65 @@
 #include <pybind11/pytypes.h>
 #define slots Q_SLOTS
 
+#include <any>
+#include <future>
 #include <optional>
 #include <string>
+#include <vector>
 
 namespace py = pybind11;
 
+// All public functions must be called from the same thread.
+// Text that grows over time (intermediate results) should be passed to
+// process_async() or process_incremental(). In both cases finalized prefix of
+// the text is cached and only bounded tail window is punctuated again.
 class punctuator {
    public:
     punctuator(const std::string& model_path, int device = -1);
     ~punctuator();
+    // punctuates whole text, cache is not used
     std::string process(std::string text);
+    // punctuates tail of the text and waits for the result
+    std::string process_incremental(const std::string& text);
+    // does not block, the latest text is punctuated in the background and
+    // the most recent result is applied to the text, when result is not
+    // available yet, text is returned as-is
+    std::string process_async(const std::string& text);
+    // clears cache, should be called when utterance ends
+    void reset();
 
    private:
+    struct span_t {
+        std::string word;
+        std::string punct;
+        // end of the span in input text (in bytes), npos when unknown
+        size_t end = std::string::npos;
+    };
+
+    // max size of the tail that is punctuated again (in bytes)
+    inline static const size_t m_window_size = 400;
+    // size of the tail that is never finalized, punctuation model needs
+    // right context to decide about punctuation of the last words
+    inline static const size_t m_context_size = 150;
+
     std::optional<py::object> m_pipeline;
+    // state used only in py thread
+    std::string m_done_in;
+    std::string m_done_out;
+    // state used only in caller thread
+    std::optional<std::future<std::any>> m_pending;
+    std::string m_pending_in;
+    std::string m_last_in;
+    std::string m_last_out;
+
+    std::vector<span_t> run_pipeline(const std::string& text);
+    std::string process_tail(const std::string& text);
+    void wait_for_pending();
+    void take_pending();
+    static std::string join_spans(std::vector<span_t>::const_iterator first,
+                                  std::vector<span_t>::const_iterator last,
+                                  bool capitalize_first);
+    static bool sentence_end(const std::string& text);
 };
 
 #endif  // PUNCTUATOR_H
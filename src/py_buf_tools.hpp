@@ -0,0 +1,77 @@
+/* Copyright (C) 2024 Michal Kosciesza <michal@mkiol.net>
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+#ifndef PY_BUF_TOOLS_HPP
+#define PY_BUF_TOOLS_HPP
+
+#undef slots
+#include <pybind11/numpy.h>
+#include <pybind11/pytypes.h>
+#define slots Q_SLOTS
+
+#include <cstddef>
+#include <ostream>
+#include <stdexcept>
+#include <vector>
+
+// Helpers for passing audio buffers between C++ and Python without copying.
+// All functions must be called in py thread (py_executor).
+
+namespace py_buf_tools {
+namespace py = pybind11;
+
+// Returns read-only numpy array that shares memory with 'data'.
+// Array does not own memory, so 'data' must stay valid (and must not be
+// reallocated) as long as Python code uses the array.
+template <typename T>
+py::array_t<T> make_array_view(const T* data, size_t size) {
+    // base object without destructor prevents numpy from taking ownership
+    // and from making a copy
+    py::capsule base{data, [](void*) {}};
+
+    py::array_t<T> array{{static_cast<py::ssize_t>(size)},
+                         {static_cast<py::ssize_t>(sizeof(T))},
+                         data,
+                         base};
+
+    py::detail::array_proxy(array.ptr())->flags &=
+        ~py::detail::npy_api::NPY_ARRAY_WRITEABLE_;
+
+    return array;
+}
+
+template <typename T>
+py::array_t<T> make_array_view(const std::vector<T>& buf) {
+    return make_array_view(buf.data(), buf.size());
+}
+
+// Writes raw content of python bytes or numpy array to 'os'.
+// Data is read directly from python object memory.
+// Returns number of written bytes.
+inline size_t write_to_stream(const py::handle& obj, std::ostream& os) {
+    if (py::isinstance<py::bytes>(obj)) {
+        char* data = nullptr;
+        py::ssize_t size = 0;
+        if (PyBytes_AsStringAndSize(obj.ptr(), &data, &size) != 0)
+            throw py::error_already_set{};
+
+        os.write(data, size);
+
+        return static_cast<size_t>(size);
+    }
+
+    // no copy when array is already c-contiguous
+    auto array = py::array::ensure(obj, py::array::c_style);
+    if (!array) throw std::runtime_error{"object is not an array"};
+
+    os.write(static_cast<const char*>(array.data()), array.nbytes());
+
+    return static_cast<size_t>(array.nbytes());
+}
+}  // namespace py_buf_tools
+
+#endif  // PY_BUF_TOOLS_HPP
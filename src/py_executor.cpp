@@ -45,18 +45,21 @@ std::optional<std::future<std::any> > py_executor::execute(task_t task) {
         return std::nullopt;
     }
 
+    std::future<std::any> future;
+
     {
         std::lock_guard lock{m_mutex};
 
-        m_task.emplace(std::move(task));
-        m_promise.emplace();
+        std::promise<std::any> promise;
+        future = promise.get_future();
+        m_tasks.emplace(std::move(task), std::move(promise));
     }
 
     LOGD("task pushed");
 
     m_cv.notify_one();
 
-    return m_promise->get_future();
+    return future;
 }
 
 static std::string add_to_env_path(const std::string& dir) {
@@ -102,23 +105,28 @@ void py_executor::loop() {
         while (!m_shutting_down) {
             std::unique_lock<std::mutex> lock{m_mutex};
             m_cv.wait(lock,
-                      [this] { return m_shutting_down || m_task.has_value(); });
-
-            auto task = std::move(m_task);
-            m_task.reset();
+                      [this] { return m_shutting_down || !m_tasks.empty(); });
 
             if (m_shutting_down) {
-                if (task) m_promise->set_value({});
+                while (!m_tasks.empty()) {
+                    m_tasks.front().second.set_value({});
+                    m_tasks.pop();
+                }
                 break;
             }
 
+            auto [task, promise] = std::move(m_tasks.front());
+            m_tasks.pop();
+
+            lock.unlock();
+
             try {
                 LOGD("py task execution: start");
-                m_promise->set_value(task.value()());
+                promise.set_value(task());
                 LOGD("py task execution: end");
             } catch (const std::exception& err) {
                 LOGE("py task error: " << err.what());
-                m_promise->set_exception(std::current_exception());
+                promise.set_exception(std::current_exception());
             }
         }
 
@@ -19,7 +19,9 @@
 #include <future>
 #include <mutex>
 #include <optional>
+#include <queue>
 #include <thread>
+#include <utility>
 
 #include "py_tools.hpp"
 #include "singleton.h"
@@ -42,8 +44,9 @@ class py_executor : public singleton<py_executor> {
     std::condition_variable m_cv;
     std::thread m_thread;
     std::optional<py::scoped_interpreter> m_py_interpreter;
-    std::optional<task_t> m_task;
-    std::optional<std::promise<std::any>> m_promise;
+    // tasks are queued, so task pushed while other is still running
+    // (e.g. background punctuation) does not replace it
+    std::queue<std::pair<task_t, std::promise<std::any>>> m_tasks;
 
     void loop();
 };
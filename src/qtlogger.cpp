@@ -17,21 +17,24 @@
 
 static void qtLog(QtMsgType qtType, const QMessageLogContext &qtContext,
                   const QString &qtMsg) {
-    Logger::Message msg{[qtType] {
-                            switch (qtType) {
-                                case QtDebugMsg:
-                                    return Logger::LogType::Debug;
-                                case QtInfoMsg:
-                                    return Logger::LogType::Info;
-                                case QtWarningMsg:
-                                    return Logger::LogType::Warning;
-                                case QtCriticalMsg:
-                                case QtFatalMsg:
-                                    return Logger::LogType::Error;
-                            }
-                            return Logger::LogType::Debug;
-                        }(),
-                        qtContext.file ? qtContext.file : "",
+    auto type = [qtType] {
+        switch (qtType) {
+            case QtDebugMsg:
+                return Logger::LogType::Debug;
+            case QtInfoMsg:
+                return Logger::LogType::Info;
+            case QtWarningMsg:
+                return Logger::LogType::Warning;
+            case QtCriticalMsg:
+            case QtFatalMsg:
+                return Logger::LogType::Error;
+        }
+        return Logger::LogType::Debug;
+    }();
+
+    if (!Logger::match(type)) return;
+
+    Logger::Message msg{type, qtContext.file ? qtContext.file : "",
                         qtContext.function ? qtContext.function : "",
                         qtContext.line};
     msg << qtMsg.toStdString();
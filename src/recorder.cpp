@@ -10,6 +10,7 @@
 #include <QAudioFormat>
 #include <QDebug>
 #include <QFileInfo>
+#include <algorithm>
 #include <chrono>
 
 #include "denoiser.hpp"
@@ -179,37 +180,28 @@ void recorder::denoise(int sample_rate) {
         sample_rate, flags,
         static_cast<uint64_t>(m_audio_device.size() - sizeof(wav_header))};
 
-    std::array<char, denoiser::frame_size * 100> buff;
-
+    // pcm is processed in memory and written back once
     m_audio_device.seek(sizeof(wav_header));
+    auto pcm = m_audio_device.readAll();
 
-    while (!m_cancel_requested) {
-        auto size = m_audio_device.read(buff.data(), buff.size());
-        if (size <= 0) break;
-
-        dn.process_char(buff.data(), size);
-
-        if (clean_ref_voice) {
-            m_audio_device.seek(m_audio_device.pos() - size);
-            m_audio_device.write(buff.data(), size);
-        }
+    const qint64 chunk_size = denoiser::frame_size * 100;
 
-        if (static_cast<size_t>(size) < buff.size()) break;
+    for (qint64 pos = 0; pos < pcm.size() && !m_cancel_requested;
+         pos += chunk_size) {
+        dn.process_char(pcm.data() + pos,
+                        std::min(chunk_size, pcm.size() - pos));
     }
 
     if (clean_ref_voice) {
-        m_audio_device.seek(sizeof(wav_header));
-
-        while (!m_cancel_requested) {
-            auto size = m_audio_device.read(buff.data(), buff.size());
-            if (size <= 0) break;
-
-            dn.normalize_second_pass_char(buff.data(), size);
-
-            m_audio_device.seek(m_audio_device.pos() - size);
-            m_audio_device.write(buff.data(), size);
+        for (qint64 pos = 0; pos < pcm.size() && !m_cancel_requested;
+             pos += chunk_size) {
+            dn.normalize_second_pass_char(
+                pcm.data() + pos, std::min(chunk_size, pcm.size() - pos));
+        }
 
-            if (static_cast<size_t>(size) < buff.size()) break;
+        if (!m_cancel_requested) {
+            m_audio_device.seek(sizeof(wav_header));
+            m_audio_device.write(pcm);
         }
     }
 
@@ -701,21 +701,76 @@ void settings::set_speech_speed(unsigned int value) {
     }
 }
 
+QString settings::note_filepath() {
+    QDir data_dir{
+        QStandardPaths::writableLocation(QStandardPaths::AppDataLocation)};
+    data_dir.mkpath(QStringLiteral("."));
+    return data_dir.filePath(note_filename);
+}
+
+// Note store is created on first use, so only the app (not the service)
+// opens the note file.
+note_store& settings::notes() {
+    if (!m_note_store) {
+        m_note_store.emplace();
+
+        if (keep_last_note()) {
+            m_note_store->load(note_filepath());
+
+            // previous versions kept note in settings file
+            if (contains(QStringLiteral("note"))) {
+                qDebug() << "moving note from settings file";
+                if (m_note_store->text().isEmpty()) {
+                    m_note_store->set_text(
+                        value(QStringLiteral("note")).toString());
+                    m_note_store->clear_history();
+                }
+                remove(QStringLiteral("note"));
+            }
+        }
+    }
+
+    return *m_note_store;
+}
+
 QString settings::note() const {
-    if (keep_last_note())
-        return value(QStringLiteral("note"), {}).toString();
-    else
-        return m_note;
+    // lazy initialization of note store does not change note
+    return const_cast<settings*>(this)->notes().text();
 }
 
 void settings::set_note(const QString& value) {
-    if (note() != value) {
-        if (keep_last_note())
-            setValue(QStringLiteral("note"), value);
-        else
-            m_note = value;
-        emit note_changed();
-    }
+    if (notes().set_text(value)) emit note_changed();
+}
+
+void settings::append_note(const QString& value) {
+    if (value.isEmpty()) return;
+
+    notes().append(value);
+    emit note_changed();
+}
+
+void settings::make_note_undo_point() { notes().make_undo_point(); }
+
+bool settings::can_undo_note() const {
+    return m_note_store && m_note_store->can_undo();
+}
+
+bool settings::can_redo_note() const {
+    return m_note_store && m_note_store->can_redo();
+}
+
+bool settings::undo_note() {
+    if (!notes().undo()) return false;
+
+    emit note_changed();
+    return true;
+}
+
+bool settings::redo_note() {
+    if (!notes().redo()) return false;
+
+    emit note_changed();
+    return true;
 }
 
 int settings::font_size() const {
@@ -1802,16 +1857,12 @@ bool settings::keep_last_note() const {
 
 void settings::set_keep_last_note(bool new_value) {
     if (new_value != keep_last_note()) {
+        auto& store = notes();
+
         setValue(QStringLiteral("keep_last_note"), new_value);
         emit keep_last_note_changed();
 
-        if (new_value) {
-            setValue(QStringLiteral("note"), m_note);
-            m_note.clear();
-        } else {
-            m_note = value(QStringLiteral("note"), {}).toString();
-            setValue(QStringLiteral("note"), {});
-        }
+        store.set_file(new_value ? note_filepath() : QString{});
     }
 }
 
@@ -1863,6 +1914,19 @@ void settings::set_tts_subtitles_sync(bool value) {
     }
 }
 
+// desired interval between partial results of streaming stt engines, it is
+// extended automatically when decoding is too slow
+unsigned int settings::stt_partial_latency() const {
+    return value(QStringLiteral("service/stt_partial_latency"), 500).toUInt();
+}
+
+void settings::set_stt_partial_latency(unsigned int value) {
+    if (value != stt_partial_latency()) {
+        setValue(QStringLiteral("service/stt_partial_latency"), value);
+        emit stt_partial_latency_changed();
+    }
+}
+
 bool settings::py_feature_scan() const {
     return value(QStringLiteral("service/py_feature_scan"), true).toBool();
 }
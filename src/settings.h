@@ -13,10 +13,12 @@
 #include <QString>
 #include <QStringList>
 #include <QUrl>
+#include <optional>
 #ifdef USE_DESKTOP
 #include <QQmlApplicationEngine>
 #endif
 
+#include "note_store.h"
 #include "qdebug.h"
 #include "singleton.h"
 
@@ -251,6 +253,8 @@ class settings : public QSettings, public singleton<settings> {
             set_file_import_action NOTIFY file_import_action_changed)
     Q_PROPERTY(bool tts_subtitles_sync READ tts_subtitles_sync WRITE
                    set_tts_subtitles_sync NOTIFY tts_subtitles_sync_changed)
+    Q_PROPERTY(unsigned int stt_partial_latency READ stt_partial_latency WRITE
+                   set_stt_partial_latency NOTIFY stt_partial_latency_changed)
 
    public:
     enum class mode_t { Stt = 0, Tts = 1 };
@@ -371,6 +375,12 @@ class settings : public QSettings, public singleton<settings> {
     // app
     QString note() const;
     void set_note(const QString &value);
+    void append_note(const QString &value);
+    void make_note_undo_point();
+    bool can_undo_note() const;
+    bool can_redo_note() const;
+    bool undo_note();
+    bool redo_note();
     speech_mode_t speech_mode() const;
     void set_speech_mode(speech_mode_t value);
     unsigned int speech_speed() const;
@@ -627,6 +637,8 @@ class settings : public QSettings, public singleton<settings> {
 
     bool tts_subtitles_sync() const;
     void set_tts_subtitles_sync(bool value);
+    unsigned int stt_partial_latency() const;
+    void set_stt_partial_latency(unsigned int value);
 
    signals:
     // app
@@ -682,6 +694,7 @@ class settings : public QSettings, public singleton<settings> {
     void keep_last_note_changed();
     void file_import_action_changed();
     void tts_subtitles_sync_changed();
+    void stt_partial_latency_changed();
 
     // service
     void models_dir_changed();
@@ -709,6 +722,7 @@ class settings : public QSettings, public singleton<settings> {
    private:
     inline static const QString settings_filename =
         QStringLiteral("settings.conf");
+    inline static const QString note_filename = QStringLiteral("note.dat");
     inline static const QString default_qt_style =
         QStringLiteral("org.kde.desktop");
     inline static const QString default_qt_style_fallback =
@@ -721,13 +735,15 @@ class settings : public QSettings, public singleton<settings> {
     unsigned int m_addon_flags = addon_flags_t::AddonNone;
 
     static QString settings_filepath();
+    static QString note_filepath();
+    note_store &notes();
     void update_audio_inputs();
     void set_restart_required(bool value);
     void enforce_num_threads() const;
     void update_addon_flags();
 
     launch_mode_t m_launch_mode = launch_mode_t::app_stanalone;
-    QString m_note;
+    std::optional<note_store> m_note_store;
 };
 
 #endif  // SETTINGS_H
@@ -12,7 +12,11 @@
 #include <QCoreApplication>
 #include <QDBusConnection>
 #include <QDebug>
+#include <QDir>
 #include <QEventLoop>
+#include <QFile>
+#include <QFileInfo>
+#include <QMetaMethod>
 #include <algorithm>
 #include <cstdlib>
 #include <functional>
@@ -22,12 +26,14 @@
 
 #include "april_engine.hpp"
 #include "coqui_engine.hpp"
+#include "cpu_tools.hpp"
 #include "ds_engine.hpp"
 #include "espeak_engine.hpp"
 #include "fasterwhisper_engine.hpp"
 #include "file_source.h"
 #include "gpu_tools.hpp"
 #include "media_compressor.hpp"
+#include "metrics.hpp"
 #include "mic_source.h"
 #include "mimic3_engine.hpp"
 #include "module_tools.hpp"
@@ -178,6 +184,12 @@ speech_service::speech_service(QObject *parent)
     connect(this, &speech_service::stt_engine_state_changed, this,
             &speech_service::handle_stt_engine_state_changed,
             Qt::QueuedConnection);
+    connect(this, &speech_service::stt_batch_text_decoded, this,
+            &speech_service::handle_batch_text_decoded, Qt::QueuedConnection);
+    connect(this, &speech_service::stt_batch_engine_eof, this,
+            &speech_service::handle_batch_engine_eof, Qt::QueuedConnection);
+    connect(this, &speech_service::stt_batch_file_error, this,
+            &speech_service::handle_batch_file_error, Qt::QueuedConnection);
     connect(this, &speech_service::tts_engine_error, this,
             static_cast<void (speech_service::*)(int)>(
                 &speech_service::handle_tts_engine_error),
@@ -205,8 +217,11 @@ speech_service::speech_service(QObject *parent)
     connect(
         this, &speech_service::requet_update_task_state, this,
         [this] { update_task_state(); }, Qt::QueuedConnection);
-    connect(&m_player, &QMediaPlayer::stateChanged, this,
+    connect(&m_player, &pcm_player::state_changed, this,
             &speech_service::handle_player_state_changed, Qt::QueuedConnection);
+    connect(&m_player, &pcm_player::segment_started, this,
+            &speech_service::handle_player_segment_started,
+            Qt::QueuedConnection);
     connect(
         settings::instance(), &settings::default_stt_model_changed, this,
         [this]() {
@@ -326,6 +341,16 @@ speech_service::speech_service(QObject *parent)
                         << task;
                     emit SttFileTranscribeFinished(task);
                 });
+        connect(this, &speech_service::stt_transcribe_files_file_finished,
+                this,
+                [this](int task, const QString &file, const QString &out_file,
+                       bool ok) {
+                    qDebug() << "[service => dbus] signal "
+                                "SttTranscribeFilesFileFinished:"
+                             << task << file << out_file << ok;
+                    emit SttTranscribeFilesFileFinished(task, file, out_file,
+                                                        ok);
+                });
         connect(
             this, &speech_service::stt_intermediate_text_decoded, this,
             [this](const QString &text, const QString &lang, int task) {
@@ -334,6 +359,15 @@ speech_service::speech_service(QObject *parent)
                     << lang << task;
                 emit SttIntermediateTextDecoded(text, lang, task);
             });
+        connect(this, &speech_service::stt_intermediate_text_changed, this,
+                [this](int task, int base_revision, int offset,
+                       int replaced_size, const QString &text) {
+                    qDebug()
+                        << "[service => dbus] signal SttIntermediateTextChanged:"
+                        << task << base_revision << offset << replaced_size;
+                    emit SttIntermediateTextChanged(task, base_revision, offset,
+                                                    replaced_size, text);
+                });
         connect(this, &speech_service::stt_text_decoded, this,
                 [this](const QString &text, const QString &lang, int task) {
                     qDebug()
@@ -1074,6 +1108,32 @@ static stt_engine::text_format_t stt_text_fromat_from_settings_format(
     throw std::runtime_error("invalid text format");
 }
 
+// time range of file to transcribe in ms
+static media_compressor::clip_info_t clip_info_from_options(
+    const QVariantMap &options) {
+    media_compressor::clip_info_t clip_info;
+
+    if (auto k = QStringLiteral("start_time_ms"); options.contains(k)) {
+        bool ok = false;
+        auto value = options.value(k).toULongLong(&ok);
+        if (ok) clip_info.start_time_ms = value;
+    }
+
+    if (auto k = QStringLiteral("stop_time_ms"); options.contains(k)) {
+        bool ok = false;
+        auto value = options.value(k).toULongLong(&ok);
+        if (ok && value > 0) clip_info.stop_time_ms = value;
+    }
+
+    if (!clip_info.valid_time()) {
+        qWarning() << "invalid time range:" << clip_info.start_time_ms
+                   << clip_info.stop_time_ms;
+        return {};
+    }
+
+    return clip_info;
+}
+
 static stt_engine::sub_config_t stt_sub_config_from_options(
     const QVariantMap &options) {
     stt_engine::sub_config_t sub_config{};
@@ -1085,44 +1145,88 @@ static stt_engine::sub_config_t stt_sub_config_from_options(
     if (auto k = QStringLiteral("sub_max_line_length"); options.contains(k))
         sub_config.max_line_length = options.value(k).toUInt();
 
+    // when only part of file is transcribed, subtitle times are still
+    // relative to beginning of the file
+    sub_config.time_offset_ms = clip_info_from_options(options).start_time_ms;
+
     return sub_config;
 }
 
+stt_engine::config_t speech_service::make_stt_config(
+    const model_config_t &model_config, speech_mode_t speech_mode,
+    const QString &out_lang_id, const QVariantMap &options) {
+    stt_engine::config_t config;
+
+    config.model_files.model_file = model_config.stt->model_file.toStdString();
+    config.model_files.scorer_file =
+        model_config.stt->scorer_file.toStdString();
+    if (model_config.stt->ttt)
+        config.model_files.ttt_model_file =
+            model_config.stt->ttt->model_file.toStdString();
+    config.lang = model_config.stt->lang_id.toStdString();
+    config.lang_code = model_config.stt->lang_code.toStdString();
+    config.speech_mode = static_cast<stt_engine::speech_mode_t>(speech_mode);
+    config.translate =
+        !out_lang_id.isEmpty() && out_lang_id == "en" && config.lang != "en";
+    config.options = model_config.options.toStdString();
+    config.text_format = stt_text_fromat_from_settings_format(
+        text_format_from_options(options));
+    config.sub_config = stt_sub_config_from_options(options);
+    config.partial_latency_ms = settings::instance()->stt_partial_latency();
+
+    if (settings::instance()->stt_use_gpu() &&
+        settings::instance()->has_gpu_device_stt()) {
+        if (auto device = make_gpu_device<stt_engine>(
+                settings::instance()->gpu_device_stt(),
+                settings::instance()->auto_gpu_device_stt())) {
+            config.gpu_device = std::move(*device);
+            config.use_gpu = true;
+        }
+    }
+
+    return config;
+}
+
+static std::unique_ptr<stt_engine> make_stt_engine(
+    models_manager::model_engine_t engine, stt_engine::config_t config,
+    stt_engine::callbacks_t call_backs) {
+    switch (engine) {
+        case models_manager::model_engine_t::stt_ds:
+            return std::make_unique<ds_engine>(std::move(config),
+                                               std::move(call_backs));
+        case models_manager::model_engine_t::stt_vosk:
+            return std::make_unique<vosk_engine>(std::move(config),
+                                                 std::move(call_backs));
+        case models_manager::model_engine_t::stt_whisper:
+            return std::make_unique<whisper_engine>(std::move(config),
+                                                    std::move(call_backs));
+        case models_manager::model_engine_t::stt_fasterwhisper:
+            return std::make_unique<fasterwhisper_engine>(
+                std::move(config), std::move(call_backs));
+        case models_manager::model_engine_t::stt_april:
+            return std::make_unique<april_engine>(std::move(config),
+                                                  std::move(call_backs));
+        case models_manager::model_engine_t::ttt_hftc:
+        case models_manager::model_engine_t::tts_coqui:
+        case models_manager::model_engine_t::tts_piper:
+        case models_manager::model_engine_t::tts_espeak:
+        case models_manager::model_engine_t::tts_rhvoice:
+        case models_manager::model_engine_t::tts_mimic3:
+        case models_manager::model_engine_t::mnt_bergamot:
+            break;
+    }
+
+    throw std::runtime_error{"invalid model engine, expected stt"};
+}
+
 QString speech_service::restart_stt_engine(speech_mode_t speech_mode,
                                            const QString &model_id,
                                            const QString &out_lang_id,
                                            const QVariantMap &options) {
     auto model_config = choose_model_config(engine_t::stt, model_id);
     if (model_config && model_config->stt) {
-        stt_engine::config_t config;
-
-        config.model_files.model_file =
-            model_config->stt->model_file.toStdString();
-        config.model_files.scorer_file =
-            model_config->stt->scorer_file.toStdString();
-        if (model_config->stt->ttt)
-            config.model_files.ttt_model_file =
-                model_config->stt->ttt->model_file.toStdString();
-        config.lang = model_config->stt->lang_id.toStdString();
-        config.lang_code = model_config->stt->lang_code.toStdString();
-        config.speech_mode =
-            static_cast<stt_engine::speech_mode_t>(speech_mode);
-        config.translate = !out_lang_id.isEmpty() && out_lang_id == "en" &&
-                           config.lang != "en";
-        config.options = model_config->options.toStdString();
-        config.text_format = stt_text_fromat_from_settings_format(
-            text_format_from_options(options));
-        config.sub_config = stt_sub_config_from_options(options);
-
-        if (settings::instance()->stt_use_gpu() &&
-            settings::instance()->has_gpu_device_stt()) {
-            if (auto device = make_gpu_device<stt_engine>(
-                    settings::instance()->gpu_device_stt(),
-                    settings::instance()->auto_gpu_device_stt())) {
-                config.gpu_device = std::move(*device);
-                config.use_gpu = true;
-            }
-        }
+        auto config =
+            make_stt_config(*model_config, speech_mode, out_lang_id, options);
 
         bool new_engine_required = [&] {
             if (!m_stt_engine) return true;
@@ -1173,8 +1277,8 @@ QString speech_service::restart_stt_engine(speech_mode_t speech_mode,
                     handle_stt_text_decoded(text);
                 },
                 /*intermediate_text_decoded=*/
-                [this](const std::string &text) {
-                    handle_stt_intermediate_text_decoded(text);
+                [this](const std::string &text, size_t changed_pos) {
+                    handle_stt_intermediate_text_decoded(text, changed_pos);
                 },
                 /*speech_detection_status_changed=*/
                 [this](stt_engine::speech_detection_status_t status) {
@@ -1210,37 +1314,9 @@ QString speech_service::restart_stt_engine(speech_mode_t speech_mode,
                 }};
 
             try {
-                switch (model_config->stt->engine) {
-                    case models_manager::model_engine_t::stt_ds:
-                        m_stt_engine = std::make_unique<ds_engine>(
-                            std::move(config), std::move(call_backs));
-                        break;
-                    case models_manager::model_engine_t::stt_vosk:
-                        m_stt_engine = std::make_unique<vosk_engine>(
-                            std::move(config), std::move(call_backs));
-                        break;
-                    case models_manager::model_engine_t::stt_whisper:
-                        m_stt_engine = std::make_unique<whisper_engine>(
-                            std::move(config), std::move(call_backs));
-                        break;
-                    case models_manager::model_engine_t::stt_fasterwhisper:
-                        m_stt_engine = std::make_unique<fasterwhisper_engine>(
-                            std::move(config), std::move(call_backs));
-                        break;
-                    case models_manager::model_engine_t::stt_april:
-                        m_stt_engine = std::make_unique<april_engine>(
-                            std::move(config), std::move(call_backs));
-                        break;
-                    case models_manager::model_engine_t::ttt_hftc:
-                    case models_manager::model_engine_t::tts_coqui:
-                    case models_manager::model_engine_t::tts_piper:
-                    case models_manager::model_engine_t::tts_espeak:
-                    case models_manager::model_engine_t::tts_rhvoice:
-                    case models_manager::model_engine_t::tts_mimic3:
-                    case models_manager::model_engine_t::mnt_bergamot:
-                        throw std::runtime_error{
-                            "invalid model engine, expected stt"};
-                }
+                m_stt_engine = make_stt_engine(model_config->stt->engine,
+                                               std::move(config),
+                                               std::move(call_backs));
             } catch (const std::runtime_error &err) {
                 qWarning() << "failed to create stt engine:" << err.what();
                 emit error(error_t::stt_engine);
@@ -1251,11 +1327,12 @@ QString speech_service::restart_stt_engine(speech_mode_t speech_mode,
         } else {
             qDebug() << "new stt engine not required, only restart";
             m_stt_engine->stop();
+            // text format and sub config are applied on start
+            m_stt_engine->set_text_format(config.text_format);
+            m_stt_engine->set_sub_config(config.sub_config);
             m_stt_engine->start();
             m_stt_engine->set_speech_mode(
                 static_cast<stt_engine::speech_mode_t>(speech_mode));
-            m_stt_engine->set_text_format(config.text_format);
-            m_stt_engine->set_sub_config(config.sub_config);
         }
 
         return model_config->stt->model_id;
@@ -1542,6 +1619,11 @@ QString speech_service::restart_mnt_engine(const QString &model_or_lang_id,
         config.out_lang = model_config->mnt->out_lang_id.toStdString();
         config.options = model_config->options.toStdString();
         config.clean_text = mnt_clean_text_from_options(options);
+        // translations contain user's text, so they are not stored on disk
+        // when cached data should be removed
+        if (settings::instance()->cache_policy() !=
+            settings::cache_policy_t::CacheRemove)
+            config.cache_dir = settings::instance()->cache_dir().toStdString();
         config.text_format = mnt_text_fromat_from_settings_format(
             text_format_from_options(options));
 
@@ -1623,16 +1705,79 @@ QString speech_service::restart_mnt_engine(const QString &model_or_lang_id,
     return {};
 }
 
+// Number of UTF-16 code units needed to encode UTF-8 text
+static int utf16_size(std::string_view text) {
+    int size = 0;
+    for (unsigned char c : text) {
+        if ((c & 0xC0) != 0x80) ++size;  // first byte of character
+        if (c >= 0xF0) ++size;           // surrogate pair
+    }
+    return size;
+}
+
 void speech_service::handle_stt_intermediate_text_decoded(
-    const std::string &text) {
-    if (m_current_task) {
-        m_last_intermediate_text_task = m_current_task->id;
+    const std::string &text, size_t changed_pos) {
+    if (!m_current_task) {
+        qWarning() << "current task does not exist";
+        return;
+    }
+
+    auto task_id = m_current_task->id;
+
+    m_last_intermediate_text_task = task_id;
+
+    if (isSignalConnected(QMetaMethod::fromSignal(
+            &speech_service::stt_intermediate_text_decoded))) {
         emit stt_intermediate_text_decoded(QString::fromStdString(text),
-                                           m_current_task->model_id,
-                                           m_current_task->id);
+                                           m_current_task->model_id, task_id);
+    }
+
+    // only changed part of the text is converted and sent
+    std::unique_lock lock{m_intermediate_text_mtx};
+
+    auto &it = m_intermediate_text;
+
+    if (it.task != task_id) {
+        it.task = task_id;
+        it.revision = 0;
+        it.text.clear();
+        it.utf16_size = 0;
+    }
+
+    auto pos = std::min({changed_pos, it.text.size(), text.size()});
+
+    auto replaced_size = utf16_size(std::string_view{it.text}.substr(pos));
+    auto offset = it.utf16_size - replaced_size;
+    auto new_text = QString::fromUtf8(text.data() + pos,
+                                      static_cast<int>(text.size() - pos));
+
+    it.text.resize(pos);
+    it.text.append(text, pos);
+    it.utf16_size = offset + new_text.size();
+    auto base_revision = it.revision++;
+
+    lock.unlock();
+
+    emit stt_intermediate_text_changed(task_id, base_revision, offset,
+                                       replaced_size, new_text);
+}
+
+QVariantMap speech_service::stt_intermediate_text(int task) {
+    std::lock_guard lock{m_intermediate_text_mtx};
+
+    QVariantMap snapshot;
+
+    if (m_intermediate_text.task == task) {
+        snapshot.insert(QStringLiteral("text"),
+                        QString::fromStdString(m_intermediate_text.text));
+        snapshot.insert(QStringLiteral("revision"),
+                        m_intermediate_text.revision);
     } else {
-        qWarning() << "current task does not exist";
+        snapshot.insert(QStringLiteral("text"), QString{});
+        snapshot.insert(QStringLiteral("revision"), 0);
     }
+
+    return snapshot;
 }
 
 void speech_service::handle_stt_text_decoded(const QString &, const QString &,
@@ -1659,6 +1804,7 @@ void speech_service::handle_stt_engine_error(int task_id) {
     qDebug() << "stt engine error";
 
     emit error(error_t::stt_engine);
+    emit task_error(error_t::stt_engine, task_id);
 
     if (current_task_id() == task_id) {
         cancel(task_id);
@@ -1685,6 +1831,7 @@ void speech_service::handle_tts_engine_error(int task_id) {
     qDebug() << "tts engine error";
 
     emit error(error_t::tts_engine);
+    emit task_error(error_t::tts_engine, task_id);
 
     if (current_task_id() == task_id) {
         cancel(task_id);
@@ -1912,54 +2059,39 @@ void speech_service::handle_tts_speech_encoded(tts_partial_result_t result) {
 }
 
 void speech_service::handle_tts_queue() {
-    if (m_tts_queue.empty()) return;
-
-    if (m_player.state() == QMediaPlayer::State::PlayingState ||
-        m_player.state() == QMediaPlayer::State::PausedState)
-        return;
-
-    if (m_current_task && m_current_task->paused) return;
-
-    auto &result = m_tts_queue.front();
-
-    if (!result.audio_file_path.isEmpty()) {
-        if (result.audio_format != tts_engine::audio_format_t::wav) {
-            auto audio_file_wav = result.audio_file_path + ".wav";
-            media_compressor{}.decompress_to_file(
-                {result.audio_file_path.toStdString()},
-                audio_file_wav.toStdString(),
-                {media_compressor::quality_t::vbr_medium, /*mono=*/false,
-                 /*sample_rate_16=*/false,
-                 /*stream=*/{}});
-            result.audio_file_path = std::move(audio_file_wav);
-            result.audio_format = tts_engine::audio_format_t::wav;
-            result.remove_audio_file = true;
-        }
-
-        m_player.setMedia(
-            QMediaContent{QUrl::fromLocalFile(result.audio_file_path)});
-
-        m_player.play();
+    while (!m_tts_queue.empty()) {
+        auto result = std::move(m_tts_queue.front());
+        m_tts_queue.pop();
 
-        emit tts_partial_speech_playing(result.text, result.task_id);
-    } else if (result.last) {
-        auto task = result.task_id;
+        if (!result.audio_file_path.isEmpty()) {
+            // speech is decoded in memory and appended to already playing
+            // speech
+            try {
+                auto [info, data] = media_compressor{}.decompress_to_data_raw(
+                    {result.audio_file_path.toStdString()},
+                    {media_compressor::quality_t::vbr_medium, /*mono=*/true,
+                     /*sample_rate_16=*/false,
+                     /*stream=*/{}});
+
+                if (!data.empty()) {
+                    auto id = m_player.append(
+                        QByteArray{data.data(), static_cast<int>(data.size())},
+                        info.sample_rate, info.channels);
+                    m_tts_player_queue.emplace_back(id, result);
+                }
+            } catch (const std::runtime_error &err) {
+                qWarning() << "can't decode speech:" << err.what();
+            }
 
-        tts_stop_speech(task);
-        if (m_tts_queue.empty()) {
-            emit tts_partial_speech_playing("", task);
-        } else {
             if (result.remove_audio_file) QFile::remove(result.audio_file_path);
-            m_tts_queue.pop();
-        }
-        emit tts_play_speech_finished(task);
-    } else {
-        if (!m_tts_queue.empty()) {
-            if (result.remove_audio_file) QFile::remove(result.audio_file_path);
-            m_tts_queue.pop();
         }
 
-        handle_tts_queue();
+        if (result.last) {
+            // marker which starts when all speech has been played
+            result.audio_file_path.clear();
+            auto id = m_player.append({}, 0, 0);
+            m_tts_player_queue.emplace_back(id, std::move(result));
+        }
     }
 }
 
@@ -1971,7 +2103,7 @@ void speech_service::handle_mnt_engine_error(mnt_engine::error_t error_type,
                                              int task_id) {
     qDebug() << "mnt engine error";
 
-    emit error([error_type]() {
+    auto type = [error_type]() {
         switch (error_type) {
             case mnt_engine::error_t::init:
                 return error_t::mnt_engine;
@@ -1979,7 +2111,10 @@ void speech_service::handle_mnt_engine_error(mnt_engine::error_t error_type,
                 return error_t::mnt_runtime;
         }
         throw std::runtime_error("invalid mnt error");
-    }());
+    }();
+
+    emit error(type);
+    emit task_error(type, task_id);
 
     if (current_task_id() == task_id) {
         cancel(task_id);
@@ -2020,39 +2155,42 @@ void speech_service::handle_stt_engine_state_changed(
     if (current_task_id() == task_id) update_task_state();
 }
 
-void speech_service::handle_player_state_changed(
-    QMediaPlayer::State new_state) {
-    qDebug() << "player new state:" << new_state;
+void speech_service::handle_player_state_changed() {
+    qDebug() << "player new state:" << static_cast<int>(m_player.state());
 
     update_task_state();
 
-    if (new_state == QMediaPlayer::State::StoppedState && m_current_task &&
-        m_current_task->engine == engine_t::tts && !m_current_task->paused &&
-        !m_tts_queue.empty()) {
-        const auto &result = m_tts_queue.front();
+    // all speech passed to player has been played
+    if (m_player.state() == pcm_player::state_t::stopped &&
+        !m_tts_player_queue.empty()) {
+        auto task = m_tts_player_queue.front().second.task_id;
 
-        auto task = result.task_id;
+        m_tts_player_queue.clear();
 
-        if (result.last) {
-            tts_stop_speech(task);
-            if (m_tts_queue.empty()) {
-                emit tts_partial_speech_playing("", task);
-            } else {
-                if (result.remove_audio_file)
-                    QFile::remove(result.audio_file_path);
-                m_tts_queue.pop();
-            }
-            emit tts_play_speech_finished(task);
-        } else {
-            if (result.remove_audio_file) QFile::remove(result.audio_file_path);
-            m_tts_queue.pop();
+        if (m_tts_queue.empty()) emit tts_partial_speech_playing("", task);
+    }
+}
 
-            if (m_tts_queue.empty()) {
-                emit tts_partial_speech_playing("", task);
-            }
-        }
+void speech_service::handle_player_segment_started(int id) {
+    // segments of stopped speech are skipped
+    while (!m_tts_player_queue.empty() &&
+           m_tts_player_queue.front().first != id)
+        m_tts_player_queue.pop_front();
+
+    if (m_tts_player_queue.empty()) return;
+
+    const auto &result = m_tts_player_queue.front().second;
+
+    auto task = result.task_id;
 
-        handle_tts_queue();
+    if (result.audio_file_path.isEmpty()) {
+        m_tts_player_queue.clear();
+
+        tts_stop_speech(task);
+        emit tts_partial_speech_playing("", task);
+        emit tts_play_speech_finished(task);
+    } else {
+        emit tts_partial_speech_playing(result.text, task);
     }
 }
 
@@ -2312,6 +2450,8 @@ void speech_service::set_progress(double p) {
 }
 
 double speech_service::stt_transcribe_file_progress(int task) const {
+    if (m_batch && m_batch->id == task) return m_batch->progress;
+
     if (audio_source_type() == source_t::file) {
         if (m_current_task && m_current_task->id == task) {
             return m_progress;
@@ -2595,6 +2735,8 @@ int speech_service::stt_transcribe_file(const QString &file, QString lang,
 
     qDebug() << "stt transcribe file";
 
+    stop_batch();
+
     m_current_task.reset();
 
     m_current_task = {
@@ -2621,14 +2763,20 @@ int speech_service::stt_transcribe_file(const QString &file, QString lang,
     }
 
     auto stream_index = stream_index_from_options(options);
+    auto clip_info = clip_info_from_options(options);
 
     qDebug() << "requested stream index:" << stream_index;
 
+    if (clip_info.time_range())
+        qDebug() << "requested time range:" << clip_info.start_time_ms
+                 << clip_info.stop_time_ms;
+
     try {
         if (QFileInfo::exists(file))
-            restart_audio_source(file, stream_index);
+            restart_audio_source(file, stream_index, clip_info);
         else
-            restart_audio_source(QUrl{file}.toLocalFile(), stream_index);
+            restart_audio_source(QUrl{file}.toLocalFile(), stream_index,
+                                 clip_info);
     } catch (const std::runtime_error &err) {
         m_current_task.reset();
         qCritical() << "audio source error:" << err.what();
@@ -2648,6 +2796,370 @@ int speech_service::stt_transcribe_file(const QString &file, QString lang,
     return m_current_task->id;
 }
 
+int speech_service::stt_transcribe_files(const QStringList &files,
+                                         QString lang, QString out_lang,
+                                         const QVariantMap &options) {
+    if (state() == state_t::unknown || state() == state_t::not_configured ||
+        state() == state_t::busy) {
+        qWarning() << "cannot transcribe_files, invalid state";
+        return INVALID_TASK;
+    }
+
+    if (files.isEmpty()) {
+        qWarning() << "cannot transcribe_files, files not provided";
+        emit error(error_t::file_source);
+        return INVALID_TASK;
+    }
+
+    if (lang.contains('-')) lang = lang.split('-').first();
+    if (out_lang.contains('-')) out_lang = out_lang.split('-').first();
+
+    qDebug() << "stt transcribe files:" << files.size();
+
+    auto model_config = choose_model_config(engine_t::stt, lang);
+    if (!model_config || !model_config->stt) {
+        qWarning() << "cannot transcribe_files, no valid model";
+        return INVALID_TASK;
+    }
+
+    stop_batch();
+
+    if (m_stt_engine) {
+        if (m_stt_engine->started()) stop_stt_engine();
+
+        // engines of batch share model only with each other, so idle engine
+        // is released to not keep second copy of model in memory
+        if (!m_stt_engine->shares_model()) {
+            m_stt_engine.reset();
+            qDebug() << "stt engine destroyed successfully";
+        }
+    }
+
+    auto config = make_stt_config(*model_config, speech_mode_t::automatic,
+                                  out_lang, options);
+
+    m_batch.emplace();
+    m_batch->id = next_task_id();
+    m_batch->files = files;
+    m_batch->options = options;
+
+    try {
+        m_batch->streams.push_back(std::make_unique<batch_stream_t>());
+        auto *stream = m_batch->streams.front().get();
+        stream->engine = make_stt_engine(model_config->stt->engine, config,
+                                         batch_stream_callbacks(stream));
+
+        // with shared model, files are decoded concurrently and cpu
+        // threads are divided between streams
+        if (stream->engine->shares_model() && !config.use_gpu) {
+            auto threads = cpu_tools::decode_threads();
+            auto count = std::min<unsigned int>(
+                std::clamp(threads / m_batch_stream_threads, 1U,
+                           m_batch_max_streams),
+                files.size());
+
+            if (count > 1) {
+                config.max_threads = threads / count;
+                stream->engine->set_max_threads(config.max_threads);
+            }
+
+            while (m_batch->streams.size() < count) {
+                m_batch->streams.push_back(std::make_unique<batch_stream_t>());
+                auto *next_stream = m_batch->streams.back().get();
+                next_stream->engine =
+                    make_stt_engine(model_config->stt->engine, config,
+                                    batch_stream_callbacks(next_stream));
+            }
+        }
+    } catch (const std::runtime_error &err) {
+        qWarning() << "failed to create stt engine:" << err.what();
+        m_batch.reset();
+        emit error(error_t::stt_engine);
+        return INVALID_TASK;
+    }
+
+    qDebug() << "batch streams:" << m_batch->id << m_batch->streams.size();
+
+    m_current_task.reset();
+
+    m_current_task = {m_batch->id,
+                      engine_t::stt,
+                      model_config->stt->model_id,
+                      speech_mode_t::automatic,
+                      out_lang,
+                      0.0,
+                      {},
+                      options,
+                      false};
+
+    for (auto it = m_batch->streams.begin(); it != m_batch->streams.end();) {
+        if (start_batch_stream(**it))
+            ++it;
+        else
+            it = m_batch->streams.erase(it);
+    }
+
+    if (m_batch->streams.empty()) {
+        qWarning() << "failed to transcribe any file";
+        stop_batch();
+        return INVALID_TASK;
+    }
+
+    start_keepalive_current_task();
+
+    emit current_task_changed();
+
+    update_task_state();
+
+    return m_batch->id;
+}
+
+speech_service::batch_stream_t *speech_service::batch_stream(
+    int task_id) const {
+    if (!batch_running()) return nullptr;
+
+    auto it = std::find_if(
+        m_batch->streams.cbegin(), m_batch->streams.cend(),
+        [task_id](const auto &stream) { return stream->task == task_id; });
+
+    return it == m_batch->streams.cend() ? nullptr : it->get();
+}
+
+stt_engine::callbacks_t speech_service::batch_stream_callbacks(
+    batch_stream_t *stream) {
+    // task of stream is changed only when its engine is stopped
+    return {/*text_decoded=*/
+            [this, stream](const std::string &text) {
+                emit stt_batch_text_decoded(QString::fromStdString(text),
+                                            stream->task);
+            },
+            /*intermediate_text_decoded=*/
+            [](const std::string &, size_t) {},
+            /*speech_detection_status_changed=*/
+            [](stt_engine::speech_detection_status_t) {},
+            /*sentence_timeout=*/[] {},
+            /*eof=*/[this, stream] { emit stt_batch_engine_eof(stream->task); },
+            /*error=*/
+            [this, stream] {
+                emit stt_batch_file_error(error_t::stt_engine, stream->task);
+            },
+            /*stopping=*/{},
+            /*stopped=*/{}};
+}
+
+bool speech_service::start_batch_stream(batch_stream_t &stream) {
+    while (m_batch->next_index < m_batch->files.size()) {
+        // engine is restarted for every file, model stays loaded
+        stream.engine->stop();
+        stream.source.reset();
+        stream.index = m_batch->next_index++;
+        stream.task = next_task_id();
+        stream.text.clear();
+
+        const auto &file = m_batch->files.at(stream.index);
+
+        qDebug() << "batch file:" << m_batch->id << stream.index << file;
+
+        stream.engine->start();
+
+        try {
+            stream.source = std::make_unique<file_source>(
+                QFileInfo::exists(file) ? file : QUrl{file}.toLocalFile(),
+                stream_index_from_options(m_batch->options),
+                clip_info_from_options(m_batch->options));
+        } catch (const std::runtime_error &err) {
+            qWarning() << "audio source error:" << err.what();
+            // failure of one file does not stop the batch
+            finish_batch_file(stream, false);
+            continue;
+        }
+
+        connect(
+            stream.source.get(), &audio_source::audio_available, this,
+            [this, task = stream.task] { handle_batch_audio_available(task); },
+            Qt::QueuedConnection);
+        connect(
+            stream.source.get(), &audio_source::error, this,
+            [this, task = stream.task] {
+                handle_batch_file_error(error_t::file_source, task);
+            },
+            Qt::QueuedConnection);
+
+        return true;
+    }
+
+    return false;
+}
+
+void speech_service::continue_batch_stream(batch_stream_t &stream) {
+    if (start_batch_stream(stream)) return;
+
+    // no more files for this stream
+    m_batch->streams.erase(
+        std::find_if(m_batch->streams.begin(), m_batch->streams.end(),
+                     [&stream](const auto &s) { return s.get() == &stream; }));
+
+    if (m_batch->streams.empty()) {
+        auto id = m_batch->id;
+
+        qDebug() << "batch finished:" << id;
+
+        stop_batch();
+
+        emit stt_file_transcribe_finished(id);
+    }
+}
+
+void speech_service::stop_batch() {
+    if (!batch_running()) return;
+
+    m_batch->finished = true;
+    m_batch->streams.clear();
+
+    if (m_current_task && m_current_task->id == m_batch->id) {
+        m_current_task.reset();
+        stop_keepalive_current_task();
+        emit current_task_changed();
+    }
+
+    update_task_state();
+}
+
+void speech_service::handle_batch_audio_available(int task_id) {
+    auto *stream = batch_stream(task_id);
+    if (!stream || !stream->source || !stream->engine->started()) return;
+
+    if (stream->engine->speech_detection_status() ==
+        stt_engine::speech_detection_status_t::initializing) {
+        stream->source->slowdown();
+        return;
+    }
+
+    auto [buf, max_size] = stream->engine->borrow_buf();
+
+    if (buf) {
+        auto audio_data = stream->source->read_audio(buf, max_size);
+
+        stream->engine->return_buf(buf, audio_data.size, audio_data.sof,
+                                   audio_data.eof);
+        update_batch_progress();
+
+        if (audio_data.eof)
+            stream->source->slowdown();
+        else
+            stream->source->speedup();
+    } else {
+        stream->source->slowdown();
+    }
+}
+
+void speech_service::update_batch_progress() {
+    // progress of batch is progress of all files
+    auto done = static_cast<double>(m_batch->results.size());
+    for (const auto &stream : m_batch->streams)
+        if (stream->source) done += std::max(0.0, stream->source->progress());
+
+    auto p = done / m_batch->files.size();
+
+    if (p - m_batch->progress > 0.01 || p >= 1.0) {
+        m_batch->progress = p;
+        emit stt_transcribe_file_progress_changed(p, m_batch->id);
+    }
+}
+
+void speech_service::handle_batch_text_decoded(const QString &text,
+                                               int task_id) {
+    auto *stream = batch_stream(task_id);
+    if (!stream) return;
+
+    auto new_text = text.trimmed();
+    if (new_text.isEmpty()) return;
+
+    if (!stream->text.isEmpty())
+        stream->text.append(text_format_from_options(m_batch->options) ==
+                                    settings::text_format_t::TextFormatSubRip
+                                ? QStringLiteral("\n\n")
+                                : QStringLiteral(" "));
+    stream->text.append(new_text);
+}
+
+void speech_service::handle_batch_engine_eof(int task_id) {
+    auto *stream = batch_stream(task_id);
+    if (!stream) return;
+
+    finish_batch_file(*stream, true);
+    continue_batch_stream(*stream);
+}
+
+void speech_service::handle_batch_file_error(speech_service::error_t type,
+                                             int task_id) {
+    auto *stream = batch_stream(task_id);
+    if (!stream) return;
+
+    qWarning() << "batch file error:" << static_cast<int>(type) << task_id;
+
+    finish_batch_file(*stream, false);
+    continue_batch_stream(*stream);
+}
+
+void speech_service::finish_batch_file(batch_stream_t &stream, bool ok) {
+    auto file = m_batch->files.at(stream.index);
+
+    QString out_file;
+
+    if (ok) {
+        out_file = batch_out_file(
+            QFileInfo::exists(file) ? file : QUrl{file}.toLocalFile(),
+            text_format_from_options(m_batch->options) ==
+                settings::text_format_t::TextFormatSubRip);
+
+        QFile f{out_file};
+        if (f.open(QIODevice::WriteOnly | QIODevice::Text)) {
+            f.write(stream.text.toUtf8());
+        } else {
+            qWarning() << "failed to write transcription:" << out_file;
+            out_file.clear();
+            ok = false;
+        }
+    }
+
+    qDebug() << "batch file finished:" << m_batch->id << file << out_file
+             << ok;
+
+    m_batch->results.push_back(
+        QVariantMap{{QStringLiteral("file"), file},
+                    {QStringLiteral("out_file"), out_file},
+                    {QStringLiteral("ok"), ok}});
+    stream.source.reset();
+    stream.text.clear();
+
+    update_batch_progress();
+
+    emit stt_transcribe_files_file_finished(m_batch->id, file, out_file, ok);
+}
+
+QString speech_service::batch_out_file(const QString &file, bool subrip) {
+    QFileInfo info{file};
+
+    auto base = info.dir().filePath(info.completeBaseName());
+    auto ext = subrip ? QStringLiteral(".srt") : QStringLiteral(".txt");
+
+    // existing files are never overwritten
+    auto out_file = base + ext;
+    for (int i = 1; QFileInfo::exists(out_file); ++i)
+        out_file = base + QStringLiteral("-%1").arg(i) + ext;
+
+    return out_file;
+}
+
+QVariantList speech_service::stt_transcribe_files_results(int task) const {
+    if (m_batch && m_batch->id == task) return m_batch->results;
+
+    qWarning() << "invalid task id";
+
+    return {};
+}
+
 int speech_service::mnt_translate(const QString &text, QString lang,
                                   QString out_lang,
                                   const QVariantMap &options) {
@@ -2660,6 +3172,8 @@ int speech_service::mnt_translate(const QString &text, QString lang,
     if (lang.contains('-')) lang = lang.split('-').first();
     if (lang.contains('-')) out_lang = out_lang.split('-').first();
 
+    stop_batch();
+
     if (m_current_task) {
         if (m_current_task->engine == engine_t::stt)
             stt_stop_listen(m_current_task->id);
@@ -2726,6 +3240,8 @@ int speech_service::stt_start_listen(speech_mode_t mode, QString lang,
 
     qDebug() << "stt start listen";
 
+    stop_batch();
+
     m_current_task.reset();
 
     m_current_task = {next_task_id(),
@@ -2784,6 +3300,8 @@ int speech_service::tts_play_speech(const QString &text, QString lang,
 
     if (lang.contains('-')) lang = lang.split('-').first();
 
+    stop_batch();
+
     if (m_current_task) {
         if (m_current_task->engine == engine_t::stt) {
             stt_stop_listen(m_current_task->id);
@@ -2838,6 +3356,8 @@ int speech_service::tts_speech_to_file(const QString &text, QString lang,
 
     if (lang.contains('-')) lang = lang.split('-').first();
 
+    stop_batch();
+
     if (m_current_task) {
         if (m_current_task->engine == engine_t::stt) {
             stt_stop_listen(m_current_task->id);
@@ -2895,6 +3415,12 @@ int speech_service::cancel(int task) {
         return FAILURE;
     }
 
+    if (batch_running() && m_batch->id == task) {
+        qDebug() << "batch canceled:" << task;
+        stop_batch();
+        return SUCCESS;
+    }
+
     if (m_current_task->id != task) {
         qWarning() << "invalid task id";
     }
@@ -2992,7 +3518,7 @@ int speech_service::tts_pause_speech(int task) {
 
     m_current_task->paused = true;
 
-    if (m_player.state() == QMediaPlayer::PlayingState) m_player.pause();
+    m_player.pause();
 
     update_task_state();
 
@@ -3025,9 +3551,7 @@ int speech_service::tts_resume_speech(int task) {
 
     m_current_task->paused = false;
 
-    if (m_player.state() == QMediaPlayer::PausedState) m_player.play();
-
-    handle_tts_queue();
+    m_player.resume();
 
     update_task_state();
 
@@ -3040,6 +3564,8 @@ void speech_service::clean_tts_queue() {
             QFile::remove(m_tts_queue.front().audio_file_path);
         m_tts_queue.pop();
     }
+
+    m_tts_player_queue.clear();
 }
 
 int speech_service::tts_stop_speech(int task) {
@@ -3135,6 +3661,7 @@ void speech_service::handle_audio_error() {
     if (audio_source_type() == source_t::file && m_current_task) {
         qWarning() << "file audio source error";
         emit error(error_t::file_source);
+        emit task_error(error_t::file_source, m_current_task->id);
         cancel(m_current_task->id);
     } else {
         qWarning() << "audio source error";
@@ -3151,8 +3678,9 @@ void speech_service::handle_audio_ended() {
     }
 }
 
-void speech_service::restart_audio_source(const QString &source_file,
-                                          int stream_index) {
+void speech_service::restart_audio_source(
+    const QString &source_file, int stream_index,
+    media_compressor::clip_info_t clip_info) {
     if (m_stt_engine && m_stt_engine->started()) {
         qDebug() << "creating audio source";
 
@@ -3161,7 +3689,8 @@ void speech_service::restart_audio_source(const QString &source_file,
         if (source_file.isEmpty())
             m_source = std::make_unique<mic_source>();
         else
-            m_source = std::make_unique<file_source>(source_file, stream_index);
+            m_source = std::make_unique<file_source>(source_file, stream_index,
+                                                     clip_info);
 
         set_progress(m_source->progress());
         connect(m_source.get(), &audio_source::audio_available, this,
@@ -3187,7 +3716,7 @@ void speech_service::handle_task_timeout() {
         if (m_current_task->speech_mode == speech_mode_t::single_sentence)
             stop_keepalive_current_task();
         if (audio_source_type() == source_t::file ||
-            audio_source_type() == source_t::mic) {
+            audio_source_type() == source_t::mic || batch_running()) {
             cancel(m_current_task->id);
         } else {
             m_current_task.reset();
@@ -3208,7 +3737,9 @@ void speech_service::update_task_state() {
     // 6 = Canceling
 
     auto new_task_state = [&] {
-        if (m_stt_engine && m_stt_engine->stopping()) {
+        if (batch_running()) {
+            return 2;
+        } else if (m_stt_engine && m_stt_engine->stopping()) {
             return 6;
         } else if (m_stt_engine && m_stt_engine->started()) {
             switch (m_stt_engine->speech_detection_status()) {
@@ -3221,13 +3752,10 @@ void speech_service::update_task_state() {
                 case stt_engine::speech_detection_status_t::no_speech:
                     break;
             }
-        } else if (m_player.state() == QMediaPlayer::State::PlayingState &&
+        } else if (m_player.state() == pcm_player::state_t::playing &&
                    m_state == state_t::playing_speech) {
             return 4;
-        } else if (m_player.state() == QMediaPlayer::State::PausedState ||
-                   (m_player.state() == QMediaPlayer::State::StoppedState &&
-                    m_state == state_t::playing_speech && m_current_task &&
-                    m_current_task->paused)) {
+        } else if (m_player.state() == pcm_player::state_t::paused) {
             return 5;
         } else if (m_tts_engine &&
                    m_tts_engine->state() != tts_engine::state_t::idle &&
@@ -3293,7 +3821,7 @@ void speech_service::refresh_status() {
                !models_manager::instance()->has_model_of_role(
                    models_manager::model_role_t::mnt)) {
         new_state = state_t::not_configured;
-    } else if (audio_source_type() == source_t::file) {
+    } else if (audio_source_type() == source_t::file || batch_running()) {
         new_state = state_t::transcribing_file;
     } else if (audio_source_type() == source_t::mic) {
         if (!m_current_task) {
@@ -3563,7 +4091,9 @@ void speech_service::remove_cached_media_files() {
                                          << "*.mp3"
                                          << "*.ogg"
                                          << "*.opus"
-                                         << "*.flac");
+                                         << "*.flac"
+                                         << "ref_voice_*.pt"
+                                         << "mnt_cache.bin*");
         dir.setFilter(QDir::Files);
 
         for (const auto &file : std::as_const(dir).entryList())
@@ -3683,6 +4213,25 @@ int speech_service::SttTranscribeFile(const QString &file, const QString &lang,
     return stt_transcribe_file(file, lang, out_lang, options);
 }
 
+int speech_service::SttTranscribeFiles(const QStringList &files,
+                                       const QString &lang,
+                                       const QString &out_lang,
+                                       const QVariantMap &options) {
+    qDebug() << "[dbus => service] called SttTranscribeFiles:" << files.size()
+             << lang << out_lang;
+    start_keepalive_current_task();
+
+    return stt_transcribe_files(files, lang, out_lang, options);
+}
+
+QVariantList speech_service::SttGetTranscribeFilesResults(int task) {
+    qDebug() << "[dbus => service] called SttGetTranscribeFilesResults:"
+             << task;
+    start_keepalive_current_task();
+
+    return stt_transcribe_files_results(task);
+}
+
 double speech_service::SttGetFileTranscribeProgress(int task) {
     qDebug() << "[dbus => service] called GetFileTranscribeProgress:" << task;
     start_keepalive_current_task();
@@ -3690,6 +4239,13 @@ double speech_service::SttGetFileTranscribeProgress(int task) {
     return stt_transcribe_file_progress(task);
 }
 
+QVariantMap speech_service::SttGetIntermediateText(int task) {
+    qDebug() << "[dbus => service] called SttGetIntermediateText:" << task;
+    start_keepalive_current_task();
+
+    return stt_intermediate_text(task);
+}
+
 int speech_service::KeepAliveService() {
     qDebug() << "[dbus => service] called KeepAliveService";
     m_keepalive_timer.start();
@@ -3793,6 +4349,12 @@ QVariantMap speech_service::FeaturesAvailability() {
     return features_availability();
 }
 
+QString speech_service::Metrics() {
+    qDebug() << "[dbus => service] called Metrics";
+
+    return QString::fromStdString(metrics::instance()->to_json());
+}
+
 int speech_service::Reload() {
     qDebug() << "[dbus => service] called Reload";
     m_keepalive_timer.start();
@@ -10,25 +10,30 @@
 
 #include <QDebug>
 #include <QIODevice>
-#include <QMediaPlayer>
 #include <QObject>
 #include <QString>
+#include <QStringList>
 #include <QTimer>
 #include <QVariantList>
+#include <deque>
 #include <map>
 #include <memory>
+#include <mutex>
 #include <optional>
 #include <queue>
 #include <set>
 #include <string>
+#include <string_view>
 #include <utility>
 #include <vector>
 
 #include "audio_source.h"
 #include "config.h"
 #include "dbus_speech_adaptor.h"
+#include "media_compressor.hpp"
 #include "mnt_engine.hpp"
 #include "models_manager.h"
+#include "pcm_player.h"
 #include "singleton.h"
 #include "stt_engine.hpp"
 #include "tts_engine.hpp"
@@ -130,6 +135,9 @@ class speech_service : public QObject, public singleton<speech_service> {
     Q_INVOKABLE int stt_transcribe_file(const QString &file, QString lang,
                                         QString out_lang,
                                         const QVariantMap &options);
+    Q_INVOKABLE int stt_transcribe_files(const QStringList &files,
+                                         QString lang, QString out_lang,
+                                         const QVariantMap &options);
     Q_INVOKABLE int tts_play_speech(const QString &text, QString lang,
                                     const QVariantMap &options);
     Q_INVOKABLE int tts_pause_speech(int task);
@@ -172,6 +180,8 @@ class speech_service : public QObject, public singleton<speech_service> {
     state_t state() const;
     int current_task_id() const;
     double stt_transcribe_file_progress(int task) const;
+    QVariantList stt_transcribe_files_results(int task) const;
+    QVariantMap stt_intermediate_text(int task);
     double tts_speech_to_file_progress(int task) const;
     double mnt_translate_progress(int task) const;
     QVariantMap mnt_out_langs(QString in_lang) const;
@@ -187,9 +197,15 @@ class speech_service : public QObject, public singleton<speech_service> {
     void stt_transcribe_file_progress_changed(double progress, int task);
     void tts_speech_to_file_progress_changed(double progress, int task);
     void error(speech_service::error_t type);
+    // emitted together with error when error is related to task
+    void task_error(speech_service::error_t type, int task);
     void stt_file_transcribe_finished(int task);
+    void stt_transcribe_files_file_finished(int task, const QString &file,
+                                            const QString &out_file, bool ok);
     void stt_intermediate_text_decoded(const QString &text, const QString &lang,
                                        int task);
+    void stt_intermediate_text_changed(int task, int base_revision, int offset,
+                                       int replaced_size, const QString &text);
     void stt_text_decoded(const QString &text, const QString &lang, int task);
     void tts_play_speech_finished(int task);
     void tts_speech_to_file_finished(const QString &file, int task);
@@ -209,6 +225,9 @@ class speech_service : public QObject, public singleton<speech_service> {
     void stt_engine_error(int task_id);
     void stt_engine_stopped(int task_id);
     void stt_engine_stopping(int task_id);
+    void stt_batch_text_decoded(const QString &text, int task_id);
+    void stt_batch_engine_eof(int task_id);
+    void stt_batch_file_error(speech_service::error_t type, int task_id);
     void tts_engine_error(int task_id);
     void mnt_engine_error(mnt_engine::error_t error_type, int task_id);
     void stt_engine_shutdown();
@@ -228,9 +247,13 @@ class speech_service : public QObject, public singleton<speech_service> {
     void CurrentTaskPropertyChanged(int task);
     void TaskStatePropertyChanged(int speech);
     void SttFileTranscribeFinished(int task);
+    void SttTranscribeFilesFileFinished(int task, const QString &file,
+                                        const QString &out_file, bool ok);
     void SttFileTranscribeProgress(double progress, int task);
     void SttIntermediateTextDecoded(const QString &text, const QString &lang,
                                     int task);
+    void SttIntermediateTextChanged(int task, int base_revision, int offset,
+                                    int replaced_size, const QString &text);
     void SttTextDecoded(const QString &text, const QString &lang, int task);
     void TtsPlaySpeechFinished(int task);
     void TtsSpeechToFileFinished(const QString &file, int task);
@@ -370,11 +393,48 @@ class speech_service : public QObject, public singleton<speech_service> {
     QTimer m_keepalive_current_task_timer;
     QTimer m_features_availability_timer;
     int m_last_intermediate_text_task = INVALID_TASK;
+    // intermediate text as seen by clients of delta signal
+    struct intermediate_text_t {
+        int task = INVALID_TASK;
+        int revision = 0;
+        std::string text;
+        int utf16_size = 0;
+    };
+    intermediate_text_t m_intermediate_text;
+    std::mutex m_intermediate_text_mtx;
+    // files transcribed concurrently in streams, every stream has its own
+    // engine and audio source, engines share one model when possible,
+    // every file has its own task but progress and results are reported
+    // for whole batch
+    struct batch_stream_t {
+        int task = INVALID_TASK;
+        int index = -1;
+        QString text;
+        std::unique_ptr<audio_source> source;
+        std::unique_ptr<stt_engine> engine;
+    };
+    struct batch_t {
+        int id = INVALID_TASK;
+        QStringList files;
+        QVariantMap options;
+        int next_index = 0;
+        double progress = 0.0;
+        QVariantList results;
+        std::vector<std::unique_ptr<batch_stream_t>> streams;
+        bool finished = false;
+    };
+    inline static const unsigned int m_batch_max_streams = 4;
+    // min number of cpu threads used by one stream
+    inline static const unsigned int m_batch_stream_threads = 2;
+    std::optional<batch_t> m_batch;
     std::optional<task_t> m_previous_task;
     std::optional<task_t> m_current_task;
-    QMediaPlayer m_player;
+    pcm_player m_player;
     int m_task_state = 0;
     std::queue<tts_partial_result_t> m_tts_queue;
+    // results passed to player with player segment ids, first one is
+    // currently playing
+    std::deque<std::pair<int, tts_partial_result_t>> m_tts_player_queue;
     QVariantMap m_features_availability;
     bool m_models_changed_handled = false;
 
@@ -403,14 +463,16 @@ class speech_service : public QObject, public singleton<speech_service> {
     void handle_stt_text_decoded(const std::string &text);
     void handle_stt_text_decoded(const QString &text, const QString &model_id,
                                  int task_id);
-    void handle_stt_intermediate_text_decoded(const std::string &text);
+    void handle_stt_intermediate_text_decoded(const std::string &text,
+                                              size_t changed_pos);
     void handle_tts_speech_encoded(const std::string &text,
                                    const std::string &audio_file_path,
                                    tts_engine::audio_format_t format,
                                    double progress, bool last);
     void handle_tts_speech_encoded(tts_partial_result_t result);
     void handle_speech_to_file(const tts_partial_result_t &result);
-    void handle_player_state_changed(QMediaPlayer::State new_state);
+    void handle_player_state_changed();
+    void handle_player_segment_started(int id);
     void handle_audio_available();
     void handle_stt_engine_state_changed(
         stt_engine::speech_detection_status_t status, int task_id);
@@ -426,8 +488,25 @@ class speech_service : public QObject, public singleton<speech_service> {
     QString restart_mnt_engine(const QString &model_or_lang_id,
                                const QString &out_lang_id,
                                const QVariantMap &options);
-    void restart_audio_source(const QString &source_file = {},
-                              int stream_index = -1);
+    void restart_audio_source(
+        const QString &source_file = {}, int stream_index = -1,
+        media_compressor::clip_info_t clip_info = {});
+    static stt_engine::config_t make_stt_config(
+        const model_config_t &model_config, speech_mode_t speech_mode,
+        const QString &out_lang_id, const QVariantMap &options);
+    inline bool batch_running() const { return m_batch && !m_batch->finished; }
+    batch_stream_t *batch_stream(int task_id) const;
+    stt_engine::callbacks_t batch_stream_callbacks(batch_stream_t *stream);
+    bool start_batch_stream(batch_stream_t &stream);
+    void continue_batch_stream(batch_stream_t &stream);
+    void finish_batch_file(batch_stream_t &stream, bool ok);
+    void stop_batch();
+    void update_batch_progress();
+    void handle_batch_audio_available(int task_id);
+    void handle_batch_text_decoded(const QString &text, int task_id);
+    void handle_batch_engine_eof(int task_id);
+    void handle_batch_file_error(speech_service::error_t type, int task_id);
+    static QString batch_out_file(const QString &file, bool subrip);
     void stop_stt();
     source_t audio_source_type() const;
     void set_progress(double progress);
@@ -510,7 +589,13 @@ class speech_service : public QObject, public singleton<speech_service> {
     Q_INVOKABLE int SttTranscribeFile(const QString &file, const QString &lang,
                                       const QString &out_lang,
                                       const QVariantMap &options);
+    Q_INVOKABLE int SttTranscribeFiles(const QStringList &files,
+                                       const QString &lang,
+                                       const QString &out_lang,
+                                       const QVariantMap &options);
+    Q_INVOKABLE QVariantList SttGetTranscribeFilesResults(int task);
     Q_INVOKABLE double SttGetFileTranscribeProgress(int task);
+    Q_INVOKABLE QVariantMap SttGetIntermediateText(int task);
     Q_INVOKABLE int TtsPlaySpeech(const QString &text, const QString &lang);
     Q_INVOKABLE int TtsPlaySpeech2(const QString &text, const QString &lang,
                                    const QVariantMap &options);
@@ -527,6 +612,7 @@ class speech_service : public QObject, public singleton<speech_service> {
                                   const QVariantMap &options);
     Q_INVOKABLE QVariantMap MntGetOutLangs(const QString &lang);
     Q_INVOKABLE QVariantMap FeaturesAvailability();
+    Q_INVOKABLE QString Metrics();
 };
 
 Q_DECLARE_METATYPE(speech_service::tts_partial_result_t)
@@ -8,14 +8,18 @@
 #include "stt_engine.hpp"
 
 #include <algorithm>
+#include <cctype>
 #include <cmath>
 #include <cstring>
 #include <fstream>
 #include <iterator>
 #include <numeric>
 #include <sstream>
+#include <vector>
 
+#include "cpu_tools.hpp"
 #include "logger.hpp"
+#include "metrics.hpp"
 
 using namespace std::chrono_literals;
 
@@ -182,7 +186,8 @@ std::ostream& operator<<(std::ostream& os,
                          const stt_engine::sub_config_t& sub_config) {
     os << "min-segment-dur=" << sub_config.min_segment_dur
        << ", min-line-length=" << sub_config.min_line_length
-       << ", max-line-length=" << sub_config.max_line_length;
+       << ", max-line-length=" << sub_config.max_line_length
+       << ", time-offset=" << sub_config.time_offset_ms;
 
     return os;
 }
@@ -205,13 +210,19 @@ std::ostream& operator<<(std::ostream& os, const stt_engine::config_t& config) {
        << ", text-format=" << config.text_format
        << ", options=" << config.options << ", use-gpu=" << config.use_gpu
        << ", gpu-device=[" << config.gpu_device << "]"
-       << ", sub-config=[" << config.sub_config << "]";
+       << ", sub-config=[" << config.sub_config << "]"
+       << ", partial-latency=" << config.partial_latency_ms
+       << ", max-threads=" << config.max_threads;
 
     return os;
 }
 
 stt_engine::stt_engine(config_t config, callbacks_t call_backs)
-    : m_config{std::move(config)}, m_call_backs{std::move(call_backs)} {}
+    : m_config{std::move(config)}, m_call_backs{std::move(call_backs)} {
+    partial_scheduler::config_t partial_config;
+    partial_config.latency_target_ms = m_config.partial_latency_ms;
+    m_partial_scheduler = partial_scheduler{partial_config};
+}
 
 stt_engine::~stt_engine() { LOGD("stt dtor"); }
 
@@ -258,6 +269,7 @@ void stt_engine::request_stop() {
     stop_processing_impl();
 
     m_processing_cv.notify_all();
+    m_decoding_cv.notify_all();
 
     if (m_call_backs.stopping) m_call_backs.stopping();
 }
@@ -272,7 +284,10 @@ void stt_engine::stop() {
 
     m_processing_cv.notify_all();
     if (m_processing_thread.joinable()) m_processing_thread.join();
-    m_config.speech_started = false;
+    {
+        std::lock_guard lock{m_status_mtx};
+        m_config.speech_started = false;
+    }
     set_speech_detection_status(speech_detection_status_t::no_speech);
     set_state(state_t::idle);
 
@@ -284,11 +299,21 @@ void stt_engine::process() {
 
     m_thread_exit_requested = false;
 
+    // without decoding thread, speech is decoded in processing thread
+    cpu_tools::set_thread_policy(m_use_decoding_thread
+                                     ? cpu_tools::thread_role_t::audio
+                                     : cpu_tools::thread_role_t::decode);
+
     try {
         set_state(state_t::initializing);
-        start_processing_impl();
+        {
+            metrics::scoped_timer timer{metrics::stage_t::model_load};
+            start_processing_impl();
+        }
         set_state(state_t::idle);
 
+        if (m_use_decoding_thread) start_decoding();
+
         while (true) {
             std::unique_lock lock{m_processing_mtx};
 
@@ -296,7 +321,9 @@ void stt_engine::process() {
 
             if (m_restart_requested) {
                 m_restart_requested = false;
-                flush(flush_t::restart);
+                m_segment_time_discarded_before = 0;
+                m_segment_time_discarded_after = 0;
+                run_after_decoding([this] { flush(flush_t::restart); });
             }
 
             if (process_buff() == samples_process_result_t::wait_for_samples &&
@@ -304,10 +331,16 @@ void stt_engine::process() {
                 m_processing_cv.wait(lock);
         }
 
+        stop_decoding();
+
+        if (m_decoding_error) std::rethrow_exception(m_decoding_error);
+
         flush(flush_t::exit);
     } catch (const std::runtime_error& e) {
         LOGE("stt processing error: " << e.what());
 
+        stop_decoding();
+
         if (m_call_backs.error) m_call_backs.error();
     }
 
@@ -318,6 +351,125 @@ void stt_engine::process() {
     if (m_call_backs.stopped) m_call_backs.stopped();
 }
 
+void stt_engine::start_decoding() {
+    {
+        std::lock_guard lock{m_decoding_mtx};
+        m_decode_queue = {};
+        m_decoding_busy = false;
+        m_decoding_exit_requested = false;
+        m_decoding_error = nullptr;
+    }
+
+    m_decoding_thread = std::thread{&stt_engine::decode, this};
+}
+
+void stt_engine::stop_decoding() {
+    if (!m_decoding_thread.joinable()) return;
+
+    {
+        std::lock_guard lock{m_decoding_mtx};
+        // not started tasks are dropped
+        m_decode_queue = {};
+        m_decoding_exit_requested = true;
+    }
+
+    m_decoding_cv.notify_all();
+    m_decoding_thread.join();
+}
+
+void stt_engine::decode() {
+    LOGD("stt decoding started");
+
+    cpu_tools::set_thread_policy(cpu_tools::thread_role_t::decode);
+
+    while (true) {
+        decode_task_t task;
+
+        {
+            std::unique_lock lock{m_decoding_mtx};
+            m_decoding_cv.wait(lock, [this] {
+                return m_decoding_exit_requested || !m_decode_queue.empty();
+            });
+
+            if (m_decoding_exit_requested) break;
+
+            task = std::move(m_decode_queue.front());
+            m_decode_queue.pop();
+            m_decoding_busy = true;
+        }
+
+        // processing thread may wait for free slot in the queue
+        m_decoding_cv.notify_all();
+
+        try {
+            task();
+        } catch (const std::runtime_error& e) {
+            LOGE("stt decoding error: " << e.what());
+
+            {
+                std::lock_guard lock{m_decoding_mtx};
+                m_decoding_error = std::current_exception();
+                m_decoding_busy = false;
+            }
+
+            // error is reported by processing thread
+            m_thread_exit_requested = true;
+            m_processing_cv.notify_all();
+            break;
+        }
+
+        {
+            std::lock_guard lock{m_decoding_mtx};
+            m_decoding_busy = false;
+        }
+    }
+
+    LOGD("stt decoding ended");
+}
+
+void stt_engine::push_decode_task(decode_task_t task) {
+    if (!m_decoding_thread.joinable()) {
+        task();
+        return;
+    }
+
+    {
+        std::unique_lock lock{m_decoding_mtx};
+
+        // when decoding is too slow, processing waits for the decoder
+        m_decoding_cv.wait(lock, [this] {
+            return m_thread_exit_requested || m_decoding_exit_requested ||
+                   m_decode_queue.size() < m_decode_queue_max_size;
+        });
+
+        if (m_thread_exit_requested || m_decoding_exit_requested) return;
+
+        m_decode_queue.push(std::move(task));
+    }
+
+    m_decoding_cv.notify_all();
+}
+
+void stt_engine::run_after_decoding(decode_task_t task) {
+    if (m_decoding_thread.joinable()) {
+        std::lock_guard lock{m_decoding_mtx};
+
+        if (m_decoding_busy || !m_decode_queue.empty()) {
+            // queue limit does not apply, tasks like flush are cheap
+            m_decode_queue.push(std::move(task));
+            m_decoding_cv.notify_all();
+            return;
+        }
+    }
+
+    // decoder is idle, so task can be executed right away
+    task();
+}
+
+bool stt_engine::on_decoding_thread() const {
+    return m_decoding_thread.get_id() == std::this_thread::get_id();
+}
+
 bool stt_engine::lock_buf(lock_type_t desired_lock) {
     lock_type_t expected_lock = lock_type_t::free;
     return m_in_buf.lock.compare_exchange_strong(expected_lock, desired_lock);
@@ -349,6 +501,8 @@ std::pair<char*, size_t> stt_engine::borrow_buf() {
         return c_buf;
     }
 
+    m_in_buf.borrow_time = std::chrono::steady_clock::now();
+
     c_buf.first = reinterpret_cast<char*>(&m_in_buf.buf.at(m_in_buf.size));
     c_buf.second = (m_in_buf.buf.size() - m_in_buf.size) *
                    sizeof(in_buf_t::buf_t::value_type);
@@ -363,11 +517,18 @@ void stt_engine::return_buf(const char* c_buf, size_t size, bool sof,
     LOGT("lock buff returned: sof=" << sof << ", eof=" << eof
                                     << ", buf size=" << size);
 
+    metrics::instance()->record_since(
+        metrics::stage_t::audio_capture, m_in_buf.borrow_time,
+        metrics::samples_to_ms(size / sizeof(in_buf_t::buf_t::value_type),
+                               m_sample_rate));
+
     m_in_buf.size =
         (c_buf - reinterpret_cast<char*>(m_in_buf.buf.data()) + size) /
         sizeof(in_buf_t::buf_t::value_type);
     m_in_buf.eof = eof;
     if (sof) m_in_buf.sof = sof;
+    if (!m_in_buf.ready_time && (m_in_buf.eof || m_in_buf.full()))
+        m_in_buf.ready_time = std::chrono::steady_clock::now();
 
     free_buf();
     m_processing_cv.notify_one();
@@ -388,6 +549,19 @@ bool stt_engine::lock_buff_for_processing() {
         return false;
     }
 
+    m_in_buf_lag_ms = 0;
+
+    if (m_in_buf.ready_time) {
+        m_in_buf_lag_ms =
+            std::chrono::duration_cast<std::chrono::milliseconds>(
+                std::chrono::steady_clock::now() - *m_in_buf.ready_time)
+                .count();
+        metrics::instance()->record_since(
+            metrics::stage_t::input_wait, *m_in_buf.ready_time,
+            metrics::samples_to_ms(m_in_buf.size, m_sample_rate));
+        m_in_buf.ready_time.reset();
+    }
+
     return true;
 }
 
@@ -395,9 +569,10 @@ void stt_engine::reset_in_processing() {
     LOGD("reset in processing");
 
     m_in_buf.clear();
-    m_start_time.reset();
+    reset_sentence_timer();
     m_vad.reset();
-    m_intermediate_text.reset();
+    reset_intermediate_text();
+    m_partial_scheduler.reset();
     set_speech_detection_status(speech_detection_status_t::no_speech);
 
     reset_impl();
@@ -407,43 +582,106 @@ stt_engine::samples_process_result_t stt_engine::process_buff() {
     return samples_process_result_t::wait_for_samples;
 }
 
-std::string stt_engine::merge_texts(const std::string& old_text,
-                                    std::string&& new_text) {
-    if (new_text.empty()) return old_text;
+// Returns length of the longest suffix of old_text that is also a prefix of
+// new_text. Only the last m_merge_window_size characters are compared, so
+// the cost does not depend on the length of the whole transcript.
+size_t stt_engine::find_overlap(std::string_view old_text,
+                                std::string_view new_text) {
+    auto size =
+        std::min({old_text.size(), new_text.size(), m_merge_window_size});
+    if (size == 0) return 0;
+
+    auto pattern = new_text.substr(0, size);
+    auto tail = old_text.substr(old_text.size() - size);
+
+    // KMP failure function of the pattern
+    std::vector<size_t> fail(size, 0);
+    for (size_t i = 1, k = 0; i < size; ++i) {
+        while (k > 0 && pattern[i] != pattern[k]) k = fail[k - 1];
+        if (pattern[i] == pattern[k]) ++k;
+        fail[i] = k;
+    }
 
-    if (old_text.empty()) return std::move(new_text);
+    // state after consuming the tail is the longest matched prefix
+    size_t k = 0;
+    for (auto c : tail) {
+        while (k > 0 && (k == size || c != pattern[k])) k = fail[k - 1];
+        if (c == pattern[k]) ++k;
+    }
 
-    size_t i = 1, idx = 0;
-    auto l = std::min(old_text.size(), new_text.size());
-    for (; i <= l; ++i) {
-        auto beg = old_text.cend();
-        std::advance(beg, 0 - i);
+    return k;
+}
 
-        auto end = new_text.cbegin();
-        std::advance(end, i);
+bool stt_engine::merge_texts(std::string& text, std::string_view new_text) {
+    if (new_text.empty()) return false;
 
-        if (std::equal(beg, old_text.cend(), new_text.cbegin(), end)) idx = i;
+    if (text.empty()) {
+        text.assign(new_text);
+        return true;
     }
 
-    if (idx > 0) {
-        new_text = new_text.substr(idx);
-        ltrim(new_text);
-    }
+    new_text.remove_prefix(find_overlap(text, new_text));
+
+    auto pos = std::find_if(new_text.cbegin(), new_text.cend(),
+                            [](unsigned char ch) { return !std::isspace(ch); });
+    new_text.remove_prefix(std::distance(new_text.cbegin(), pos));
+
+    if (new_text.empty()) return false;
+
+    text.push_back(' ');
+    text.append(new_text);
+
+    return true;
+}
 
-    if (new_text.empty()) return old_text;
-    return old_text + " " + new_text;
+void stt_engine::append_intermediate_text(std::string_view text) {
+    bool changed = !m_intermediate_text.has_value();
+
+    if (!m_intermediate_text) m_intermediate_text.emplace();
+
+    auto old_size = m_intermediate_text->size();
+
+    if (merge_texts(*m_intermediate_text, text)) changed = true;
+
+    if (changed) notify_intermediate_text(old_size);
 }
 
 void stt_engine::set_intermediate_text(const std::string& text) {
     if (m_intermediate_text != text) {
-        m_intermediate_text = text;
-        if (m_intermediate_text->empty() ||
-            m_intermediate_text->size() >= m_min_text_size) {
-            m_call_backs.intermediate_text_decoded(m_intermediate_text.value());
+        size_t pos = 0;
+        if (m_intermediate_text) {
+            const auto& old_text = *m_intermediate_text;
+            auto l = std::min(old_text.size(), text.size());
+            while (pos < l && old_text[pos] == text[pos]) ++pos;
+            // do not split multi-byte utf-8 character
+            while (pos > 0 && pos < text.size() &&
+                   (static_cast<unsigned char>(text[pos]) & 0xC0) == 0x80)
+                --pos;
         }
+
+        m_intermediate_text = text;
+
+        notify_intermediate_text(pos);
     }
 }
 
+void stt_engine::notify_intermediate_text(size_t changed_pos) {
+    m_intermediate_text_changed_pos =
+        std::min(m_intermediate_text_changed_pos, changed_pos);
+
+    if (m_intermediate_text->empty() ||
+        m_intermediate_text->size() >= m_min_text_size) {
+        m_call_backs.intermediate_text_decoded(m_intermediate_text.value(),
+                                               m_intermediate_text_changed_pos);
+        m_intermediate_text_changed_pos = m_intermediate_text->size();
+    }
+}
+
+void stt_engine::reset_intermediate_text() {
+    m_intermediate_text.reset();
+    m_intermediate_text_changed_pos = 0;
+}
+
 stt_engine::speech_detection_status_t stt_engine::speech_detection_status()
     const {
     switch (m_state) {
@@ -463,6 +701,8 @@ stt_engine::speech_detection_status_t stt_engine::speech_detection_status()
 }
 
 void stt_engine::set_state(state_t new_state) {
+    std::lock_guard lock{m_status_mtx};
+
     if (m_state != new_state) {
         auto old_speech_status = speech_detection_status();
 
@@ -484,8 +724,11 @@ void stt_engine::set_state(state_t new_state) {
 void stt_engine::flush(flush_t type) {
     LOGD("flush: " << type);
 
+    // with decoding thread, speech status in automatic mode is updated only
+    // by processing thread, speech may already be detected in the next segment
     if (m_config.speech_mode == speech_mode_t::automatic) {
-        set_speech_detection_status(speech_detection_status_t::no_speech);
+        if (!on_decoding_thread())
+            set_speech_detection_status(speech_detection_status_t::no_speech);
     } else if (type != flush_t::restart &&
                m_config.speech_mode == speech_mode_t::manual) {
         set_speech_started(false);
@@ -504,13 +747,17 @@ void stt_engine::flush(flush_t type) {
         set_intermediate_text("");
     }
 
-    m_intermediate_text.reset();
+    reset_intermediate_text();
 
     if (type == flush_t::eof) {
         m_call_backs.eof();
     }
 
-    if (type == flush_t::restart) reset_segment_counters();
+    if (type == flush_t::restart) {
+        // discarded time is reset by processing thread
+        m_segment_offset = 0;
+        m_segment_time_offset = m_config.sub_config.time_offset_ms;
+    }
 }
 
 void stt_engine::set_speech_mode(speech_mode_t mode) {
@@ -523,21 +770,28 @@ void stt_engine::set_speech_mode(speech_mode_t mode) {
 }
 
 void stt_engine::set_speech_started(bool value) {
-    if (m_config.speech_started != value) {
+    {
+        std::lock_guard lock{m_status_mtx};
+
+        if (m_config.speech_started == value) return;
+
         LOGD("speech started: " << m_config.speech_started << " => " << value);
 
         m_config.speech_started = value;
         m_start_time.reset();
-        if (m_config.speech_mode == speech_mode_t::manual ||
-            m_config.speech_mode == speech_mode_t::single_sentence) {
-            set_speech_detection_status(
-                value ? speech_detection_status_t::speech_detected
-                      : speech_detection_status_t::no_speech);
-        }
+    }
+
+    if (m_config.speech_mode == speech_mode_t::manual ||
+        m_config.speech_mode == speech_mode_t::single_sentence) {
+        set_speech_detection_status(
+            value ? speech_detection_status_t::speech_detected
+                  : speech_detection_status_t::no_speech);
     }
 }
 
 void stt_engine::set_speech_detection_status(speech_detection_status_t status) {
+    std::lock_guard lock{m_status_mtx};
+
     if (m_speech_detection_status == status) return;
 
     auto old_speech_status = speech_detection_status();
@@ -568,22 +822,33 @@ void stt_engine::rtrim(std::string& s) {
 }
 
 bool stt_engine::sentence_timer_timed_out() {
+    std::lock_guard lock{m_status_mtx};
+
     if (m_start_time) {
         if (std::chrono::steady_clock::now() - *m_start_time >= m_timeout) {
             return true;
         }
     } else {
-        restart_sentence_timer();
+        LOGT("staring sentence timer");
+        m_start_time = std::chrono::steady_clock::now();
     }
 
     return false;
 }
 
 void stt_engine::restart_sentence_timer() {
+    std::lock_guard lock{m_status_mtx};
+
     LOGT("staring sentence timer");
     m_start_time = std::chrono::steady_clock::now();
 }
 
+void stt_engine::reset_sentence_timer() {
+    std::lock_guard lock{m_status_mtx};
+
+    m_start_time.reset();
+}
+
 void stt_engine::create_punctuator() {
     if (m_punctuator || m_config.model_files.ttt_model_file.empty()) return;
 
@@ -598,9 +863,38 @@ void stt_engine::create_punctuator() {
     }
 }
 
+std::string stt_engine::restore_punctuation(const std::string& text,
+                                            bool eof) {
+    if (!m_punctuator) return text;
+
+    // intermediate results must not block processing
+    if (!eof) return m_punctuator->process_async(text);
+
+    auto result = m_punctuator->process_incremental(text);
+    m_punctuator->reset();
+
+    return result;
+}
+
 void stt_engine::reset_segment_counters() {
     m_segment_offset = 0;
-    m_segment_time_offset = 0;
+    m_segment_time_offset = m_config.sub_config.time_offset_ms;
     m_segment_time_discarded_before = 0;
     m_segment_time_discarded_after = 0;
 }
+
+bool stt_engine::partial_due(size_t samples) {
+    auto due = m_partial_scheduler.feed(
+        metrics::samples_to_ms(samples, m_sample_rate), m_in_buf_lag_ms);
+
+    // final decoding is triggered only when partial text is not empty, so
+    // partials are not skipped until some text is decoded
+    return due || !m_intermediate_text || m_intermediate_text->empty();
+}
+
+void stt_engine::partial_decoded(std::chrono::steady_clock::time_point start) {
+    m_partial_scheduler.partial_decoded(
+        std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::steady_clock::now() - start)
+            .count());
+}
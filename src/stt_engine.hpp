@@ -13,16 +13,20 @@
 #include <chrono>
 #include <condition_variable>
 #include <cstdint>
+#include <exception>
 #include <functional>
 #include <memory>
 #include <mutex>
 #include <optional>
 #include <ostream>
+#include <queue>
 #include <string>
+#include <string_view>
 #include <thread>
 #include <utility>
 
 #include "denoiser.hpp"
+#include "partial_scheduler.hpp"
 #include "punctuator.hpp"
 #include "vad.hpp"
 
@@ -78,13 +82,18 @@ class stt_engine {
         size_t min_segment_dur = 0;
         size_t min_line_length = 0;
         size_t max_line_length = 0;
+        // added to times of all segments
+        size_t time_offset_ms = 0;
     };
     friend std::ostream& operator<<(std::ostream& os,
                                     const sub_config_t& sub_config);
 
     struct callbacks_t {
         std::function<void(const std::string& text)> text_decoded;
-        std::function<void(const std::string& text)> intermediate_text_decoded;
+        // changed_pos: position in bytes from which text differs from
+        // previously reported intermediate text
+        std::function<void(const std::string& text, size_t changed_pos)>
+            intermediate_text_decoded;
         std::function<void(speech_detection_status_t status)>
             speech_detection_status_changed;
         std::function<void()> sentence_timeout;
@@ -124,6 +133,10 @@ class stt_engine {
         std::string options;
         gpu_device_t gpu_device;
         sub_config_t sub_config;
+        // desired interval between partial results in streaming engines
+        size_t partial_latency_ms = 500;
+        // limit of cpu threads used by engine, 0 means no limit
+        size_t max_threads = 0;
         inline bool has_option(char c) const {
             return options.find(c) != std::string::npos;
         }
@@ -144,7 +157,10 @@ class stt_engine {
     void set_speech_mode(speech_mode_t mode);
     inline auto speech_mode() const { return m_config.speech_mode; }
     void set_speech_started(bool value);
-    inline auto speech_status() const { return m_config.speech_started; }
+    inline auto speech_status() const {
+        std::lock_guard lock{m_status_mtx};
+        return m_config.speech_started;
+    }
     inline const model_files_t& model_files() const {
         return m_config.model_files;
     }
@@ -159,7 +175,11 @@ class stt_engine {
     inline void set_sub_config(sub_config_t value) {
         m_config.sub_config = value;
     }
+    inline void set_max_threads(size_t value) { m_config.max_threads = value; }
     inline bool stop_requested() const { return m_thread_exit_requested; }
+    // true when engines of the same model decode concurrently with one
+    // copy of the model in memory
+    virtual bool shares_model() const { return false; }
 
    protected:
     enum class lock_type_t { free, processed, borrowed };
@@ -179,7 +199,11 @@ class stt_engine {
     inline static const size_t m_in_buf_max_size = 24000;
     inline static const size_t m_speech_max_size = m_sample_rate * 60;  // 60s
     inline static const unsigned int m_min_text_size = 4;
+    // max size of text overlap detected when merging decoded texts
+    inline static const size_t m_merge_window_size = 1024;
     inline static const auto m_timeout = 10s;
+    // max number of speech segments waiting for decoding
+    inline static const size_t m_decode_queue_max_size = 4;
 
     struct in_buf_t {
         using buf_t = std::array<int16_t, m_in_buf_max_size>;
@@ -188,11 +212,16 @@ class stt_engine {
         bool sof = true;
         bool eof = false;
         std::atomic<lock_type_t> lock = lock_type_t::free;
+        // when buf was borrowed by audio source
+        std::chrono::steady_clock::time_point borrow_time;
+        // when buf became ready for processing
+        std::optional<std::chrono::steady_clock::time_point> ready_time;
         [[nodiscard]] inline bool full() const { return size == buf.size(); }
         inline void clear() {
             size = 0;
             sof = false;
             eof = false;
+            ready_time.reset();
         }
     };
 
@@ -202,26 +231,47 @@ class stt_engine {
     std::mutex m_processing_mtx;
     std::condition_variable m_processing_cv;
     bool m_thread_exit_requested = false;
+    // Optional decoding stage. When enabled, processing thread only does
+    // denoising and VAD and pushes decode tasks to the decoding thread, so
+    // in-buf is released and speech detection is updated during long
+    // decodes. Tasks are executed in order.
+    using decode_task_t = std::function<void()>;
+    bool m_use_decoding_thread = false;
+    std::thread m_decoding_thread;
+    std::mutex m_decoding_mtx;
+    std::condition_variable m_decoding_cv;
+    std::queue<decode_task_t> m_decode_queue;
+    bool m_decoding_busy = false;
+    bool m_decoding_exit_requested = false;
+    std::exception_ptr m_decoding_error;
+    // guards speech started flag and sentence timer, both are changed by
+    // processing, decoding and caller threads
+    mutable std::mutex m_status_mtx;
     in_buf_t m_in_buf;
     std::optional<std::string> m_intermediate_text;
+    size_t m_intermediate_text_changed_pos = 0;
     vad m_vad;
     denoiser m_denoiser{16000, denoiser::task_flags::task_denoise |
                                    denoiser::task_flags::task_normalize};
-    speech_detection_status_t m_speech_detection_status =
+    std::atomic<speech_detection_status_t> m_speech_detection_status =
         speech_detection_status_t::no_speech;
     bool m_restart_requested = false;
     std::optional<std::chrono::steady_clock::time_point> m_start_time;
-    state_t m_state = state_t::idle;
+    std::atomic<state_t> m_state = state_t::idle;
     std::optional<punctuator> m_punctuator;
     unsigned int m_segment_offset = 0;
     size_t m_segment_time_offset = 0;
     size_t m_segment_time_discarded_before = 0;
     size_t m_segment_time_discarded_after = 0;
+    partial_scheduler m_partial_scheduler;
+    // how long last processed in-buf was waiting for processing
+    size_t m_in_buf_lag_ms = 0;
 
     static void ltrim(std::string& s);
     static void rtrim(std::string& s);
-    static std::string merge_texts(const std::string& old_text,
-                                   std::string&& new_text);
+    static size_t find_overlap(std::string_view old_text,
+                               std::string_view new_text);
+    static bool merge_texts(std::string& text, std::string_view new_text);
     virtual samples_process_result_t process_buff();
     virtual void reset_impl() = 0;
     virtual void stop_processing_impl();
@@ -233,13 +283,26 @@ class stt_engine {
     void free_buf();
     void set_speech_detection_status(speech_detection_status_t status);
     void set_intermediate_text(const std::string& text);
+    void append_intermediate_text(std::string_view text);
+    void reset_intermediate_text();
+    void notify_intermediate_text(size_t changed_pos);
     void set_state(state_t new_state);
     void reset_in_processing();
     void process();
+    void decode();
+    void start_decoding();
+    void stop_decoding();
+    void push_decode_task(decode_task_t task);
+    void run_after_decoding(decode_task_t task);
+    bool on_decoding_thread() const;
     bool sentence_timer_timed_out();
     void restart_sentence_timer();
+    void reset_sentence_timer();
     void create_punctuator();
+    std::string restore_punctuation(const std::string& text, bool eof);
     void reset_segment_counters();
+    bool partial_due(size_t samples);
+    void partial_decoded(std::chrono::steady_clock::time_point start);
 };
 
 #endif  // STT_ENGINE_H
@@ -18,7 +18,9 @@
 #include <cctype>
 #include <cmath>
 #include <cstdio>
+#include <cstring>
 #include <fstream>
+#include <iterator>
 #include <locale>
 
 #ifdef ARCH_X86_64
@@ -27,6 +29,7 @@
 
 #include "logger.hpp"
 #include "media_compressor.hpp"
+#include "metrics.hpp"
 
 static std::string file_ext_for_format(tts_engine::audio_format_t format) {
     switch (format) {
@@ -180,11 +183,7 @@ tts_engine::tts_engine(config_t config, callbacks_t call_backs)
       m_call_backs{std::move(call_backs)},
       m_text_processor{config.use_gpu ? config.gpu_device.id : -1} {}
 
-tts_engine::~tts_engine() {
-    LOGD("tts dtor");
-
-    if (!m_ref_voice_wav_file.empty()) unlink(m_ref_voice_wav_file.c_str());
-}
+tts_engine::~tts_engine() { LOGD("tts dtor"); }
 
 void tts_engine::start() {
     LOGD("tts start");
@@ -283,6 +282,7 @@ void tts_engine::set_speech_speed(unsigned int speech_speed) {
 void tts_engine::set_ref_voice_file(std::string ref_voice_file) {
     m_config.ref_voice_file.assign(std::move(ref_voice_file));
     m_ref_voice_wav_file.clear();
+    m_ref_voice_hash.reset();
 }
 
 void tts_engine::set_state(state_t new_state) {
@@ -551,6 +551,8 @@ void tts_engine::apply_speed([[maybe_unused]] const std::string& file) const {
         m_config.speech_speed != 10) {
         auto speech_speed = 20 - (m_config.speech_speed - 1);
 
+        metrics::scoped_timer timer{metrics::stage_t::tts_stretch};
+
         if (stretch(file, tmp_file, static_cast<double>(speech_speed) / 10.0,
                     1.0)) {
             unlink(file.c_str());
@@ -578,7 +580,10 @@ void tts_engine::process() {
         if (!model_created()) {
             set_state(state_t::initializing);
 
-            create_model();
+            {
+                metrics::scoped_timer timer{metrics::stage_t::model_load};
+                create_model();
+            }
 
             if (!model_created()) {
                 set_state(state_t::error);
@@ -591,10 +596,9 @@ void tts_engine::process() {
         if (m_restart_requested) {
             m_restart_requested = false;
 
-            if (!m_ref_voice_wav_file.empty()) {
-                unlink(m_ref_voice_wav_file.c_str());
-                m_ref_voice_wav_file.clear();
-            }
+            // ref voice file could be overwritten
+            m_ref_voice_wav_file.clear();
+            m_ref_voice_hash.reset();
         }
 
         setup_ref_voice();
@@ -630,6 +634,8 @@ void tts_engine::process() {
 
             auto output_file = path_to_output_file(task.text);
 
+            std::optional<size_t> speech_duration;
+
             if (!file_exists(output_file)) {
                 auto new_text = m_text_processor.preprocess(
                     /*text=*/task.text, /*options=*/m_config.options,
@@ -643,7 +649,11 @@ void tts_engine::process() {
                         ? output_file
                         : output_file + ".wav";
 
+                metrics::scoped_timer synth_timer{metrics::stage_t::tts_synth,
+                                                  new_text.size()};
+
                 if (!encode_speech_impl(new_text, output_file_wav)) {
+                    synth_timer.cancel();
                     unlink(output_file.c_str());
                     LOGE("speech encoding error");
                     if (m_call_backs.speech_encoded) {
@@ -654,9 +664,18 @@ void tts_engine::process() {
                     continue;
                 }
 
+                synth_timer.stop();
+
                 if (!model_supports_speed()) apply_speed(output_file_wav);
 
+                // new speech doesn't need to be probed to get duration
+                if (task.t1 != 0)
+                    speech_duration = wav_duration(output_file_wav);
+
                 if (m_config.audio_format != audio_format_t::wav) {
+                    metrics::scoped_timer compress_timer{
+                        metrics::stage_t::tts_compress};
+
                     media_compressor{}.compress_to_file(
                         {output_file_wav}, output_file,
                         compressor_format_from_format(m_config.audio_format),
@@ -709,7 +728,9 @@ void tts_engine::process() {
                     LOGW("speech delay: " << speech_time - task.t0);
                 }
 
-                speech_time += media_compressor{}.duration(output_file);
+                speech_time += speech_duration
+                                   ? *speech_duration
+                                   : media_compressor{}.duration(output_file);
             }
 
             if (is_shutdown()) break;
@@ -742,21 +763,46 @@ void tts_engine::make_silence_wav_file(size_t duration_msec,
     wav_file.write(silence.data(), silence.size());
 }
 
+static std::optional<size_t> file_content_hash(const std::string& file_path) {
+    std::ifstream file{file_path, std::ios::binary};
+    if (!file) return std::nullopt;
+
+    std::string data{std::istreambuf_iterator<char>{file},
+                     std::istreambuf_iterator<char>{}};
+
+    return std::hash<std::string>{}(data);
+}
+
+std::string tts_engine::ref_voice_cache_file(const std::string& suffix) const {
+    return fmt::format("{}/ref_voice_{}{}", m_config.cache_dir,
+                       m_ref_voice_hash.value_or(0), suffix);
+}
+
 void tts_engine::setup_ref_voice() {
-    if (m_config.ref_voice_file.empty()) return;
+    if (m_config.ref_voice_file.empty() || !m_ref_voice_wav_file.empty())
+        return;
+
+    // data derived from ref voice is cached by content, so the same voice is
+    // decoded only once even when it is selected from other file
+    m_ref_voice_hash = file_content_hash(m_config.ref_voice_file);
+    if (!m_ref_voice_hash) {
+        LOGE("failed to read ref voice file: " << m_config.ref_voice_file);
+        return;
+    }
 
-    auto hash = std::hash<std::string>{}(m_config.ref_voice_file);
+    auto wav_file = ref_voice_cache_file(".wav");
 
-    m_ref_voice_wav_file =
-        m_config.cache_dir + "/" + std::to_string(hash) + ".wav";
+    if (!file_exists(wav_file)) {
+        LOGD("decoding ref voice: " << wav_file);
 
-    if (!file_exists(m_ref_voice_wav_file)) {
         media_compressor{}.decompress_to_file(
-            {m_config.ref_voice_file}, m_ref_voice_wav_file,
-            {media_compressor::quality_t::vbr_medium, /*mono=*/false,
+            {m_config.ref_voice_file}, wav_file,
+            {media_compressor::quality_t::vbr_medium, /*mono=*/true,
              /*sample_rate_16=*/false,
              /*stream=*/{}});
     }
+
+    m_ref_voice_wav_file = std::move(wav_file);
 }
 
 // borrowed from:
@@ -782,6 +828,37 @@ tts_engine::wav_header tts_engine::read_wav_header(std::ifstream& wav_file) {
     return header;
 }
 
+std::optional<size_t> tts_engine::wav_duration(
+    const std::string& wav_file_path) {
+    std::ifstream wav_file{wav_file_path, std::ios::binary | std::ios::ate};
+    if (!wav_file) return std::nullopt;
+
+    auto file_size = static_cast<size_t>(wav_file.tellg());
+    if (file_size < sizeof(wav_header)) return std::nullopt;
+
+    wav_file.seekg(0, std::ios::beg);
+
+    wav_header header;
+    if (!wav_file.read(reinterpret_cast<char*>(&header), sizeof(wav_header)))
+        return std::nullopt;
+
+    // only canonical header is supported, other files have to be probed
+    if (memcmp(header.RIFF, "RIFF", 4) != 0 ||
+        memcmp(header.WAVE, "WAVE", 4) != 0 ||
+        memcmp(header.data, "data", 4) != 0 || header.audio_format != 1)
+        return std::nullopt;
+
+    auto bytes_per_sec = static_cast<size_t>(header.sample_rate) *
+                         header.num_channels * (header.bits_per_sample / 8);
+    if (bytes_per_sec == 0) return std::nullopt;
+
+    size_t data_size = header.data_size;
+    if (data_size == 0 || data_size > file_size - sizeof(wav_header))
+        data_size = file_size - sizeof(wav_header);
+
+    return data_size * 1000 / bytes_per_sec;
+}
+
 float tts_engine::vits_length_scale(unsigned int speech_speed,
                                     float initial_length_scale) {
     return initial_length_scale *
@@ -170,7 +170,9 @@ class tts_engine {
     std::condition_variable m_cv;
     state_t m_state = state_t::idle;
     text_tools::processor m_text_processor;
+    // mono wav with ref voice, cached in cache dir by content hash
     std::string m_ref_voice_wav_file;
+    std::optional<size_t> m_ref_voice_hash;
     bool m_restart_requested = false;
 
     static std::string first_file_with_ext(std::string dir_path,
@@ -181,6 +183,8 @@ class tts_engine {
                                  int channels, uint32_t num_samples,
                                  std::ofstream& wav_file);
     static wav_header read_wav_header(std::ifstream& wav_file);
+    // duration in ms computed from number of samples in pcm wav file
+    static std::optional<size_t> wav_duration(const std::string& wav_file_path);
     static float vits_length_scale(unsigned int speech_speed,
                                    float initial_length_scale);
     static float overflow_duration_threshold(unsigned int speech_speed,
@@ -199,6 +203,8 @@ class tts_engine {
                                    bool split = true) const;
     void apply_speed(const std::string& file) const;
     void setup_ref_voice();
+    // path of file in cache dir with data derived from current ref voice
+    std::string ref_voice_cache_file(const std::string& suffix) const;
     void make_silence_wav_file(size_t duration_msec,
                                const std::string& output_file) const;
     inline bool is_shutdown() const {
@@ -10,11 +10,10 @@
 #include <webrtc_vad.h>
 
 #include <algorithm>
-#include <numeric>
 #include <stdexcept>
-#include <vector>
 
 #include "logger.hpp"
+#include "metrics.hpp"
 
 vad::vad() { restart(); }
 
@@ -36,156 +35,127 @@ void vad::restart() {
 
 void vad::reset() {
     m_output_samples.clear();
-    m_input_samples.clear();
-    m_dup_size = 0;
+    m_samples.clear();
+    m_samples_offset = 0;
+    m_chunks = 0;
+    m_results.fill(false);
+    m_results_sum = 0;
+    m_speech_start.reset();
+    m_speech_min_start = 0;
+    m_spans.clear();
 }
 
 vad::~vad() { WebRtcVad_Free(m_handle); }
 
-void vad::shift_left(std::vector<int16_t>& vec, size_t distance) {
-    if (distance >= vec.size()) {
-        vec.clear();
-        return;
-    }
-
-    auto beg = vec.cbegin();
-    std::advance(beg, distance);
+bool vad::classify_chunk(const buf_t::value_type* chunk) const {
+    auto result = WebRtcVad_Process(m_handle, m_fs, chunk, m_chunk_size);
 
-    std::copy(beg, vec.cend(), vec.begin());
+    if (result < 0) throw std::runtime_error("process error");
 
-    vec.resize(vec.size() - distance);
+    return result == 1;
 }
 
-[[maybe_unused]] static void log_vec(const std::vector<bool>& vec) {
-    std::ostringstream os;
-    std::for_each(vec.cbegin(), vec.cend(), [&os](auto value) { os << value; });
-    LOGD("results: " << os.str());
-}
+void vad::add_span(size_t start, size_t end) {
+    if (end <= start) return;
 
-static void insert_to_vec(const std::vector<int16_t>& input, size_t start,
-                          size_t stop, std::vector<int16_t>& output) {
-    auto beg = input.begin();
-    std::advance(beg, start);
+    LOGT("speech span: " << start << "-" << end);
 
-    auto end = input.begin();
-    std::advance(end, stop);
+    start -= m_samples_offset;
+    end -= m_samples_offset;
 
-    output.insert(output.end(), beg, end);
+    if (!m_spans.empty() && m_spans.back().end == start)
+        m_spans.back().end = end;
+    else
+        m_spans.push_back({start, end});
 }
 
-std::vector<bool> vad::vad_process(const buf_t& samples) const {
-    const auto chunks = samples.size() / m_chunk_size;
+void vad::push_result(bool speech) {
+    // running majority vote over last m_chunks_in_frame chunks
+    auto& old_result = m_results[m_chunks % m_chunks_in_frame];
+    if (old_result) --m_results_sum;
+    old_result = speech;
+    if (speech) ++m_results_sum;
 
-    std::vector<bool> results;
-    results.reserve(chunks);
+    ++m_chunks;
 
-    for (size_t chunk = 0; chunk < chunks; ++chunk) {
-        auto result = WebRtcVad_Process(m_handle, m_fs,
-                                        samples.data() + (chunk * m_chunk_size),
-                                        m_chunk_size);
+    if (m_chunks < m_chunks_in_frame) return;
 
-        if (result < 0) throw std::runtime_error("process error");
+    auto window_start = (m_chunks - m_chunks_in_frame) * m_chunk_size;
+    auto window_end = m_chunks * m_chunk_size;
+    auto active = 2 * m_results_sum > m_chunks_in_frame;
 
-        results.push_back(result == 1);
+    if (active && !m_speech_start && window_start >= m_speech_min_start) {
+        m_speech_start = window_start;
+    } else if (!active && m_speech_start) {
+        add_span(*m_speech_start, window_end);
+        m_speech_start.reset();
+        m_speech_min_start = window_end;
     }
-
-    return results;
 }
 
-bool vad::is_speech(const buf_t::value_type* frame, size_t frame_size) {
-    return !vad::remove_silence(frame, frame_size).empty();
-}
-
-const vad::buf_t& vad::remove_silence(const buf_t::value_type* frame,
-                                      size_t frame_size) {
-    m_output_samples.clear();
-
-    for (size_t i = 0; i < frame_size; ++i) m_input_samples.push_back(frame[i]);
-
-    if (m_input_samples.size() < m_chunk_size) return m_output_samples;
-
-    LOGT("input samples: size=" << m_input_samples.size());
-
-    auto vad_results = vad_process(m_input_samples);
-
-    if (vad_results.size() < m_chunks_in_frame) return m_output_samples;
-
-    std::optional<size_t> cut_start;
-    std::optional<size_t> cut_stop;
+void vad::discard_samples() {
+    // samples of next window are still needed
+    auto keep_from =
+        m_chunks + 1 > m_chunks_in_frame
+            ? (m_chunks + 1 - m_chunks_in_frame) * m_chunk_size
+            : 0;
+    if (m_speech_start) keep_from = std::min(keep_from, *m_speech_start);
 
-    for (size_t chunk = 0; chunk <= (vad_results.size() - m_chunks_in_frame);
-         ++chunk) {
-        auto beg = vad_results.cbegin();
-        std::advance(beg, chunk);
+    auto to_discard = keep_from - m_samples_offset;
 
-        auto end = beg;
-        std::advance(end, m_chunks_in_frame);
+    // removing from front only when it is cheaper than already processed
+    // samples, so every sample is moved at most once in average
+    if (to_discard == 0 || to_discard < m_samples.size() - to_discard) return;
 
-        auto acc = std::accumulate(beg, end, static_cast<size_t>(0),
-                                   [](size_t sum, bool value) {
-                                       if (value) ++sum;
-                                       return sum;
-                                   });
-
-        auto vad_active = 2 * acc > m_chunks_in_frame;
-
-        if (vad_active && !cut_start) {
-            auto pos = std::min(chunk * m_chunk_size, m_input_samples.size());
-            LOGT("cut start: pos=" << pos << ", m_dup_size=" << m_dup_size);
-
-            if (pos == 0) {
-                pos = std::min(pos + m_dup_size, m_input_samples.size());
-                m_dup_size = 0;
-            }
-
-            cut_start.emplace(pos);
+    m_samples.erase(m_samples.begin(),
+                    m_samples.begin() + static_cast<long>(to_discard));
+    m_samples_offset = keep_from;
+}
 
-            LOGT("cut start: " << *cut_start << ", chunk=" << chunk
-                               << ", m_chunk_size=" << m_chunk_size);
-        }
+const vad::spans_t& vad::process(const buf_t::value_type* frame,
+                                 size_t frame_size) {
+    metrics::scoped_timer timer{metrics::stage_t::vad,
+                                metrics::samples_to_ms(frame_size, m_fs)};
 
-        if (!vad_active && cut_start) {
-            auto pos = std::min((chunk + m_chunks_in_frame) * m_chunk_size,
-                                m_input_samples.size());
-            LOGT("cut stop: pos=" << pos);
+    m_spans.clear();
 
-            if (pos > *cut_start) {
-                cut_stop.emplace(pos);
+    discard_samples();
 
-                LOGT("cut stop: " << *cut_stop << ", chunk=" << chunk
-                                  << ", m_chunk_size=" << m_chunk_size);
+    m_samples.insert(m_samples.end(), frame, frame + frame_size);
 
-                insert_to_vec(m_input_samples, *cut_start, *cut_stop,
-                              m_output_samples);
+    LOGT("vad samples: offset=" << m_samples_offset
+                                << ", size=" << m_samples.size());
 
-                cut_start.reset();
-                chunk += m_chunks_in_frame;
-            }
-        }
+    // each chunk is classified only once
+    while ((m_chunks + 1) * m_chunk_size <=
+           m_samples_offset + m_samples.size()) {
+        push_result(classify_chunk(m_samples.data() +
+                                   (m_chunks * m_chunk_size -
+                                    m_samples_offset)));
     }
 
-    m_dup_size = 0;
-
-    auto dup_size = m_input_samples.size() <= m_dup_max_size
-                        ? m_dup_max_size - m_input_samples.size()
-                        : m_dup_max_size;
+    if (m_speech_start) {
+        // speech continues, returning what has been classified so far
+        auto end = m_chunks * m_chunk_size;
+        add_span(*m_speech_start, end);
+        m_speech_start = end;
+    }
 
-    if (cut_start) {
-        cut_stop.emplace(m_input_samples.size());
+    return m_spans;
+}
 
-        LOGT("cut stop: " << *cut_stop);
+bool vad::is_speech(const buf_t::value_type* frame, size_t frame_size) {
+    return !process(frame, frame_size).empty();
+}
 
-        insert_to_vec(m_input_samples, *cut_start, *cut_stop, m_output_samples);
-    }
+const vad::buf_t& vad::remove_silence(const buf_t::value_type* frame,
+                                      size_t frame_size) {
+    m_output_samples.clear();
 
-    if (cut_stop) {
-        auto not_cut = m_input_samples.size() - *cut_stop;
-        if (not_cut < dup_size) m_dup_size = dup_size - not_cut;
+    for (const auto& span : process(frame, frame_size)) {
+        m_output_samples.insert(m_output_samples.end(), samples() + span.start,
+                                samples() + span.end);
     }
 
-    LOGT("dup: added size=" << dup_size << ", to remove size=" << m_dup_size);
-
-    shift_left(m_input_samples, m_input_samples.size() - dup_size);
-
     return m_output_samples;
 }
@@ -8,6 +8,7 @@
 #ifndef VAD_H
 #define VAD_H
 
+#include <array>
 #include <cstddef>
 #include <cstdint>
 #include <optional>
@@ -19,32 +20,55 @@ class vad {
    public:
     using buf_t = std::vector<int16_t>;
 
-    struct voice_active_result {
-        std::optional<size_t> start;
-        std::optional<size_t> stop;
+    // range of speech samples, positions are relative to samples()
+    struct span_t {
+        size_t start = 0;
+        size_t end = 0;
+        inline size_t size() const { return end - start; }
     };
+    using spans_t = std::vector<span_t>;
 
     vad();
     ~vad();
     void reset();
     void restart();
-    const buf_t& remove_silence(const buf_t::value_type* frame, size_t frame_size);
+    // Classifies new samples and returns speech spans found so far which were
+    // not returned before. Spans are valid until next call.
+    const spans_t& process(const buf_t::value_type* frame, size_t frame_size);
+    inline const buf_t::value_type* samples() const { return m_samples.data(); }
+    // stream position of first sample in samples()
+    inline size_t samples_offset() const { return m_samples_offset; }
+    const buf_t& remove_silence(const buf_t::value_type* frame,
+                                size_t frame_size);
     bool is_speech(const buf_t::value_type* frame, size_t frame_size);
 
    private:
     inline static const size_t m_chunk_size = 480;
-    inline static const size_t m_dup_max_size = 10 * m_chunk_size;
     inline static const size_t m_chunks_in_frame = 25;
 
     WebRtcVadInst* m_handle = nullptr;
     int m_mode = 3;
     int m_fs = 16000;
-    buf_t m_input_samples;
+    // samples that still can be part of speech span
+    buf_t m_samples;
+    // stream position of first sample in m_samples
+    size_t m_samples_offset = 0;
+    // number of classified chunks since reset
+    size_t m_chunks = 0;
+    // results of last m_chunks_in_frame chunks
+    std::array<bool, m_chunks_in_frame> m_results{};
+    size_t m_results_sum = 0;
+    // stream position of currently open speech span
+    std::optional<size_t> m_speech_start;
+    // stream position before which new speech span can't start
+    size_t m_speech_min_start = 0;
+    spans_t m_spans;
     buf_t m_output_samples;
-    size_t m_dup_size = 0;
 
-    std::vector<bool> vad_process(const buf_t& samples) const;
-    static void shift_left(std::vector<int16_t>& vec, size_t distance);
+    bool classify_chunk(const buf_t::value_type* chunk) const;
+    void push_result(bool speech);
+    void add_span(size_t start, size_t end);
+    void discard_samples();
 };
 
 #endif  // VAD_H
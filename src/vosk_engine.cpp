@@ -16,11 +16,11 @@
 #include <unistd.h>
 
 #include <algorithm>
-#include <array>
 #include <chrono>
 #include <sstream>
 
 #include "logger.hpp"
+#include "metrics.hpp"
 #include "nlohmann/json.hpp"
 
 using namespace std::chrono_literals;
@@ -222,12 +222,13 @@ stt_engine::samples_process_result_t vosk_engine::process_buff() {
 
     if (sof) {
         m_speech_buf.clear();
-        m_start_time.reset();
+        reset_sentence_timer();
         m_vad.reset();
         reset_segment_counters();
 
         if (m_vosk_recognizer)
             m_vosk_api.vosk_recognizer_reset(m_vosk_recognizer);
+        m_partial_scheduler.reset();
     }
 
 #ifdef DUMP_AUDIO_TO_FILE
@@ -249,19 +250,19 @@ stt_engine::samples_process_result_t vosk_engine::process_buff() {
         m_in_buf.size * sizeof(decltype(m_in_buf.buf)::value_type));
 #endif
 
-    const auto& vad_buf =
-        m_vad.remove_silence(m_in_buf.buf.data(), m_in_buf.size);
+    const auto& vad_spans = m_vad.process(m_in_buf.buf.data(), m_in_buf.size);
 
 #ifdef DUMP_AUDIO_TO_FILE
     if (!m_file_audio_after_vad)
         m_file_audio_after_vad =
             std::make_unique<std::ofstream>("audio_after_vad.pcm");
-    m_file_audio_after_vad->write(
-        reinterpret_cast<const char*>(vad_buf.data()),
-        vad_buf.size() * sizeof(decltype(m_in_buf.buf)::value_type));
+    for (const auto& span : vad_spans)
+        m_file_audio_after_vad->write(
+            reinterpret_cast<const char*>(m_vad.samples() + span.start),
+            span.size() * sizeof(decltype(m_in_buf.buf)::value_type));
 #endif
 
-    bool vad_status = !vad_buf.empty();
+    bool vad_status = !vad_spans.empty();
 
     if (vad_status) {
         LOGD("vad: speech detected");
@@ -271,12 +272,15 @@ stt_engine::samples_process_result_t vosk_engine::process_buff() {
             set_speech_detection_status(
                 speech_detection_status_t::speech_detected);
 
-        if (m_config.text_format == text_format_t::raw)
-            m_speech_buf.insert(m_speech_buf.end(), vad_buf.cbegin(),
-                                vad_buf.cend());
-        else
+        if (m_config.text_format == text_format_t::raw) {
+            for (const auto& span : vad_spans)
+                m_speech_buf.insert(m_speech_buf.end(),
+                                    m_vad.samples() + span.start,
+                                    m_vad.samples() + span.end);
+        } else {
             m_speech_buf.insert(m_speech_buf.end(), m_in_buf.buf.cbegin(),
                                 m_in_buf.buf.cbegin() + m_in_buf.size);
+        }
 
         restart_sentence_timer();
     } else {
@@ -321,12 +325,17 @@ stt_engine::samples_process_result_t vosk_engine::process_buff() {
         m_segment_time_offset += m_segment_time_discarded_before;
         m_segment_time_discarded_before = 0;
 
-        decode_speech(m_speech_buf, final_decode);
+        {
+            metrics::scoped_timer timer{
+                metrics::stage_t::decode,
+                metrics::samples_to_ms(m_speech_buf.size(), m_sample_rate)};
+            decode_speech(m_speech_buf, final_decode);
+        }
 
         m_segment_time_offset += m_segment_time_discarded_after;
         m_segment_time_discarded_after = 0;
 
-        if (m_config.speech_started) set_state(state_t::idle);
+        if (speech_status()) set_state(state_t::idle);
 
         m_speech_buf.clear();
 
@@ -428,22 +437,20 @@ void vosk_engine::decode_speech(const vosk_buf_t& buf, bool eof) {
         return;
     }
 
-    if (ret == 0 && !eof) {
-        if (m_config.text_format == text_format_t::subrip) {
+    if (!eof) {
+        // in subrip mode only final result is used
+        if (m_config.text_format == text_format_t::subrip) return;
+
+        // partial result is taken on a cadence, recognizer is finalized only
+        // on speech end detected by vad (eof)
+        if (!partial_due(buf.size())) {
+            LOGD("partial result not needed yet");
             return;
-        } else {
-            // append silence to force partial result
-            std::array<vosk_buf_t::value_type, m_in_buf_max_size> silence{};
-
-            auto ret = m_vosk_api.vosk_recognizer_accept_waveform_s(
-                m_vosk_recognizer, silence.data(), silence.size());
-            if (ret == 0) {
-                LOGD("no speech decoded");
-                return;
-            }
         }
     }
 
+    auto partial_start = std::chrono::steady_clock::now();
+
     const char* old_locale = setlocale(LC_NUMERIC, "C");
 
     if (m_config.text_format == text_format_t::subrip && eof) {
@@ -476,7 +483,7 @@ void vosk_engine::decode_speech(const vosk_buf_t& buf, bool eof) {
         LOGD("speech decoded");
 #endif
 
-        if (m_punctuator) result = m_punctuator->process(result);
+        if (m_punctuator) result = restore_punctuation(result, eof);
 
         if (!m_intermediate_text || m_intermediate_text != result)
             set_intermediate_text(result);
@@ -484,5 +491,8 @@ void vosk_engine::decode_speech(const vosk_buf_t& buf, bool eof) {
 
     setlocale(LC_NUMERIC, old_locale);
 
-    if (eof) m_vosk_api.vosk_recognizer_reset(m_vosk_recognizer);
+    if (eof)
+        m_vosk_api.vosk_recognizer_reset(m_vosk_recognizer);
+    else
+        partial_decoded(partial_start);
 }
@@ -12,17 +12,23 @@
 #include <algorithm>
 #include <chrono>
 #include <cstdlib>
+#include <map>
+#include <mutex>
+#include <optional>
 #include <sstream>
+#include <thread>
+#include <tuple>
 
 #include "cpu_tools.hpp"
 #include "logger.hpp"
+#include "metrics.hpp"
 #include "text_tools.hpp"
 
 whisper_engine::whisper_engine(config_t config, callbacks_t call_backs)
     : stt_engine{std::move(config), std::move(call_backs)} {
     open_whisper_lib();
-    m_wparams = make_wparams();
     m_speech_buf.reserve(m_speech_max_size);
+    m_use_decoding_thread = true;
 }
 
 whisper_engine::~whisper_engine() {
@@ -30,7 +36,15 @@ whisper_engine::~whisper_engine() {
 
     stop();
 
-    if (m_whisper_api.ok()) {
+    for (auto* state : m_whisper_states)
+        m_whisper_api.whisper_free_state(state);
+    m_whisper_states.clear();
+
+    if (m_whisper_model) {
+        // model is freed by the last engine using it
+        m_whisper_model.reset();
+        m_whisper_ctx = nullptr;
+    } else if (m_whisper_api.ok()) {
         if (m_whisper_ctx) {
             m_whisper_api.whisper_free(m_whisper_ctx);
             m_whisper_ctx = nullptr;
@@ -50,6 +64,10 @@ whisper_engine::~whisper_engine() {
     unsetenv("CUDA_VISIBLE_DEVICES");
 }
 
+bool whisper_engine::shares_model() const {
+    return m_whisper_api.state_ok();
+}
+
 bool whisper_engine::has_cuda() {
     auto handle = dlopen("libwhisper-cublas.so", RTLD_LAZY);
     if (!handle) {
@@ -86,20 +104,53 @@ bool whisper_engine::has_hip() {
     return true;
 }
 
-void whisper_engine::open_whisper_lib() {
+struct whisper_cpu_variant_t {
+    const char* lib_name;
+    unsigned int feature_flags;
+};
+
+// CPU builds, from the most optimized, the first one supported by CPU and
+// installed is used
+static const whisper_cpu_variant_t whisper_cpu_variants[] = {
 #ifdef ARCH_ARM_32
-    if (cpu_tools::cpuinfo().feature_flags &
-        cpu_tools::feature_flags_t::asimd) {
-        LOGD("using whisper-openblas");
-        m_whisperlib_handle = dlopen("libwhisper-openblas.so", RTLD_LAZY);
-    } else {
-        LOGW("using whisper-fallback");
-        m_whisperlib_handle = dlopen("libwhisper-fallback.so", RTLD_LAZY);
-    }
+    {"libwhisper-openblas.so", cpu_tools::feature_flags_t::asimd},
+    {"libwhisper-fallback.so", cpu_tools::feature_flags_t::none},
 #elif ARCH_ARM_64
-    LOGD("using whisper-openblas");
-    m_whisperlib_handle = dlopen("libwhisper-openblas.so", RTLD_LAZY);
+    {"libwhisper-openblas-armv82.so",
+     cpu_tools::feature_flags_t::asimddp | cpu_tools::feature_flags_t::asimdhp},
+    {"libwhisper-openblas.so", cpu_tools::feature_flags_t::none},
 #else
+    {"libwhisper-openblas-avx512.so",
+     cpu_tools::feature_flags_t::avx512 | cpu_tools::feature_flags_t::avx2 |
+         cpu_tools::feature_flags_t::fma | cpu_tools::feature_flags_t::f16c},
+    {"libwhisper-openblas.so",
+     cpu_tools::feature_flags_t::avx | cpu_tools::feature_flags_t::avx2 |
+         cpu_tools::feature_flags_t::fma | cpu_tools::feature_flags_t::f16c},
+    {"libwhisper-openblas-avx.so", cpu_tools::feature_flags_t::avx},
+    {"libwhisper-openblas-sse4.so", cpu_tools::feature_flags_t::sse4},
+    {"libwhisper-fallback.so", cpu_tools::feature_flags_t::none},
+#endif
+};
+
+void whisper_engine::open_whisper_cpu_lib() {
+    auto feature_flags = cpu_tools::cpuinfo().feature_flags;
+
+    for (const auto& variant : whisper_cpu_variants) {
+        if ((feature_flags & variant.feature_flags) != variant.feature_flags)
+            continue;
+
+        m_whisperlib_handle = dlopen(variant.lib_name, RTLD_LAZY);
+        if (m_whisperlib_handle) {
+            LOGD("using " << variant.lib_name);
+            return;
+        }
+
+        LOGW("failed to open " << variant.lib_name << ": " << dlerror());
+    }
+}
+
+void whisper_engine::open_whisper_lib() {
+#ifdef ARCH_X86_64
     if (auto cpuinfo = cpu_tools::cpuinfo();
         cpuinfo.feature_flags & cpu_tools::feature_flags_t::avx &&
         cpuinfo.feature_flags & cpu_tools::feature_flags_t::avx2 &&
@@ -151,19 +202,13 @@ void whisper_engine::open_whisper_lib() {
                     LOGE("failed to open libwhisper-clblast.so: " << dlerror());
             }
         }
-
-        if (m_whisperlib_handle == nullptr) {
-            LOGD("using whisper-openblas");
-            m_whisperlib_handle = dlopen("libwhisper-openblas.so", RTLD_LAZY);
-        }
-    } else {
-        LOGW("using whisper-fallback");
-        m_whisperlib_handle = dlopen("libwhisper-fallback.so", RTLD_LAZY);
     }
 #endif
 
+    if (m_whisperlib_handle == nullptr) open_whisper_cpu_lib();
+
     if (m_whisperlib_handle == nullptr) {
-        LOGE("failed to open whisper lib: " << dlerror());
+        LOGE("failed to open whisper lib");
         throw std::runtime_error("failed to open whisper lib");
     }
 
@@ -194,6 +239,30 @@ void whisper_engine::open_whisper_lib() {
     m_whisper_api.whisper_full_default_params =
         reinterpret_cast<decltype(m_whisper_api.whisper_full_default_params)>(
             dlsym(m_whisperlib_handle, "whisper_full_default_params"));
+    m_whisper_api.whisper_init_from_file_no_state = reinterpret_cast<
+        decltype(m_whisper_api.whisper_init_from_file_no_state)>(
+        dlsym(m_whisperlib_handle, "whisper_init_from_file_no_state"));
+    m_whisper_api.whisper_init_state =
+        reinterpret_cast<decltype(m_whisper_api.whisper_init_state)>(
+            dlsym(m_whisperlib_handle, "whisper_init_state"));
+    m_whisper_api.whisper_free_state =
+        reinterpret_cast<decltype(m_whisper_api.whisper_free_state)>(
+            dlsym(m_whisperlib_handle, "whisper_free_state"));
+    m_whisper_api.whisper_full_with_state =
+        reinterpret_cast<decltype(m_whisper_api.whisper_full_with_state)>(
+            dlsym(m_whisperlib_handle, "whisper_full_with_state"));
+    m_whisper_api.whisper_full_n_segments_from_state = reinterpret_cast<
+        decltype(m_whisper_api.whisper_full_n_segments_from_state)>(
+        dlsym(m_whisperlib_handle, "whisper_full_n_segments_from_state"));
+    m_whisper_api.whisper_full_get_segment_text_from_state = reinterpret_cast<
+        decltype(m_whisper_api.whisper_full_get_segment_text_from_state)>(
+        dlsym(m_whisperlib_handle, "whisper_full_get_segment_text_from_state"));
+    m_whisper_api.whisper_full_get_segment_t0_from_state = reinterpret_cast<
+        decltype(m_whisper_api.whisper_full_get_segment_t0_from_state)>(
+        dlsym(m_whisperlib_handle, "whisper_full_get_segment_t0_from_state"));
+    m_whisper_api.whisper_full_get_segment_t1_from_state = reinterpret_cast<
+        decltype(m_whisper_api.whisper_full_get_segment_t1_from_state)>(
+        dlsym(m_whisperlib_handle, "whisper_full_get_segment_t1_from_state"));
 
     if (!m_whisper_api.ok()) {
         LOGE("failed to register whisper api");
@@ -202,20 +271,9 @@ void whisper_engine::open_whisper_lib() {
 }
 
 void whisper_engine::push_buf_to_whisper_buf(
-    const std::vector<in_buf_t::buf_t::value_type>& buf,
+    const in_buf_t::buf_t::value_type* data, in_buf_t::buf_t::size_type size,
     whisper_buf_t& whisper_buf) {
     // convert s16 to f32 sample format
-    std::transform(buf.cbegin(), buf.cend(), std::back_inserter(whisper_buf),
-                   [](auto sample) {
-                       return static_cast<whisper_buf_t::value_type>(sample) /
-                              32768.0F;
-                   });
-}
-
-void whisper_engine::push_buf_to_whisper_buf(in_buf_t::buf_t::value_type* data,
-                                             in_buf_t::buf_t::size_type size,
-                                             whisper_buf_t& whisper_buf) {
-    // convert s16 to f32 sample format
     whisper_buf.reserve(whisper_buf.size() + size);
     for (size_t i = 0; i < size; ++i) {
         whisper_buf.push_back(static_cast<whisper_buf_t::value_type>(data[i]) /
@@ -223,7 +281,13 @@ void whisper_engine::push_buf_to_whisper_buf(in_buf_t::buf_t::value_type* data,
     }
 }
 
-void whisper_engine::reset_impl() { m_speech_buf.clear(); }
+void whisper_engine::reset_impl() {
+    m_speech_buf.clear();
+    m_speech_pauses.clear();
+    // vad is reset as well
+    m_stream_pos = 0;
+    m_speech_end_pos = 0;
+}
 
 void whisper_engine::stop_processing_impl() {
     if (m_whisper_ctx) {
@@ -231,15 +295,24 @@ void whisper_engine::stop_processing_impl() {
     }
 }
 
-void whisper_engine::start_processing_impl() { create_model(); }
+void whisper_engine::start_processing_impl() {
+    // text format and sub config may change when engine is restarted
+    m_wparams = make_wparams();
+    create_model();
+}
 
 void whisper_engine::create_model() {
     if (m_whisper_ctx) return;
 
     LOGD("creating whisper model");
 
-    m_whisper_ctx = m_whisper_api.whisper_init_from_file(
-        m_config.model_files.model_file.c_str());
+    if (m_whisper_api.state_ok()) {
+        m_whisper_model = shared_model();
+        m_whisper_ctx = m_whisper_model.get();
+    } else {
+        m_whisper_ctx = m_whisper_api.whisper_init_from_file(
+            m_config.model_files.model_file.c_str());
+    }
 
     if (m_whisper_ctx == nullptr) {
         LOGE("failed to create whisper model");
@@ -249,6 +322,51 @@ void whisper_engine::create_model() {
     LOGD("whisper model created");
 }
 
+std::shared_ptr<void> whisper_engine::shared_model() {
+    // engines with the same model, lib and device use one instance of model
+    using key_t = std::tuple<std::string, void*, int>;
+    static std::mutex mtx;
+    static std::map<key_t, std::weak_ptr<void>> models;
+
+    std::lock_guard lock{mtx};
+
+    key_t key{m_config.model_files.model_file, m_whisperlib_handle,
+              m_config.use_gpu ? m_config.gpu_device.id : -1};
+
+    if (auto it = models.find(key); it != models.end()) {
+        if (auto model = it->second.lock()) {
+            LOGD("using shared whisper model");
+            return model;
+        }
+    }
+
+    auto* ctx = m_whisper_api.whisper_init_from_file_no_state(
+        m_config.model_files.model_file.c_str());
+    if (ctx == nullptr) return {};
+
+    std::shared_ptr<void> model{
+        ctx, [whisper_free = m_whisper_api.whisper_free](void* model_ctx) {
+            whisper_free(model_ctx);
+        }};
+
+    models[key] = model;
+
+    return model;
+}
+
+void* whisper_engine::whisper_state(size_t idx) {
+    while (m_whisper_states.size() <= idx) {
+        auto* state = m_whisper_api.whisper_init_state(m_whisper_ctx);
+        if (state == nullptr) {
+            LOGE("failed to create whisper state");
+            throw std::runtime_error("failed to create whisper state");
+        }
+        m_whisper_states.push_back(state);
+    }
+
+    return m_whisper_states[idx];
+}
+
 stt_engine::samples_process_result_t whisper_engine::process_buff() {
     if (!lock_buff_for_processing())
         return samples_process_result_t::wait_for_samples;
@@ -263,17 +381,33 @@ stt_engine::samples_process_result_t whisper_engine::process_buff() {
 
     if (sof) {
         m_speech_buf.clear();
-        m_start_time.reset();
+        m_speech_pauses.clear();
+        m_stream_pos = 0;
+        m_speech_end_pos = 0;
+        reset_sentence_timer();
         m_vad.reset();
-        reset_segment_counters();
+        m_segment_time_discarded_before = 0;
+        m_segment_time_discarded_after = 0;
+        run_after_decoding([this] {
+            m_segment_offset = 0;
+            m_segment_time_offset = m_config.sub_config.time_offset_ms;
+        });
     }
 
     m_denoiser.process(m_in_buf.buf.data(), m_in_buf.size);
 
-    const auto& vad_buf =
-        m_vad.remove_silence(m_in_buf.buf.data(), m_in_buf.size);
+    const auto& vad_spans = m_vad.process(m_in_buf.buf.data(), m_in_buf.size);
+
+    auto in_buf_pos = m_stream_pos;
+    m_stream_pos += m_in_buf.size;
 
-    bool vad_status = !vad_buf.empty();
+    bool vad_status = !vad_spans.empty();
+
+    // with parallel decoding, speech is not decoded on each pause but
+    // collected until buffer is full, so there is enough audio for all
+    // processors; pauses are kept in buffer to preserve timestamps
+    bool accumulate = m_processors > 1 &&
+                      m_config.speech_mode == speech_mode_t::automatic;
 
     if (vad_status) {
         LOGD("vad: speech detected");
@@ -283,11 +417,15 @@ stt_engine::samples_process_result_t whisper_engine::process_buff() {
             set_speech_detection_status(
                 speech_detection_status_t::speech_detected);
 
-        if (m_config.text_format == text_format_t::raw)
-            push_buf_to_whisper_buf(vad_buf, m_speech_buf);
-        else
+        if (m_config.text_format == text_format_t::raw) {
+            for (const auto& span : vad_spans)
+                push_buf_to_whisper_buf(m_vad.samples() + span.start,
+                                        span.size(), m_speech_buf);
+        } else {
+            if (m_speech_buf.empty()) m_speech_buf_pos = in_buf_pos;
             push_buf_to_whisper_buf(m_in_buf.buf.data(), m_in_buf.size,
                                     m_speech_buf);
+        }
 
         restart_sentence_timer();
     } else {
@@ -305,21 +443,41 @@ stt_engine::samples_process_result_t whisper_engine::process_buff() {
         if (m_speech_buf.empty())
             m_segment_time_discarded_before +=
                 (1000 * m_in_buf.size) / m_sample_rate;
+        else if (accumulate)
+            push_buf_to_whisper_buf(m_in_buf.buf.data(), m_in_buf.size,
+                                    m_speech_buf);
         else
             m_segment_time_discarded_after +=
                 (1000 * m_in_buf.size) / m_sample_rate;
     }
 
+    if (accumulate) {
+        // audio is split for parallel decoding only in the middle of pauses,
+        // so no word is cut
+        for (const auto& span : vad_spans) {
+            auto start = m_vad.samples_offset() + span.start;
+            auto pause = (m_speech_end_pos + start) / 2;
+
+            if (start > m_speech_end_pos && pause > m_speech_buf_pos &&
+                pause < m_speech_buf_pos + m_speech_buf.size())
+                m_speech_pauses.push_back(pause - m_speech_buf_pos);
+
+            m_speech_end_pos = m_vad.samples_offset() + span.end;
+        }
+    }
+
     m_in_buf.clear();
 
     auto decode_samples = [&] {
-        if (m_speech_buf.size() > m_speech_max_size) {
+        if (m_speech_buf.size() > speech_max_size()) {
             LOGD("speech buf reached max size");
             return true;
         }
 
         if (m_speech_buf.empty()) return false;
 
+        if (accumulate && !eof) return false;
+
         if ((m_config.speech_mode == speech_mode_t::manual ||
              m_speech_detection_status ==
                  speech_detection_status_t::speech_detected) &&
@@ -339,7 +497,9 @@ stt_engine::samples_process_result_t whisper_engine::process_buff() {
         if (eof || (m_config.speech_mode == speech_mode_t::manual &&
                     m_speech_detection_status ==
                         speech_detection_status_t::no_speech)) {
-            flush(eof ? flush_t::eof : flush_t::regular);
+            run_after_decoding([this, eof] {
+                flush(eof ? flush_t::eof : flush_t::regular);
+            });
             free_buf();
             return samples_process_result_t::no_samples_needed;
         }
@@ -353,36 +513,53 @@ stt_engine::samples_process_result_t whisper_engine::process_buff() {
         return samples_process_result_t::no_samples_needed;
     }
 
-    set_state(state_t::decoding);
-
     if (!vad_status) {
         set_speech_detection_status(speech_detection_status_t::no_speech);
     }
 
     LOGD("speech frame: samples=" << m_speech_buf.size());
 
-    m_segment_time_offset += m_segment_time_discarded_before;
-    m_segment_time_discarded_before = 0;
+    auto flush_type =
+        eof || m_config.speech_mode == speech_mode_t::single_sentence
+            ? flush_t::eof
+            : flush_t::regular;
+
+    // next samples are processed while speech is decoded
+    push_decode_task([this, buf = std::move(m_speech_buf),
+                      pauses = std::move(m_speech_pauses),
+                      discarded_before = m_segment_time_discarded_before,
+                      discarded_after = m_segment_time_discarded_after,
+                      flush_type] {
+        set_state(state_t::decoding);
+
+        m_segment_time_offset += discarded_before;
+
+        {
+            metrics::scoped_timer timer{
+                metrics::stage_t::decode,
+                metrics::samples_to_ms(buf.size(), m_sample_rate)};
+            decode_speech(buf, pauses);
+        }
 
-    decode_speech(m_speech_buf);
+        m_segment_time_offset +=
+            (discarded_after + (1000 * buf.size() / m_sample_rate));
 
-    m_segment_time_offset += (m_segment_time_discarded_after +
-                              (1000 * m_speech_buf.size() / m_sample_rate));
-    m_segment_time_discarded_after = 0;
+        set_state(state_t::idle);
 
-    set_state(state_t::idle);
+        if (m_config.speech_mode == speech_mode_t::single_sentence &&
+            (!m_intermediate_text || m_intermediate_text->empty())) {
+            LOGD("no speech decoded, forcing sentence timeout");
+            m_call_backs.sentence_timeout();
+        }
 
-    if (m_config.speech_mode == speech_mode_t::single_sentence &&
-        (!m_intermediate_text || m_intermediate_text->empty())) {
-        LOGD("no speech decoded, forcing sentence timeout");
-        m_call_backs.sentence_timeout();
-    }
+        flush(flush_type);
+    });
 
+    m_segment_time_discarded_before = 0;
+    m_segment_time_discarded_after = 0;
     m_speech_buf.clear();
-
-    flush(eof || m_config.speech_mode == speech_mode_t::single_sentence
-              ? flush_t::eof
-              : flush_t::regular);
+    m_speech_buf.reserve(speech_max_size());
+    m_speech_pauses.clear();
 
     free_buf();
 
@@ -416,9 +593,12 @@ whisper_full_params whisper_engine::make_wparams() {
     wparams.suppress_non_speech_tokens = true;
     wparams.single_segment = false;
     wparams.translate = m_config.translate;
-    wparams.n_threads = std::min(
-        m_threads,
-        std::max(1, static_cast<int>(std::thread::hardware_concurrency())));
+    auto max_threads = static_cast<int>(cpu_tools::decode_threads());
+    if (m_config.max_threads > 0)
+        max_threads =
+            std::min(max_threads, static_cast<int>(m_config.max_threads));
+
+    wparams.n_threads = std::min(m_threads, max_threads);
     wparams.encoder_begin_callback = encoder_begin_callback;
     wparams.encoder_begin_callback_user_data = &m_thread_exit_requested;
     wparams.abort_callback = abort_callback;
@@ -426,16 +606,101 @@ whisper_full_params whisper_engine::make_wparams() {
     wparams.print_progress = false;
     wparams.print_timestamps = false;
 
+    m_processors = 1;
+
+    if (m_config.text_format == text_format_t::subrip) {
+        // segments are cut on word boundaries using token timestamps, so
+        // each segment fits in two subtitle lines and has exact timing
+        wparams.token_timestamps = true;
+        wparams.split_on_word = true;
+        wparams.max_len = static_cast<int>(
+            2 * std::max(m_config.sub_config.max_line_length,
+                         m_config.sub_config.min_line_length));
+
+        // whole file is available upfront, so chunks of audio can be
+        // decoded in parallel when cores are not used by one decoder
+        if (m_whisper_api.state_ok()) {
+            m_processors = std::clamp(max_threads / wparams.n_threads, 1,
+                                      m_max_processors);
+        }
+    }
+
     LOGD("cpu info: arch=" << cpu_tools::arch() << ", cores="
                            << std::thread::hardware_concurrency());
     LOGD("using threads: " << wparams.n_threads << "/"
-                           << std::thread::hardware_concurrency());
+                           << std::thread::hardware_concurrency()
+                           << ", processors: " << m_processors);
     LOGD("system info: " << m_whisper_api.whisper_print_system_info());
 
     return wparams;
 }
 
-void whisper_engine::decode_speech(const whisper_buf_t& buf) {
+std::vector<size_t> whisper_engine::chunk_starts(
+    size_t size, const std::vector<size_t>& pauses) const {
+    // chunks shorter than 30s are not worth splitting
+    auto processors = std::min<size_t>(
+        m_processors, std::max<size_t>(1, size / (m_sample_rate * 30)));
+
+    auto dist = [](size_t a, size_t b) { return a > b ? a - b : b - a; };
+
+    // chunks are cut on pauses closest to equal split
+    std::vector<size_t> starts{0};
+    for (size_t i = 1; i < processors; ++i) {
+        auto target = i * size / processors;
+        std::optional<size_t> best;
+
+        for (auto pause : pauses) {
+            if (pause < starts.back() + m_min_chunk_size ||
+                pause + m_min_chunk_size > size)
+                continue;
+            if (!best || dist(pause, target) < dist(*best, target))
+                best = pause;
+        }
+
+        if (best) starts.push_back(*best);
+    }
+
+    return starts;
+}
+
+int whisper_engine::full_with_states(const whisper_buf_t& buf,
+                                     const std::vector<size_t>& starts) {
+    // each chunk is decoded in its own thread with its own state of shared
+    // model
+    auto processors = starts.size();
+
+    for (size_t i = 0; i < processors; ++i) whisper_state(i);
+
+    std::vector<int> rets(processors, 0);
+    std::vector<std::thread> threads;
+
+    auto decode_chunk = [&](size_t i) {
+        auto end = i == processors - 1 ? buf.size() : starts[i + 1];
+        rets[i] = m_whisper_api.whisper_full_with_state(
+            m_whisper_ctx, m_whisper_states[i], m_wparams,
+            buf.data() + starts[i], static_cast<int>(end - starts[i]));
+    };
+
+    for (size_t i = 1; i < processors; ++i)
+        threads.emplace_back(decode_chunk, i);
+
+    decode_chunk(0);
+
+    for (auto& thread : threads) thread.join();
+
+    for (auto ret : rets)
+        if (ret != 0) return ret;
+
+    return 0;
+}
+
+size_t whisper_engine::speech_max_size() const {
+    // each parallel processor gets its own chunk of max size
+    return m_speech_max_size * m_processors;
+}
+
+void whisper_engine::decode_speech(const whisper_buf_t& buf,
+                                   const std::vector<size_t>& pauses) {
     LOGD("speech decoding started");
 
     create_model();
@@ -446,52 +711,90 @@ void whisper_engine::decode_speech(const whisper_buf_t& buf) {
 
     std::ostringstream os;
 
-    if (auto ret = m_whisper_api.whisper_full(m_whisper_ctx, m_wparams,
-                                              buf.data(), buf.size());
-        ret == 0) {
-        auto n = m_whisper_api.whisper_full_n_segments(m_whisper_ctx);
-        LOGD("decoded segments: " << n);
+    // times in ms relative to the beginning of buf
+    std::vector<text_tools::segment_t> segments;
 
+    auto add_segments = [&](void* state, size_t time_offset) {
+        auto n = m_whisper_api.whisper_full_n_segments_from_state(state);
         for (auto i = 0; i < n; ++i) {
-            std::string text =
-                m_whisper_api.whisper_full_get_segment_text(m_whisper_ctx, i);
-            rtrim(text);
-            ltrim(text);
-#ifdef DEBUG
-            LOGD("segment " << i << ": " << text);
-#endif
-            if (subrip) {
-                size_t t0 = std::max<int64_t>(
-                                0, m_whisper_api.whisper_full_get_segment_t0(
-                                       m_whisper_ctx, i)) *
-                            10;
-                size_t t1 = std::max<int64_t>(
-                                0, m_whisper_api.whisper_full_get_segment_t1(
-                                       m_whisper_ctx, i)) *
-                            10;
-
-                t0 += m_segment_time_offset;
-                t1 += m_segment_time_offset;
-
-                text_tools::segment_t segment{i + 1 + m_segment_offset, t0, t1,
-                                              text};
-                text_tools::break_segment_to_multiline(
-                    m_config.sub_config.min_line_length,
-                    m_config.sub_config.max_line_length, segment);
-
-                text_tools::segment_to_subrip_text(segment, os);
-            } else {
-                if (i != 0) os << ' ';
-                os << text;
-            }
+            auto t0 = m_whisper_api.whisper_full_get_segment_t0_from_state(
+                state, i);
+            auto t1 = m_whisper_api.whisper_full_get_segment_t1_from_state(
+                state, i);
+            segments.push_back(
+                {0, time_offset + std::max<int64_t>(0, t0) * 10,
+                 time_offset + std::max<int64_t>(0, t1) * 10,
+                 m_whisper_api.whisper_full_get_segment_text_from_state(state,
+                                                                        i)});
         }
+    };
+
+    int ret = 0;
+
+    if (m_whisper_model) {
+        auto starts = chunk_starts(buf.size(), pauses);
 
-        m_segment_offset += n;
+        LOGD("decoding chunks: " << starts.size());
+
+        ret = full_with_states(buf, starts);
+
+        if (ret == 0) {
+            for (size_t i = 0; i < starts.size(); ++i)
+                add_segments(m_whisper_states[i],
+                             (1000 * starts[i]) / m_sample_rate);
+        }
     } else {
+        ret = m_whisper_api.whisper_full(m_whisper_ctx, m_wparams, buf.data(),
+                                         buf.size());
+
+        if (ret == 0) {
+            auto n = m_whisper_api.whisper_full_n_segments(m_whisper_ctx);
+            for (auto i = 0; i < n; ++i) {
+                auto t0 =
+                    m_whisper_api.whisper_full_get_segment_t0(m_whisper_ctx, i);
+                auto t1 =
+                    m_whisper_api.whisper_full_get_segment_t1(m_whisper_ctx, i);
+                segments.push_back(
+                    {0, static_cast<size_t>(std::max<int64_t>(0, t0) * 10),
+                     static_cast<size_t>(std::max<int64_t>(0, t1) * 10),
+                     m_whisper_api.whisper_full_get_segment_text(
+                         m_whisper_ctx, i)});
+            }
+        }
+    }
+
+    if (ret != 0) {
         LOGE("whisper error: " << ret);
         return;
     }
 
+    LOGD("decoded segments: " << segments.size());
+
+    for (size_t i = 0; i < segments.size(); ++i) {
+        auto& segment = segments[i];
+        rtrim(segment.text);
+        ltrim(segment.text);
+#ifdef DEBUG
+        LOGD("segment " << i << ": " << segment.text);
+#endif
+        if (subrip) {
+            segment.n = i + 1 + m_segment_offset;
+            segment.t0 += m_segment_time_offset;
+            segment.t1 += m_segment_time_offset;
+
+            text_tools::break_segment_to_multiline(
+                m_config.sub_config.min_line_length,
+                m_config.sub_config.max_line_length, segment);
+
+            text_tools::segment_to_subrip_text(segment, os);
+        } else {
+            if (i != 0) os << ' ';
+            os << segment.text;
+        }
+    }
+
+    m_segment_offset += segments.size();
+
     if (m_thread_exit_requested) return;
 
     auto decoding_dur = std::chrono::duration_cast<std::chrono::milliseconds>(
@@ -504,13 +807,11 @@ void whisper_engine::decode_speech(const whisper_buf_t& buf) {
                 ((1000 * buf.size()) / static_cast<double>(m_sample_rate))
          << ")");
 
-    auto result =
-        merge_texts(m_intermediate_text.value_or(std::string{}), os.str());
+    auto text = os.str();
 
 #ifdef DEBUG
-    LOGD("speech decoded: text=" << result);
+    LOGD("speech decoded: text=" << text);
 #endif
 
-    if (!m_intermediate_text || m_intermediate_text != result)
-        set_intermediate_text(result);
+    append_intermediate_text(text);
 }
@@ -140,12 +140,16 @@ class whisper_engine : public stt_engine {
 
     whisper_engine(config_t config, callbacks_t call_backs);
     ~whisper_engine() override;
+    bool shares_model() const override;
 
    private:
     using whisper_buf_t = std::vector<float>;
 
     inline static const size_t m_speech_max_size = m_sample_rate * 60;  // 60s
     inline static const int m_threads = 5;
+    // max number of audio chunks decoded in parallel in subtitles mode
+    inline static const int m_max_processors = 4;
+    inline static const size_t m_min_chunk_size = m_sample_rate * 10;  // 10s
 
     struct whisper_api {
         void* (*whisper_init_from_file)(const char* path_model) = nullptr;
@@ -162,6 +166,31 @@ class whisper_engine : public stt_engine {
         void (*whisper_free)(void* ctx) = nullptr;
         whisper_full_params (*whisper_full_default_params)(
             whisper_sampling_strategy strategy) = nullptr;
+        // optional, model without state can be shared by many decoding
+        // states
+        void* (*whisper_init_from_file_no_state)(const char* path_model) =
+            nullptr;
+        void* (*whisper_init_state)(void* ctx) = nullptr;
+        void (*whisper_free_state)(void* state) = nullptr;
+        int (*whisper_full_with_state)(void* ctx, void* state,
+                                       whisper_full_params params,
+                                       const float* samples,
+                                       int n_samples) = nullptr;
+        int (*whisper_full_n_segments_from_state)(void* state) = nullptr;
+        const char* (*whisper_full_get_segment_text_from_state)(
+            void* state, int i_segment) = nullptr;
+        int64_t (*whisper_full_get_segment_t0_from_state)(
+            void* state, int i_segment) = nullptr;
+        int64_t (*whisper_full_get_segment_t1_from_state)(
+            void* state, int i_segment) = nullptr;
+        inline auto state_ok() const {
+            return whisper_init_from_file_no_state && whisper_init_state &&
+                   whisper_free_state && whisper_full_with_state &&
+                   whisper_full_n_segments_from_state &&
+                   whisper_full_get_segment_text_from_state &&
+                   whisper_full_get_segment_t0_from_state &&
+                   whisper_full_get_segment_t1_from_state;
+        }
         inline auto ok() const {
             return whisper_init_from_file && whisper_print_system_info &&
                    whisper_full && whisper_full_n_segments &&
@@ -172,22 +201,41 @@ class whisper_engine : public stt_engine {
     };
 
     whisper_buf_t m_speech_buf;
+    // positions in m_speech_buf in the middle of pauses between speech,
+    // collected only when speech is decoded in parallel chunks
+    std::vector<size_t> m_speech_pauses;
+    // stream positions of first sample in m_speech_buf, of next input
+    // sample and of the end of last speech detected by vad
+    size_t m_speech_buf_pos = 0;
+    size_t m_stream_pos = 0;
+    size_t m_speech_end_pos = 0;
     whisper_api m_whisper_api;
     void* m_whisperlib_handle = nullptr;
     void* m_whisper_ctx = nullptr;
+    // model shared with other engines, m_whisper_ctx points to it
+    std::shared_ptr<void> m_whisper_model;
+    // decoding states of shared model, one per processor
+    std::vector<void*> m_whisper_states;
     whisper_full_params m_wparams{};
+    int m_processors = 1;
 
     void open_whisper_lib();
+    void open_whisper_cpu_lib();
     void create_model();
+    std::shared_ptr<void> shared_model();
+    void* whisper_state(size_t idx);
     samples_process_result_t process_buff() override;
-    void decode_speech(const whisper_buf_t& buf);
+    void decode_speech(const whisper_buf_t& buf,
+                       const std::vector<size_t>& pauses);
+    std::vector<size_t> chunk_starts(size_t size,
+                                     const std::vector<size_t>& pauses) const;
+    int full_with_states(const whisper_buf_t& buf,
+                         const std::vector<size_t>& starts);
     static void push_buf_to_whisper_buf(
-        const std::vector<in_buf_t::buf_t::value_type>& buf,
-        whisper_buf_t& whisper_buf);
-    static void push_buf_to_whisper_buf(in_buf_t::buf_t::value_type* data,
-                                        in_buf_t::buf_t::size_type size,
-                                        whisper_buf_t& whisper_buf);
+        const in_buf_t::buf_t::value_type* data,
+        in_buf_t::buf_t::size_type size, whisper_buf_t& whisper_buf);
     whisper_full_params make_wparams();
+    size_t speech_max_size() const;
     void reset_impl() override;
     void stop_processing_impl() override;
     void start_processing_impl() override;
@@ -0,0 +1,42 @@
+/* Copyright (C) 2024 Michal Kosciesza <michal@mkiol.net>
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+#include <catch2/catch_test_macros.hpp>
+
+#include "batch_runner.h"
+
+TEST_CASE("batch_runner", "[parse_job]") {
+    SECTION("stt job") {
+        auto job = batch_runner::parse_job(
+            R"({"stt": "memo.mp3", "lang": "en", "out": "memo.txt"})");
+
+        REQUIRE(job);
+        REQUIRE(job->type == batch_runner::job_type_t::stt);
+        REQUIRE(job->input == "memo.mp3");
+        REQUIRE(job->lang == "en");
+        REQUIRE(job->out_file == "memo.txt");
+    }
+
+    SECTION("mnt job with options") {
+        auto job = batch_runner::parse_job(
+            R"({"mnt": "Hello.", "lang": "en", "out_lang": "de",)"
+            R"( "options": {"clean_text": true}})");
+
+        REQUIRE(job);
+        REQUIRE(job->type == batch_runner::job_type_t::mnt);
+        REQUIRE(job->out_lang == "de");
+        REQUIRE(job->out_file.isEmpty());
+        REQUIRE(job->options.value("clean_text").toBool());
+    }
+
+    SECTION("invalid jobs") {
+        REQUIRE(!batch_runner::parse_job("not json"));
+        REQUIRE(!batch_runner::parse_job(R"({"lang": "en"})"));
+        REQUIRE(!batch_runner::parse_job(R"({"tts": ""})"));
+        REQUIRE(!batch_runner::parse_job(R"({"mnt": "Hello.", "lang": "en"})"));
+    }
+}
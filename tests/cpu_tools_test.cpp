@@ -7,8 +7,16 @@
 
 #include "cpu_tools.hpp"
 
+#include <ftw.h>
+#include <stdlib.h>
+#include <sys/stat.h>
+
 #include <catch2/catch_test_macros.hpp>
+#include <cstdio>
+#include <fstream>
 #include <sstream>
+#include <string>
+#include <vector>
 
 TEST_CASE("cpu_tools", "[parse_cpuinfo]") {
     SECTION("parse_amd") {
@@ -36,7 +44,29 @@ bogomips	: 7189.52)";
             2u, cpu_tools::feature_flags_t::avx |
                     cpu_tools::feature_flags_t::avx2 |
                     cpu_tools::feature_flags_t::fma |
-                    cpu_tools::feature_flags_t::f16c};
+                    cpu_tools::feature_flags_t::f16c |
+                    cpu_tools::feature_flags_t::sse4};
+
+        REQUIRE(cpuinfo == expected_cpuinfo);
+    }
+
+    SECTION("parse_avx512") {
+        std::string cpuinfo_data = R"(processor	: 0
+vendor_id	: GenuineIntel
+model name	: Intel Xeon
+flags		: fpu sse sse2 ssse3 fma cx16 sse4_1 sse4_2 avx f16c avx2 avx512f avx512dq avx512cd avx512bw avx512vl avx_vnni avx512_vnni
+bogomips	: 4800.00)";
+        std::istringstream is{cpuinfo_data};
+
+        auto cpuinfo = cpu_tools::parse_cpuinfo(is);
+        cpu_tools::cpuinfo_t expected_cpuinfo = {
+            1u, cpu_tools::feature_flags_t::avx |
+                    cpu_tools::feature_flags_t::avx2 |
+                    cpu_tools::feature_flags_t::avx512 |
+                    cpu_tools::feature_flags_t::fma |
+                    cpu_tools::feature_flags_t::f16c |
+                    cpu_tools::feature_flags_t::sse4 |
+                    cpu_tools::feature_flags_t::avxvnni};
 
         REQUIRE(cpuinfo == expected_cpuinfo);
     }
@@ -122,7 +152,9 @@ CPU revision    : 14
 
         auto cpuinfo = cpu_tools::parse_cpuinfo(is);
         cpu_tools::cpuinfo_t expected_cpuinfo = {
-            2u, cpu_tools::feature_flags_t::asimd};
+            2u, cpu_tools::feature_flags_t::asimd |
+                    cpu_tools::feature_flags_t::asimddp |
+                    cpu_tools::feature_flags_t::asimdhp};
 
         REQUIRE(cpuinfo == expected_cpuinfo);
     }
@@ -157,3 +189,161 @@ CPU revision	: 5)";
         REQUIRE(cpuinfo == expected_cpuinfo);
     }
 }
+
+// unique directory for fake sysfs tree, removed with its content
+struct temp_dir_t {
+    std::string path;
+
+    temp_dir_t() {
+        char path_template[] = "/tmp/dsnote_cpu_tools_test_XXXXXX";
+        if (mkdtemp(path_template)) path = path_template;
+    }
+
+    ~temp_dir_t() {
+        if (path.empty()) return;
+        nftw(
+            path.c_str(),
+            [](const char* file, const struct stat*, int, struct FTW*) {
+                return std::remove(file);
+            },
+            16, FTW_DEPTH | FTW_PHYS);
+    }
+};
+
+static void write_sysfs_file(const std::string& path,
+                             const std::string& value) {
+    for (auto pos = path.find('/', 1); pos != std::string::npos;
+         pos = path.find('/', pos + 1))
+        mkdir(path.substr(0, pos).c_str(), 0755);
+    std::ofstream{path} << value << '\n';
+}
+
+static void write_sysfs_cpu(const std::string& dir, unsigned int id,
+                            int core_id, int node, unsigned int capacity) {
+    auto cpu_dir = dir + "/cpu" + std::to_string(id);
+    write_sysfs_file(cpu_dir + "/topology/core_id", std::to_string(core_id));
+    write_sysfs_file(cpu_dir + "/topology/physical_package_id",
+                     std::to_string(node));
+    write_sysfs_file(cpu_dir + "/cpufreq/cpuinfo_max_freq",
+                     std::to_string(capacity));
+    write_sysfs_file(cpu_dir + "/cache/index0/level", "1");
+    write_sysfs_file(cpu_dir + "/cache/index0/size", "32K");
+    write_sysfs_file(cpu_dir + "/cache/index1/level", "3");
+    write_sysfs_file(cpu_dir + "/cache/index1/size", "16384K");
+    mkdir((cpu_dir + "/node" + std::to_string(node)).c_str(), 0755);
+}
+
+TEST_CASE("cpu_tools", "[parse_topology]") {
+    SECTION("parse_cpu_list") {
+        REQUIRE(cpu_tools::parse_cpu_list("0-3,8,10-11") ==
+                std::vector<unsigned int>{0, 1, 2, 3, 8, 10, 11});
+        REQUIRE(cpu_tools::parse_cpu_list("").empty());
+    }
+
+    SECTION("smt siblings are not used for decoding") {
+        temp_dir_t temp_dir;
+        REQUIRE(!temp_dir.path.empty());
+        const auto& dir = temp_dir.path;
+        write_sysfs_file(dir + "/online", "0-3");
+        // cpu 2 and 3 are smt siblings of cpu 0 and 1
+        write_sysfs_cpu(dir, 0, 0, 0, 4000000);
+        write_sysfs_cpu(dir, 1, 1, 0, 4000000);
+        write_sysfs_cpu(dir, 2, 0, 0, 4000000);
+        write_sysfs_cpu(dir, 3, 1, 0, 4000000);
+
+        auto topology = cpu_tools::parse_topology(dir);
+
+        REQUIRE(topology.cpus.size() == 4);
+        REQUIRE(topology.physical_cores == 2);
+        REQUIRE(topology.packages == 1);
+        REQUIRE(topology.numa_nodes == 1);
+        REQUIRE(topology.llc_size_kb == 16384);
+        REQUIRE(topology.decode_cpus == std::vector<unsigned int>{0, 1});
+        REQUIRE(topology.audio_cpus == std::vector<unsigned int>{2, 3});
+    }
+
+    SECTION("big cores are used for decoding") {
+        temp_dir_t temp_dir;
+        REQUIRE(!temp_dir.path.empty());
+        const auto& dir = temp_dir.path;
+        write_sysfs_file(dir + "/online", "0-7");
+        for (unsigned int id = 0; id < 4; ++id)
+            write_sysfs_cpu(dir, id, id, 0, 1800000);
+        for (unsigned int id = 4; id < 8; ++id)
+            write_sysfs_cpu(dir, id, id, 0, 2800000);
+
+        auto topology = cpu_tools::parse_topology(dir);
+
+        REQUIRE(topology.physical_cores == 8);
+        REQUIRE(topology.decode_cpus ==
+                std::vector<unsigned int>{4, 5, 6, 7});
+        REQUIRE(topology.audio_cpus ==
+                std::vector<unsigned int>{0, 1, 2, 3});
+    }
+
+    SECTION("prime and big cores are used for decoding") {
+        temp_dir_t temp_dir;
+        REQUIRE(!temp_dir.path.empty());
+        const auto& dir = temp_dir.path;
+        write_sysfs_file(dir + "/online", "0-7");
+        for (unsigned int id = 0; id < 4; ++id)
+            write_sysfs_cpu(dir, id, id, 0, 1800000);
+        for (unsigned int id = 4; id < 7; ++id)
+            write_sysfs_cpu(dir, id, id, 0, 2400000);
+        write_sysfs_cpu(dir, 7, 7, 0, 3000000);
+
+        auto topology = cpu_tools::parse_topology(dir);
+
+        REQUIRE(topology.decode_cpus ==
+                std::vector<unsigned int>{4, 5, 6, 7});
+    }
+
+    SECTION("all cores are used when big cluster is small") {
+        temp_dir_t temp_dir;
+        REQUIRE(!temp_dir.path.empty());
+        const auto& dir = temp_dir.path;
+        write_sysfs_file(dir + "/online", "0-7");
+        for (unsigned int id = 0; id < 6; ++id)
+            write_sysfs_cpu(dir, id, id, 0, 1800000);
+        write_sysfs_cpu(dir, 6, 6, 0, 2800000);
+        write_sysfs_cpu(dir, 7, 7, 0, 2800000);
+
+        auto topology = cpu_tools::parse_topology(dir);
+
+        REQUIRE(topology.decode_cpus.size() == 8);
+        REQUIRE(topology.audio_cpus.empty());
+    }
+
+    SECTION("small capacity differences are ignored") {
+        temp_dir_t temp_dir;
+        REQUIRE(!temp_dir.path.empty());
+        const auto& dir = temp_dir.path;
+        write_sysfs_file(dir + "/online", "0-5");
+        for (unsigned int id = 0; id < 4; ++id)
+            write_sysfs_cpu(dir, id, id, 0, 4800000);
+        write_sysfs_cpu(dir, 4, 4, 0, 5000000);
+        write_sysfs_cpu(dir, 5, 5, 0, 5000000);
+
+        auto topology = cpu_tools::parse_topology(dir);
+
+        REQUIRE(topology.decode_cpus.size() == 6);
+    }
+
+    SECTION("decoding is kept in one numa node") {
+        temp_dir_t temp_dir;
+        REQUIRE(!temp_dir.path.empty());
+        const auto& dir = temp_dir.path;
+        write_sysfs_file(dir + "/online", "0-3");
+        write_sysfs_cpu(dir, 0, 0, 0, 3000000);
+        write_sysfs_cpu(dir, 1, 1, 0, 3000000);
+        write_sysfs_cpu(dir, 2, 0, 1, 3000000);
+        write_sysfs_cpu(dir, 3, 1, 1, 3000000);
+
+        auto topology = cpu_tools::parse_topology(dir);
+
+        REQUIRE(topology.physical_cores == 4);
+        REQUIRE(topology.packages == 2);
+        REQUIRE(topology.numa_nodes == 2);
+        REQUIRE(topology.decode_cpus == std::vector<unsigned int>{0, 1});
+    }
+}
@@ -0,0 +1,145 @@
+/* Copyright (C) 2024 Michal Kosciesza <michal@mkiol.net>
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+#include <unistd.h>
+
+#include <catch2/catch_test_macros.hpp>
+#include <cstdint>
+#include <fstream>
+#include <string>
+
+#include "disk_cache.hpp"
+
+TEST_CASE("disk_cache", "[get_put]") {
+    std::string file{"/tmp/dsnote_disk_cache_test.bin"};
+    unlink(file.c_str());
+
+    SECTION("get missing key") {
+        disk_cache cache{file, 1000};
+
+        REQUIRE(!cache.get("key"));
+    }
+
+    SECTION("put and get") {
+        disk_cache cache{file, 1000};
+        cache.put("key1", "value1");
+        cache.put("key2", "value2");
+        cache.put("key1", "value3");
+
+        REQUIRE(cache.count() == 2);
+        REQUIRE(cache.get("key1") == "value3");
+        REQUIRE(cache.get("key2") == "value2");
+    }
+
+    SECTION("least recently used entry is evicted") {
+        // each entry takes 8 bytes of header + 2 bytes of key + 10 of value
+        disk_cache cache{file, 60};
+        cache.put("k1", std::string(10, 'a'));
+        cache.put("k2", std::string(10, 'b'));
+        cache.put("k3", std::string(10, 'c'));
+
+        REQUIRE(cache.get("k1"));
+
+        cache.put("k4", std::string(10, 'd'));
+
+        REQUIRE(cache.size() == 60);
+        REQUIRE(cache.get("k1"));
+        REQUIRE(!cache.get("k2"));
+        REQUIRE(cache.get("k3"));
+        REQUIRE(cache.get("k4"));
+    }
+
+    SECTION("entry bigger than budget is not stored") {
+        disk_cache cache{file, 60};
+        cache.put("k1", "v1");
+        cache.put("k2", std::string(100, 'a'));
+
+        REQUIRE(cache.get("k1") == "v1");
+        REQUIRE(!cache.get("k2"));
+    }
+
+    SECTION("entries are persisted") {
+        {
+            disk_cache cache{file, 1000};
+            cache.put("key1", "value1");
+            cache.put("key2", "value2");
+            cache.put("key1", "value3");
+        }
+
+        disk_cache cache{file, 1000};
+
+        REQUIRE(cache.count() == 2);
+        REQUIRE(cache.get("key1") == "value3");
+        REQUIRE(cache.get("key2") == "value2");
+    }
+
+    SECTION("truncated file is recovered") {
+        {
+            disk_cache cache{file, 1000};
+            cache.put("key1", "value1");
+            cache.put("key2", "value2");
+        }
+
+        truncate(file.c_str(), 30);
+
+        disk_cache cache{file, 1000};
+
+        REQUIRE(cache.count() == 1);
+        REQUIRE(cache.get("key1") == "value1");
+    }
+
+    SECTION("record bigger than budget is rejected") {
+        {
+            disk_cache cache{file, 1000};
+            cache.put("key1", "value1");
+        }
+
+        {
+            std::ofstream os{file, std::ios::binary | std::ios::app};
+            uint32_t sizes[2] = {0xffffffff, 0xffffffff};
+            os.write(reinterpret_cast<const char*>(sizes), sizeof(sizes));
+        }
+
+        disk_cache cache{file, 1000};
+
+        REQUIRE(cache.count() == 1);
+        REQUIRE(cache.get("key1") == "value1");
+    }
+
+    SECTION("file locked by other cache is not used") {
+        disk_cache cache1{file, 1000};
+        cache1.put("key1", "value1");
+
+        {
+            disk_cache cache2{file, 1000};
+            REQUIRE(cache2.count() == 0);
+            cache2.put("key2", "value2");
+            REQUIRE(cache2.get("key2") == "value2");
+        }
+
+        cache1.put("key3", "value3");
+
+        REQUIRE(cache1.count() == 2);
+        REQUIRE(!cache1.get("key2"));
+    }
+
+    SECTION("invalid file is ignored") {
+        {
+            std::ofstream os{file};
+            os << "garbage";
+        }
+
+        disk_cache cache{file, 1000};
+        REQUIRE(cache.count() == 0);
+
+        cache.put("key", "value");
+        REQUIRE(cache.get("key") == "value");
+    }
+
+    unlink(file.c_str());
+    unlink((file + ".lock").c_str());
+}
@@ -0,0 +1,62 @@
+/* Copyright (C) 2024 Michal Kosciesza <michal@mkiol.net>
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+#include <catch2/catch_test_macros.hpp>
+#include <chrono>
+
+#include "metrics.hpp"
+#include "nlohmann/json.hpp"
+
+using namespace std::chrono_literals;
+
+TEST_CASE("metrics", "[record]") {
+    metrics m;
+
+    SECTION("empty stage") {
+        auto json = nlohmann::json::parse(m.to_json());
+
+        REQUIRE(json["stages"]["decode"]["count"] == 0);
+        REQUIRE(json["stages"]["decode"]["p99_ms"] == 0.0);
+        REQUIRE(json["stages"]["decode"]["buckets"].empty());
+    }
+
+    SECTION("counters and histogram") {
+        for (int i = 1; i <= 100; ++i)
+            m.record(metrics::stage_t::decode, std::chrono::milliseconds{i},
+                     1000);
+
+        auto json = nlohmann::json::parse(m.to_json())["stages"]["decode"];
+
+        REQUIRE(json["count"] == 100);
+        REQUIRE(json["total_ms"] == 5050.0);
+        REQUIRE(json["max_ms"] == 100.0);
+        REQUIRE(json["audio_ms"] == 100000);
+        REQUIRE(json["p50_ms"] == 50.0);
+        REQUIRE(json["p99_ms"] == 100.0);
+        REQUIRE(json["rtf"] == 0.0505);
+    }
+
+    SECTION("duration above last bound") {
+        m.record(metrics::stage_t::model_load, 120s);
+
+        auto json = nlohmann::json::parse(m.to_json())["stages"]["model-load"];
+
+        REQUIRE(json["buckets"].size() == 1);
+        REQUIRE(json["buckets"][0]["le_ms"] == "inf");
+        REQUIRE(json["p50_ms"] == 120000.0);
+    }
+
+    SECTION("reset") {
+        m.record(metrics::stage_t::vad, 1ms, 1500);
+        m.reset();
+
+        auto json = nlohmann::json::parse(m.to_json())["stages"]["vad"];
+
+        REQUIRE(json["count"] == 0);
+        REQUIRE(json["audio_ms"] == 0);
+    }
+}
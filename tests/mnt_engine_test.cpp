@@ -0,0 +1,160 @@
+/* Copyright (C) 2024 Michal Kosciesza <michal@mkiol.net>
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+#define private public
+
+#include <catch2/catch_test_macros.hpp>
+#include <algorithm>
+#include <string>
+
+#include "mnt_engine.hpp"
+
+TEST_CASE("mnt_engine", "[split_to_segments]") {
+    SECTION("empty text") {
+        REQUIRE(mnt_engine::split_to_segments("", false).empty());
+    }
+
+    SECTION("short text is one segment") {
+        std::string text{"Line one.\nLine two.\n"};
+
+        auto segments = mnt_engine::split_to_segments(text, false);
+
+        REQUIRE(segments.size() == 1);
+        REQUIRE(segments.front() == text);
+    }
+
+    SECTION("segments end on line break") {
+        std::string line(600, 'a');
+        line.push_back('\n');
+        auto text = line + line + line + "end";
+
+        auto segments = mnt_engine::split_to_segments(text, false);
+
+        REQUIRE(segments.size() == 2);
+        REQUIRE(segments[0] == line + line);
+        REQUIRE(segments[1] == line + "end");
+    }
+
+    SECTION("segments end on html block") {
+        std::string block = "<p>" + std::string(600, 'a') + "</p>";
+        std::string text = block + "<div>" + std::string(600, 'b') +
+                           "</div><p>end</p>";
+
+        auto segments = mnt_engine::split_to_segments(text, true);
+
+        REQUIRE(segments.size() == 2);
+        REQUIRE(segments[0] == block + "<div>" + std::string(600, 'b') +
+                                   "</div>");
+        REQUIRE(segments[1] == "<p>end</p>");
+    }
+
+    SECTION("text without boundaries is cut at max size") {
+        std::string text(25000, 'a');
+
+        auto segments = mnt_engine::split_to_segments(text, true);
+
+        REQUIRE(segments.size() == 3);
+        REQUIRE(segments[0].size() == mnt_engine::m_segment_max_size);
+        REQUIRE(segments[1].size() == mnt_engine::m_segment_max_size);
+        REQUIRE(segments[2].size() == 5000);
+    }
+
+    SECTION("segments cover whole text") {
+        std::string text;
+        for (int i = 0; i < 1000; ++i)
+            text.append("<h1>title</h1><p>paragraph ")
+                .append(std::to_string(i))
+                .append("</p>\n");
+
+        std::string joined;
+        for (auto segment : mnt_engine::split_to_segments(text, true))
+            joined.append(segment);
+
+        REQUIRE(joined == text);
+    }
+}
+
+TEST_CASE("mnt_engine", "[split_to_cache_segments]") {
+    std::string text;
+    for (int i = 0; i < 2000; ++i)
+        text.append("Sentence number ").append(std::to_string(i)).append(".\n");
+
+    auto batches = mnt_engine::split_to_cache_segments(text, false, 1000);
+
+    SECTION("segments cover whole text") {
+        std::string joined;
+        for (auto batch : batches) joined.append(batch);
+
+        REQUIRE(joined == text);
+    }
+
+    SECTION("segment size is bounded") {
+        for (size_t i = 0; i + 1 < batches.size(); ++i) {
+            REQUIRE(batches[i].size() >= 1000);
+            REQUIRE(batches[i].size() <=
+                    mnt_engine::m_segment_max_factor * 1000 + 30);
+        }
+    }
+
+    SECTION("edit changes only nearby batches") {
+        auto edited = text;
+        edited.insert(text.size() / 2, "Inserted sentence.\n");
+
+        auto edited_batches =
+            mnt_engine::split_to_cache_segments(edited, false, 1000);
+
+        size_t same = 0;
+        for (auto batch : edited_batches) {
+            if (std::find(batches.cbegin(), batches.cend(), batch) !=
+                batches.cend())
+                ++same;
+        }
+
+        REQUIRE(same + 2 >= edited_batches.size());
+    }
+}
+
+TEST_CASE("mnt_engine", "[split_translation]") {
+    SECTION("raw text") {
+        std::string source = "One.\nTwo.\nThree.\nFour.";
+        std::vector<std::string_view> segments{
+            std::string_view{source}.substr(0, 10),
+            std::string_view{source}.substr(10)};
+
+        auto parts = mnt_engine::split_translation(
+            segments, "Eins.\nZwei.\nDrei.\nVier.", false);
+
+        REQUIRE(parts.size() == 2);
+        REQUIRE(parts[0] == "Eins.\nZwei.\n");
+        REQUIRE(parts[1] == "Drei.\nVier.");
+    }
+
+    SECTION("html text") {
+        std::vector<std::string_view> segments{"<p>One <b>a</b></p>",
+                                               "<p>Two</p>"};
+
+        auto parts = mnt_engine::split_translation(
+            segments, "<p>Eins <b>a</b></p><p>Zwei</p>", true);
+
+        REQUIRE(parts.size() == 2);
+        REQUIRE(parts[0] == "<p>Eins <b>a</b></p>");
+        REQUIRE(parts[1] == "<p>Zwei</p>");
+    }
+
+    SECTION("mismatched boundaries") {
+        std::vector<std::string_view> segments{"One.\n", "Two.\n"};
+
+        REQUIRE(mnt_engine::split_translation(segments, "Eins. Zwei.\n", false)
+                    .empty());
+    }
+}
+
+TEST_CASE("mnt_engine", "[normalize_cache_text]") {
+    REQUIRE(mnt_engine::normalize_cache_text("  Hello \t  world  \n next\r\n") ==
+            "Hello world\nnext\n");
+    REQUIRE(mnt_engine::normalize_cache_text("a\n\nb") == "a\n\nb");
+}
@@ -0,0 +1,124 @@
+/* Copyright (C) 2024 Michal Kosciesza <michal@mkiol.net>
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+#include <QFile>
+#include <QString>
+#include <catch2/catch_test_macros.hpp>
+
+#include "note_store.h"
+
+TEST_CASE("note_store", "[undo]") {
+    note_store store;
+
+    SECTION("set text is undone in one step") {
+        store.set_text("Hello");
+        store.make_undo_point();
+        store.set_text("Hello world");
+        store.set_text("Hello big world");
+
+        REQUIRE(store.can_undo());
+        REQUIRE(store.undo());
+        REQUIRE(store.text() == "Hello");
+        REQUIRE(store.can_redo());
+        REQUIRE(store.redo());
+        REQUIRE(store.text() == "Hello big world");
+    }
+
+    SECTION("multi-level undo") {
+        store.append("One.");
+        store.make_undo_point();
+        store.append(" Two.");
+        store.make_undo_point();
+        store.append(" Three.");
+
+        REQUIRE(store.undo());
+        REQUIRE(store.text() == "One. Two.");
+        REQUIRE(store.undo());
+        REQUIRE(store.text() == "One.");
+        REQUIRE(store.undo());
+        REQUIRE(store.text().isEmpty());
+        REQUIRE(!store.can_undo());
+
+        REQUIRE(store.redo());
+        REQUIRE(store.redo());
+        REQUIRE(store.text() == "One. Two.");
+    }
+
+    SECTION("new change clears redo") {
+        store.set_text("abc");
+        store.make_undo_point();
+        store.set_text("abcd");
+        store.undo();
+        store.set_text("abx");
+
+        REQUIRE(!store.can_redo());
+        REQUIRE(store.undo());
+        REQUIRE(store.text() == "abc");
+    }
+
+    SECTION("same text is not a change") {
+        store.set_text("abc");
+        store.make_undo_point();
+
+        REQUIRE(!store.set_text("abc"));
+        REQUIRE(store.undo());
+        REQUIRE(store.text().isEmpty());
+    }
+}
+
+TEST_CASE("note_store", "[file]") {
+    QString file{"/tmp/dsnote_note_store_test.dat"};
+    QFile::remove(file);
+
+    SECTION("edits are restored from log") {
+        {
+            note_store store;
+            store.load(file);
+            store.set_text("Hello world");
+            store.append(" Bye.");
+            store.set_text("Hello big world Bye.");
+        }
+
+        note_store store;
+        REQUIRE(store.load(file));
+        REQUIRE(store.text() == "Hello big world Bye.");
+        REQUIRE(!store.can_undo());
+    }
+
+    SECTION("undo is persisted") {
+        {
+            note_store store;
+            store.load(file);
+            store.append("One.");
+            store.make_undo_point();
+            store.append(" Two.");
+            store.undo();
+        }
+
+        note_store store;
+        REQUIRE(store.load(file));
+        REQUIRE(store.text() == "One.");
+    }
+
+    SECTION("memory only note removes file") {
+        note_store store;
+        store.load(file);
+        store.append("One.");
+        store.set_file({});
+
+        REQUIRE(!QFile{file}.exists());
+        REQUIRE(store.text() == "One.");
+
+        store.set_file(file);
+
+        note_store store2;
+        REQUIRE(store2.load(file));
+        REQUIRE(store2.text() == "One.");
+    }
+
+    QFile::remove(file);
+}
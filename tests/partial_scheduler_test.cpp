@@ -0,0 +1,57 @@
+/* Copyright (C) 2024 Michal Kosciesza <michal@mkiol.net>
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+#include <catch2/catch_test_macros.hpp>
+
+#include "partial_scheduler.hpp"
+
+TEST_CASE("partial_scheduler", "[feed]") {
+    partial_scheduler ps;
+
+    SECTION("fast decoding keeps latency target") {
+        ps.partial_decoded(10);
+
+        REQUIRE(ps.interval_ms() == 500);
+        REQUIRE(!ps.feed(300, 0));
+        REQUIRE(ps.feed(300, 0));
+        REQUIRE(ps.feed(1500, 0));
+    }
+
+    SECTION("slow decoding extends interval") {
+        ps.partial_decoded(1000);
+
+        REQUIRE(ps.interval_ms() == 2000);
+        REQUIRE(!ps.feed(1500, 0));
+        REQUIRE(ps.feed(1500, 0));
+    }
+
+    SECTION("backoff when behind and recovery when on time") {
+        REQUIRE(!ps.feed(500, 1000));
+        REQUIRE(ps.interval_ms() == 1000);
+        REQUIRE(!ps.feed(0, 1000));
+        REQUIRE(ps.interval_ms() == 2000);
+
+        REQUIRE(ps.feed(1500, 0));
+        REQUIRE(ps.interval_ms() == 1000);
+        REQUIRE(!ps.feed(0, 0));
+        REQUIRE(ps.interval_ms() == 500);
+    }
+
+    SECTION("interval is limited") {
+        ps.partial_decoded(100000);
+
+        REQUIRE(ps.interval_ms() == ps.config().max_interval_ms);
+    }
+
+    SECTION("reset keeps decoding cost") {
+        ps.partial_decoded(1000);
+        ps.feed(1500, 1000);
+        ps.reset();
+
+        REQUIRE(ps.interval_ms() == 2000);
+    }
+}
@@ -8,36 +8,107 @@
 #define protected public
 
 #include <catch2/catch_test_macros.hpp>
+#include <future>
 #include <string>
+#include <vector>
 
 #include "stt_engine.hpp"
 
 TEST_CASE("stt_engine", "[merge_texts]") {
     std::string text1{"Hello, How are you"};
-    std::string text2{"you today?"};
-    std::string text3{"today?"};
 
     SECTION("merge not overlaped texts") {
-        auto result = stt_engine::merge_texts(text1, std::move(text3));
+        REQUIRE(stt_engine::merge_texts(text1, "today?"));
 
-        REQUIRE(result == "Hello, How are you today?");
+        REQUIRE(text1 == "Hello, How are you today?");
     }
 
     SECTION("merge overlaped texts") {
-        auto result = stt_engine::merge_texts(text1, std::move(text2));
+        REQUIRE(stt_engine::merge_texts(text1, "you today?"));
 
-        REQUIRE(result == "Hello, How are you today?");
+        REQUIRE(text1 == "Hello, How are you today?");
     }
 
     SECTION("merge fully overlaped texts") {
-        auto result = stt_engine::merge_texts(text1, "you");
+        REQUIRE_FALSE(stt_engine::merge_texts(text1, "you"));
 
-        REQUIRE(result == "Hello, How are you");
+        REQUIRE(text1 == "Hello, How are you");
     }
 
     SECTION("merge repeated text") {
-        auto result = stt_engine::merge_texts(text1, "How are you");
+        REQUIRE_FALSE(stt_engine::merge_texts(text1, "How are you"));
 
-        REQUIRE(result == "Hello, How are you");
+        REQUIRE(text1 == "Hello, How are you");
+    }
+
+    SECTION("merge to empty text") {
+        std::string text;
+
+        REQUIRE(stt_engine::merge_texts(text, "Hello"));
+        REQUIRE(text == "Hello");
+        REQUIRE_FALSE(stt_engine::merge_texts(text, ""));
+    }
+}
+
+TEST_CASE("stt_engine", "[find_overlap]") {
+    SECTION("periodic text") {
+        REQUIRE(stt_engine::find_overlap("abababa", "ababx") == 3);
+        REQUIRE(stt_engine::find_overlap("aaaa", "aaaaaa") == 4);
+        REQUIRE(stt_engine::find_overlap("abc", "xyz") == 0);
+    }
+
+    SECTION("overlap is searched only in tail window") {
+        std::string text(10 * stt_engine::m_merge_window_size, 'a');
+
+        REQUIRE(stt_engine::find_overlap(text, text) ==
+                stt_engine::m_merge_window_size);
+
+        text.append(" end");
+
+        REQUIRE(stt_engine::find_overlap(text, "end of text") == 3);
+    }
+}
+
+namespace {
+struct test_engine : public stt_engine {
+    test_engine() : stt_engine{{}, {}} {}
+    void reset_impl() override {}
+};
+}  // namespace
+
+TEST_CASE("stt_engine", "[decoding]") {
+    test_engine engine;
+    std::vector<int> order;
+
+    SECTION("tasks are executed in order on decoding thread") {
+        engine.start_decoding();
+
+        std::promise<void> release;
+        auto released = release.get_future().share();
+
+        engine.push_decode_task([&] {
+            released.wait();
+            order.push_back(1);
+        });
+        // decoder is busy, so task is queued
+        engine.run_after_decoding([&] { order.push_back(2); });
+        engine.push_decode_task([&] { order.push_back(3); });
+
+        release.set_value();
+
+        std::promise<void> done;
+        engine.push_decode_task([&] { done.set_value(); });
+        done.get_future().wait();
+
+        engine.stop_decoding();
+
+        REQUIRE(order == std::vector<int>{1, 2, 3});
+    }
+
+    SECTION("tasks are executed in place without decoding thread") {
+        engine.push_decode_task([&] { order.push_back(1); });
+        engine.run_after_decoding([&] { order.push_back(2); });
+
+        REQUIRE(order == std::vector<int>{1, 2});
     }
 }
@@ -12,24 +12,36 @@
 
 #include "vad.hpp"
 
-TEST_CASE("vad", "[shift_left]") {
-    std::vector<int16_t> buf{1, 2, 3, 4, 5};
+TEST_CASE("vad", "[push_result]") {
+    vad v;
 
-    SECTION("shift 0") {
-        vad::shift_left(buf, 0);
+    SECTION("silence") {
+        for (int i = 0; i < 50; ++i) v.push_result(false);
 
-        REQUIRE(buf == std::vector<int16_t>{1, 2, 3, 4, 5});
+        REQUIRE(v.m_spans.empty());
+        REQUIRE(!v.m_speech_start);
     }
 
-    SECTION("shift 3") {
-        vad::shift_left(buf, 3);
+    SECTION("speech start and stop") {
+        for (int i = 0; i < 30; ++i) v.push_result(true);
 
-        REQUIRE(buf == std::vector<int16_t>{4, 5});
+        REQUIRE(v.m_speech_start == 0);
+        REQUIRE(v.m_spans.empty());
+
+        for (int i = 0; i < 30; ++i) v.push_result(false);
+
+        REQUIRE(!v.m_speech_start);
+        REQUIRE(v.m_spans.size() == 1);
+        REQUIRE(v.m_spans.front().start == 0);
+        REQUIRE(v.m_spans.front().end == 43 * vad::m_chunk_size);
     }
 
-    SECTION("shift more than buf size") {
-        vad::shift_left(buf, buf.size() + 1);
+    SECTION("no new speech before end of previous span") {
+        for (int i = 0; i < 30; ++i) v.push_result(true);
+        for (int i = 0; i < 13; ++i) v.push_result(false);
+        for (int i = 0; i < 30; ++i) v.push_result(true);
 
-        REQUIRE(buf.empty());
+        REQUIRE(v.m_speech_start);
+        REQUIRE(*v.m_speech_start >= v.m_spans.front().end);
     }
 }